@@ -0,0 +1,75 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+/* Merge the binary trace files written with SC_TRACE_BINARY.
+ * Usage: sc_trace_merge [-j] [-o output] trace.0.bin trace.1.bin ...
+ * The records of all files are sorted by time and written as text,
+ * or with -j as Chrome trace JSON to be loaded into chrome://tracing.
+ */
+
+#include <sc_options.h>
+#include <sc_trace.h>
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 first_arg;
+  int                 json;
+  const char         *output;
+  FILE               *out;
+  sc_options_t       *opt;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+
+  /* keep the standard output free for the merged trace */
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_ERROR);
+
+  opt = sc_options_new (argv[0]);
+  sc_options_add_switch (opt, 'j', "json", &json, "Write Chrome trace JSON");
+  sc_options_add_string (opt, 'o', "output", &output, NULL,
+                         "Output file (default standard output)");
+
+  first_arg = sc_options_parse (sc_package_id, SC_LP_ERROR, opt, argc, argv);
+  if (first_arg < 0 || first_arg == argc) {
+    sc_options_print_usage (sc_package_id, SC_LP_ERROR, opt,
+                            "<trace.bin> [<trace.bin> ...]");
+  }
+  else if (sc_is_root ()) {
+    out = output != NULL ? fopen (output, "w") : stdout;
+    SC_CHECK_ABORT (out != NULL, "Trace output");
+    SC_CHECK_ABORT (!sc_trace_merge (argc - first_arg, argv + first_arg,
+                                     json, out), "Trace input");
+    if (out != stdout) {
+      SC_CHECK_ABORT (!fclose (out), "Trace output close");
+    }
+  }
+
+  sc_options_destroy (opt);
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
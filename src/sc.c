@@ -20,7 +20,9 @@
   02110-1301, USA.
 */
 
-#include <sc.h>
+#include <sc_flops.h>
+#include <sc_trace.h>
+#include <sc_tune.h>
 
 #if defined SC_ALLOC_PAGE || defined SC_ALLOC_LINE
 #define SC_ALLOC_ALIGN
@@ -42,7 +44,61 @@ typedef void        (*sc_sig_t) (int);
 #endif
 #endif
 
-#define SC_MAX_PACKAGES 128
+#ifdef SC_HAVE_TIME_H
+#include <time.h>
+#endif
+#ifdef SC_HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#ifdef SC_HAVE_FCNTL_H
+#ifdef SC_HAVE_SYS_MMAN_H
+#ifdef SC_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#define SC_TRACE_MMAP
+#endif
+#endif
+#endif
+
+#define SC_TRACE_CACHE_SIZE (2 * SC_TRACE_MAX_FILES)
+
+/* distinct messages gathered by a collective abort */
+#define SC_ABORT_MAX_MESSAGES 8
+#define SC_ABORT_MESSAGE_LENGTH 240
+
+/* processes that leave the abort to the root poll this often and long */
+#define SC_ABORT_POLL_MS 10
+#define SC_ABORT_WAIT_MS 1000
+
+/* counters and caches shared between threads;
+   SC_ATOMIC_INC returns the previous value of an int or uint64_t,
+   SC_ATOMIC_LOAD and SC_ATOMIC_STORE access a const char pointer */
+#ifdef SC_PTHREAD
+#include <pthread.h>
+#ifdef SC_HAVE_ATOMIC_BUILTINS
+#define SC_ATOMIC_INC(v)        __atomic_fetch_add (&(v), 1, __ATOMIC_RELAXED)
+#define SC_ATOMIC_LOAD(v)       __atomic_load_n (&(v), __ATOMIC_ACQUIRE)
+#define SC_ATOMIC_STORE(v,x)    __atomic_store_n (&(v), (x), __ATOMIC_RELEASE)
+#else
+#define SC_ATOMIC_MUTEX
+#define SC_ATOMIC_INC(v)        (sizeof (v) == sizeof (uint64_t) ? \
+                                 sc_atomic_inc64 ((uint64_t *) &(v)) : \
+                                 (uint64_t) sc_atomic_inc ((int *) &(v)))
+#define SC_ATOMIC_LOAD(v)       sc_atomic_load (&(v))
+#define SC_ATOMIC_STORE(v,x)    sc_atomic_store (&(v), (x))
+#endif
+#define SC_MUTEX_LOCK(m)        SC_CHECK_ABORT (!pthread_mutex_lock (m), \
+                                                "Mutex lock")
+#define SC_MUTEX_UNLOCK(m)      SC_CHECK_ABORT (!pthread_mutex_unlock (m), \
+                                                "Mutex unlock")
+#else
+#define SC_ATOMIC_INC(v)        ((v)++)
+#define SC_ATOMIC_LOAD(v)       (v)
+#define SC_ATOMIC_STORE(v,x)    ((v) = (x))
+#define SC_MUTEX_LOCK(m)        SC_NOOP ()
+#define SC_MUTEX_UNLOCK(m)      SC_NOOP ()
+#endif
 
 typedef struct sc_package
 {
@@ -56,6 +112,38 @@ typedef struct sc_package
 }
 sc_package_t;
 
+/** State of the binary trace; see sc_trace.h for the file format. */
+typedef struct sc_trace_binary
+{
+  sc_trace_header_t  *header;   /**< NULL if the binary trace is off. */
+  sc_trace_record_t  *records;
+  size_t              bytes;
+#ifndef SC_TRACE_MMAP
+  FILE               *file;
+#endif
+
+  /* map the __FILE__ pointers of the callers to file ids */
+  const char         *cache_names[SC_TRACE_CACHE_SIZE];
+  int                 cache_ids[SC_TRACE_CACHE_SIZE];
+  int                 cache_count;
+}
+sc_trace_binary_t;
+
+/** A set of distinct abort messages merged along a tree. */
+typedef struct sc_abort_report
+{
+  int                 num_messages;
+  int                 num_dropped;      /**< Processes not represented. */
+  struct
+  {
+    int                 first_rank;     /**< Lowest rank with the message. */
+    int                 count;          /**< Processes with the message. */
+    char                text[SC_ABORT_MESSAGE_LENGTH];
+  }
+  messages[SC_ABORT_MAX_MESSAGES];
+}
+sc_abort_report_t;
+
 #ifdef SC_ALLOC_ALIGN
 static const size_t sc_page_bytes = 4096;
 #endif
@@ -95,6 +183,11 @@ const int sc_log2_lookup_table[256] =
 int                 sc_package_id = -1;
 FILE               *sc_trace_file = NULL;
 int                 sc_trace_prio = SC_LP_STATISTICS;
+int                 sc_log_cutoff[2][SC_MAX_PACKAGES + 1];
+
+/* the cutoff for the text streams without the binary trace */
+static int          sc_log_text_cutoff[2][SC_MAX_PACKAGES + 1];
+static sc_trace_binary_t sc_trace_binary;
 
 static int          default_malloc_count = 0;
 static int          default_free_count = 0;
@@ -112,10 +205,81 @@ static sc_sig_t     system_segv_handler = NULL;
 static sc_sig_t     system_usr2_handler = NULL;
 
 static int          sc_print_backtrace = 0;
+static int          sc_abort_quiet = 0;
 
 static int          sc_num_packages = 0;
 static sc_package_t sc_packages[SC_MAX_PACKAGES];
 
+#ifdef SC_PTHREAD
+static pthread_mutex_t sc_package_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t sc_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#ifdef SC_ATOMIC_MUTEX
+
+/* the compiler has no atomic builtins */
+static pthread_mutex_t sc_atomic_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int
+sc_atomic_inc (int *v)
+{
+  int                 old;
+
+  SC_MUTEX_LOCK (&sc_atomic_mutex);
+  old = (*v)++;
+  SC_MUTEX_UNLOCK (&sc_atomic_mutex);
+  return old;
+}
+
+static              uint64_t
+sc_atomic_inc64 (uint64_t * v)
+{
+  uint64_t            old;
+
+  SC_MUTEX_LOCK (&sc_atomic_mutex);
+  old = (*v)++;
+  SC_MUTEX_UNLOCK (&sc_atomic_mutex);
+  return old;
+}
+
+static const char  *
+sc_atomic_load (const char **v)
+{
+  const char         *value;
+
+  SC_MUTEX_LOCK (&sc_atomic_mutex);
+  value = *v;
+  SC_MUTEX_UNLOCK (&sc_atomic_mutex);
+  return value;
+}
+
+static void
+sc_atomic_store (const char **v, const char *value)
+{
+  SC_MUTEX_LOCK (&sc_atomic_mutex);
+  *v = value;
+  SC_MUTEX_UNLOCK (&sc_atomic_mutex);
+}
+
+#endif /* SC_ATOMIC_MUTEX */
+
+/** Return the identifier of the calling process for log messages.
+ * With the ranks emulated by threads it is the rank of the thread.
+ */
+static int
+sc_log_identifier (void)
+{
+#ifdef SC_MPITHREAD
+  int                 rank;
+
+  if (sc_identifier >= 0 && sc_mpicomm != MPI_COMM_NULL &&
+      MPI_Comm_rank (sc_mpicomm, &rank) == MPI_SUCCESS) {
+    return rank;
+  }
+#endif
+  return sc_identifier;
+}
+
 static void
 sc_signal_handler (int sig)
 {
@@ -167,11 +331,257 @@ sc_set_signal_handler (int catch_signals)
   }
 }
 
+/** Recompute the runtime cutoff used by the log macros.
+ * An entry is the lowest priority that may reach any log stream.
+ * Zero entries, as before the first call, let every message through.
+ * The caller holds sc_package_mutex, since the packages are read.
+ */
+static void
+sc_log_cutoff_update (void)
+{
+  int                 i, cutoff, global;
+  sc_package_t       *p;
+
+  for (i = -1; i < SC_MAX_PACKAGES; ++i) {
+    cutoff = sc_default_log_threshold;
+    if (i >= 0) {
+      p = sc_packages + i;
+      if (p->is_registered && p->log_threshold != SC_LP_DEFAULT) {
+        cutoff = p->log_threshold;
+      }
+    }
+    if (sc_trace_file != NULL) {
+      cutoff = SC_MIN (cutoff, sc_trace_prio);
+    }
+    for (global = 0; global < 2; ++global) {
+      if (global && sc_identifier > 0) {
+        sc_log_text_cutoff[global][i + 1] = SC_LP_SILENT;
+        sc_log_cutoff[global][i + 1] = SC_LP_SILENT;
+      }
+      else {
+        sc_log_text_cutoff[global][i + 1] = cutoff;
+        sc_log_cutoff[global][i + 1] = sc_trace_binary.header == NULL ?
+          cutoff : SC_MIN (cutoff, sc_trace_prio);
+      }
+    }
+  }
+}
+
+/** Check the runtime cutoff for a valid package id.
+ * \return             True if the message is certainly not logged.
+ */
+static int
+sc_log_is_filtered (int package, int category, int priority)
+{
+  if (package < -1 || package >= SC_MAX_PACKAGES) {
+    return 0;
+  }
+  return priority < sc_log_cutoff[category == SC_LC_GLOBAL][package + 1];
+}
+
+static              uint64_t
+sc_trace_time (void)
+{
+#ifdef SC_HAVE_CLOCK_GETTIME
+  struct timespec     ts;
+
+  (void) clock_gettime (CLOCK_REALTIME, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+#else
+  struct timeval      tv;
+
+  (void) gettimeofday (&tv, NULL);
+  return (uint64_t) tv.tv_sec * 1000000000 + (uint64_t) tv.tv_usec * 1000;
+#endif
+}
+
+static void
+sc_trace_package_name (int package)
+{
+  const char         *name;
+
+  name = package == -1 ? "default" : sc_packages[package].name;
+  snprintf (sc_trace_binary.header->packages[package + 1],
+            SC_TRACE_NAME_LENGTH, "%s", name);
+}
+
+/** Find the id of a source file by name, adding it if necessary.
+ * The last slot of the file table collects all files that do not fit.
+ */
+static int
+sc_trace_file_lookup (const char *filename)
+{
+  int                 i;
+  const char         *bp;
+  sc_trace_header_t  *h = sc_trace_binary.header;
+
+  bp = strrchr (filename, '/');
+  bp = bp != NULL ? bp + 1 : filename;
+  for (i = 0; i < h->num_files; ++i) {
+    if (!strncmp (h->files[i], bp, SC_TRACE_NAME_LENGTH - 1)) {
+      return i;
+    }
+  }
+  if (h->num_files == SC_TRACE_MAX_FILES - 1) {
+    return SC_TRACE_MAX_FILES - 1;
+  }
+  snprintf (h->files[i], SC_TRACE_NAME_LENGTH, "%s", bp);
+  return h->num_files++;
+}
+
+/** Find the id of a source file by the address of its name.
+ * Most calls pass __FILE__ and are resolved by one hash probe.
+ */
+static int
+sc_trace_file_id (const char *filename)
+{
+  int                 id;
+  size_t              hash;
+  const char         *name;
+
+  hash = ((size_t) filename >> 3) % SC_TRACE_CACHE_SIZE;
+  while ((name = SC_ATOMIC_LOAD (sc_trace_binary.cache_names[hash]))
+         != NULL) {
+    if (name == filename) {
+      return sc_trace_binary.cache_ids[hash];
+    }
+    hash = (hash + 1) % SC_TRACE_CACHE_SIZE;
+  }
+
+  /* the cache is kept at most half full to terminate the search */
+  SC_MUTEX_LOCK (&sc_trace_mutex);
+  id = sc_trace_file_lookup (filename);
+  while (sc_trace_binary.cache_names[hash] != NULL &&
+         sc_trace_binary.cache_names[hash] != filename) {
+    hash = (hash + 1) % SC_TRACE_CACHE_SIZE;
+  }
+  if (sc_trace_binary.cache_names[hash] == NULL &&
+      sc_trace_binary.cache_count < SC_TRACE_CACHE_SIZE / 2) {
+    /* the id must be valid when another thread finds the name */
+    sc_trace_binary.cache_ids[hash] = id;
+    SC_ATOMIC_STORE (sc_trace_binary.cache_names[hash], filename);
+    ++sc_trace_binary.cache_count;
+  }
+  SC_MUTEX_UNLOCK (&sc_trace_mutex);
+  return id;
+}
+
+static void
+sc_trace_binary_record (const char *filename, int lineno,
+                        int package, int category, int priority)
+{
+  uint64_t            count;
+  sc_trace_header_t  *h = sc_trace_binary.header;
+  sc_trace_record_t  *r;
+
+  /* the capacity is a power of two */
+  count = SC_ATOMIC_INC (h->count);
+  r = sc_trace_binary.records + (count & (h->capacity - 1));
+  r->time = sc_trace_time ();
+  r->location = (uint32_t) sc_trace_file_id (filename) << SC_TRACE_LINE_BITS
+    | ((uint32_t) lineno & SC_TRACE_LINE_MASK);
+  r->package = (int16_t) package;
+  r->category = (int8_t) category;
+  r->priority = (int8_t) priority;
+}
+
+static void
+sc_trace_binary_open (const char *trace_binary_name)
+{
+  int                 i;
+  long long           lcap;
+  size_t              capacity;
+  const char         *trace_binary_size;
+  char                buffer[BUFSIZ];
+  void               *mem;
+  sc_trace_header_t  *h;
+#ifdef SC_TRACE_MMAP
+  int                 fd, retval;
+#endif
+
+  SC_CHECK_ABORT (sc_trace_binary.header == NULL, "Trace binary not NULL");
+  if (sc_identifier >= 0) {
+    snprintf (buffer, BUFSIZ, "%s.%d.bin", trace_binary_name, sc_identifier);
+  }
+  else {
+    snprintf (buffer, BUFSIZ, "%s.bin", trace_binary_name);
+  }
+
+  capacity = SC_TRACE_CAPACITY;
+  trace_binary_size = getenv ("SC_TRACE_BINARY_SIZE");
+  if (trace_binary_size != NULL) {
+    lcap = strtoll (trace_binary_size, NULL, 10);
+    SC_CHECK_ABORT (lcap > 0, "Invalid trace binary size");
+    for (capacity = 1; capacity < (size_t) lcap; capacity <<= 1);
+  }
+  sc_trace_binary.bytes =
+    sizeof (sc_trace_header_t) + capacity * sizeof (sc_trace_record_t);
+
+#ifdef SC_TRACE_MMAP
+  /* the records survive a crash of the process */
+  fd = open (buffer, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  SC_CHECK_ABORT (fd >= 0, "Trace binary open");
+  retval = ftruncate (fd, (off_t) sc_trace_binary.bytes);
+  SC_CHECK_ABORT (!retval, "Trace binary truncate");
+  mem = mmap (NULL, sc_trace_binary.bytes, PROT_READ | PROT_WRITE,
+              MAP_SHARED, fd, 0);
+  SC_CHECK_ABORT (mem != MAP_FAILED, "Trace binary map");
+  retval = close (fd);
+  SC_CHECK_ABORT (!retval, "Trace binary close");
+#else
+  /* the records are written by sc_finalize */
+  sc_trace_binary.file = fopen (buffer, "wb");
+  SC_CHECK_ABORT (sc_trace_binary.file != NULL, "Trace binary open");
+  mem = calloc (1, sc_trace_binary.bytes);
+  SC_CHECK_ABORT (mem != NULL, "Trace binary allocation");
+#endif
+
+  h = sc_trace_binary.header = (sc_trace_header_t *) mem;
+  sc_trace_binary.records = (sc_trace_record_t *) (h + 1);
+  memcpy (h->magic, SC_TRACE_MAGIC, sizeof (h->magic));
+  h->rank = (int32_t) sc_identifier;
+  h->num_files = 0;
+  h->capacity = (uint64_t) capacity;
+  h->count = 0;
+  snprintf (h->files[SC_TRACE_MAX_FILES - 1], SC_TRACE_NAME_LENGTH,
+            "<other>");
+  for (i = -1; i < SC_MAX_PACKAGES; ++i) {
+    if (i == -1 || sc_packages[i].is_registered) {
+      sc_trace_package_name (i);
+    }
+  }
+}
+
+static void
+sc_trace_binary_close (void)
+{
+  int                 retval;
+
+  if (sc_trace_binary.header == NULL) {
+    return;
+  }
+#ifdef SC_TRACE_MMAP
+  retval = munmap (sc_trace_binary.header, sc_trace_binary.bytes);
+  SC_CHECK_ABORT (!retval, "Trace binary unmap");
+#else
+  retval = fwrite (sc_trace_binary.header, sc_trace_binary.bytes, 1,
+                   sc_trace_binary.file) != 1;
+  SC_CHECK_ABORT (!retval, "Trace binary write");
+  retval = fclose (sc_trace_binary.file);
+  SC_CHECK_ABORT (!retval, "Trace binary close");
+  free (sc_trace_binary.header);
+#endif
+  memset (&sc_trace_binary, 0, sizeof (sc_trace_binary));
+}
+
 static void
 sc_log_handler (FILE * log_stream, const char *filename, int lineno,
                 int package, int category, int priority, const char *msg)
 {
   int                 wp = 0, wi = 0;
+  int                 identifier;
+  int                 len = 0;
+  char                line[BUFSIZ];
 
   if (package != -1) {
     if (!sc_package_is_registered (package))
@@ -179,28 +589,45 @@ sc_log_handler (FILE * log_stream, const char *filename, int lineno,
     else
       wp = 1;
   }
-  wi = (category == SC_LC_NORMAL && sc_identifier >= 0);
+  identifier = sc_log_identifier ();
+  wi = (category == SC_LC_NORMAL && identifier >= 0);
 
+  /* assemble the line on the stack so that threads do not interleave */
   if (wp || wi) {
-    fputc ('[', log_stream);
-    if (wp)
-      fprintf (log_stream, "%s", sc_packages[package].name);
-    if (wp && wi)
-      fputc (' ', log_stream);
-    if (wi)
-      fprintf (log_stream, "%d", sc_identifier);
-    fputs ("] ", log_stream);
+    len = snprintf (line, BUFSIZ, "[%s%s",
+                    wp ? sc_packages[package].name : "", wp && wi ? " " : "");
+    if (wi && len >= 0 && len < BUFSIZ)
+      len += snprintf (line + len, BUFSIZ - len, "%d", identifier);
+    if (len >= 0 && len < BUFSIZ)
+      len += snprintf (line + len, BUFSIZ - len, "] ");
   }
 
-  if (priority == SC_LP_TRACE) {
-    char                bn[BUFSIZ], *bp;
+  if (priority == SC_LP_TRACE && len >= 0 && len < BUFSIZ) {
+    const char         *bp;
 
-    snprintf (bn, BUFSIZ, "%s", filename);
-    bp = basename (bn);
-    fprintf (log_stream, "%s:%d ", bp, lineno);
+    /* the file name is not copied; basename may modify its argument */
+    bp = strrchr (filename, '/');
+    len += snprintf (line + len, BUFSIZ - len, "%s:%d ",
+                     bp != NULL ? bp + 1 : filename, lineno);
   }
 
-  fputs (msg, log_stream);
+  if (len >= 0 && len < BUFSIZ &&
+      snprintf (line + len, BUFSIZ - len, "%s", msg) < BUFSIZ - len) {
+    fputs (line, log_stream);
+  }
+  else {
+    /* the line is too long for the buffer */
+    if (len >= 0 && len < BUFSIZ)
+      line[len] = '\0';
+#ifdef SC_HAVE_FLOCKFILE
+    flockfile (log_stream);
+#endif
+    fputs (line, log_stream);
+    fputs (msg, log_stream);
+#ifdef SC_HAVE_FLOCKFILE
+    funlockfile (log_stream);
+#endif
+  }
   fflush (log_stream);
 }
 
@@ -240,10 +667,10 @@ sc_malloc (int package, size_t size)
 
   if (size > 0) {
     SC_CHECK_ABORT (ret != NULL, "Allocation");
-    ++*malloc_count;
+    SC_ATOMIC_INC (*malloc_count);
   }
-  else {
-    *malloc_count += ((ret == NULL) ? 0 : 1);
+  else if (ret != NULL) {
+    SC_ATOMIC_INC (*malloc_count);
   }
 
 #ifdef SC_ALLOC_PAGE
@@ -285,10 +712,10 @@ sc_calloc (int package, size_t nmemb, size_t size)
 
   if (nmemb * size > 0) {
     SC_CHECK_ABORT (ret != NULL, "Allocation");
-    ++*malloc_count;
+    SC_ATOMIC_INC (*malloc_count);
   }
-  else {
-    *malloc_count += ((ret == NULL) ? 0 : 1);
+  else if (ret != NULL) {
+    SC_ATOMIC_INC (*malloc_count);
   }
 
 #ifdef SC_ALLOC_PAGE
@@ -375,7 +802,7 @@ sc_free (int package, void *ptr)
 {
   if (ptr != NULL) {
     int                *free_count = sc_free_count (package);
-    ++*free_count;
+    SC_ATOMIC_INC (*free_count);
 
 #ifdef SC_ALLOC_ALIGN
     ptr = (void *) ((size_t *) ptr)[-1];
@@ -459,19 +886,37 @@ sc_set_log_defaults (FILE * log_stream,
   }
 
   sc_log_stream = log_stream;
+  SC_MUTEX_LOCK (&sc_package_mutex);
+  sc_log_cutoff_update ();
+  SC_MUTEX_UNLOCK (&sc_package_mutex);
 }
 
-void
-sc_log (const char *filename, int lineno,
-        int package, int category, int priority, const char *msg)
+/** Apply the filters common to all log streams.
+ * \return             True if the message may be logged at all.
+ */
+static int
+sc_log_is_valid (int category, int priority)
+{
+  if (!(category == SC_LC_NORMAL || category == SC_LC_GLOBAL))
+    return 0;
+  if (!(priority > SC_LP_ALWAYS && priority < SC_LP_SILENT))
+    return 0;
+  if (category == SC_LC_GLOBAL && sc_log_identifier () > 0)
+    return 0;
+  return 1;
+}
+
+/** Pass a valid message to the log handler for the text streams.
+ * \param [in] package  Must be a registered package id or -1.
+ */
+static void
+sc_log_text (const char *filename, int lineno,
+             int package, int category, int priority, const char *msg)
 {
   int                 log_threshold;
   sc_log_handler_t    log_handler;
   sc_package_t       *p;
 
-  if (package != -1 && !sc_package_is_registered (package)) {
-    package = -1;
-  }
   if (package == -1) {
     p = NULL;
     log_threshold = sc_default_log_threshold;
@@ -485,12 +930,6 @@ sc_log (const char *filename, int lineno,
     log_handler =
       (p->log_handler == NULL) ? sc_default_log_handler : p->log_handler;
   }
-  if (!(category == SC_LC_NORMAL || category == SC_LC_GLOBAL))
-    return;
-  if (!(priority > SC_LP_ALWAYS && priority < SC_LP_SILENT))
-    return;
-  if (category == SC_LC_GLOBAL && sc_identifier > 0)
-    return;
 
   if (sc_trace_file != NULL && priority >= sc_trace_prio)
     log_handler (sc_trace_file, filename, lineno,
@@ -501,6 +940,23 @@ sc_log (const char *filename, int lineno,
                  filename, lineno, package, category, priority, msg);
 }
 
+void
+sc_log (const char *filename, int lineno,
+        int package, int category, int priority, const char *msg)
+{
+  if (package != -1 && !sc_package_is_registered (package)) {
+    package = -1;
+  }
+  if (!sc_log_is_valid (category, priority)) {
+    return;
+  }
+
+  if (sc_trace_binary.header != NULL && priority >= sc_trace_prio) {
+    sc_trace_binary_record (filename, lineno, package, category, priority);
+  }
+  sc_log_text (filename, lineno, package, category, priority, msg);
+}
+
 void
 sc_logf (const char *filename, int lineno,
          int package, int category, int priority, const char *fmt, ...)
@@ -518,14 +974,74 @@ sc_logv (const char *filename, int lineno,
 {
   char                buffer[BUFSIZ];
 
+  if (sc_log_is_filtered (package, category, priority)) {
+    return;
+  }
+  if (package != -1 && !sc_package_is_registered (package)) {
+    package = -1;
+  }
+  if (!sc_log_is_valid (category, priority)) {
+    return;
+  }
+
+  /* the binary trace does not need the formatted message */
+  if (sc_trace_binary.header != NULL && priority >= sc_trace_prio) {
+    sc_trace_binary_record (filename, lineno, package, category, priority);
+  }
+  if (priority < sc_log_text_cutoff[category == SC_LC_GLOBAL][package + 1]) {
+    return;
+  }
+
   vsnprintf (buffer, BUFSIZ, fmt, ap);
-  sc_log (filename, lineno, package, category, priority, buffer);
+  sc_log_text (filename, lineno, package, category, priority, buffer);
+}
+
+/** Return true if this process does not print when aborting. */
+static int
+sc_abort_is_quiet (void)
+{
+  return sc_abort_quiet && !sc_is_root ();
+}
+
+/** Give the root process a short time to terminate the program first.
+ * The wait polls for at most SC_ABORT_WAIT_MS milliseconds.
+ */
+static void
+sc_abort_wait (void)
+{
+  int                 i;
+#ifdef SC_MPI
+  int                 flag;
+#endif
+#ifdef SC_HAVE_TIME_H
+  struct timespec     ts;
+
+  ts.tv_sec = 0;
+  ts.tv_nsec = SC_ABORT_POLL_MS * 1000000L;
+#endif
+
+  for (i = 0; i < SC_ABORT_WAIT_MS / SC_ABORT_POLL_MS; ++i) {
+#ifdef SC_MPI
+    /* keep pending messages of this process moving */
+    if (sc_mpicomm != MPI_COMM_NULL) {
+      (void) MPI_Iprobe (MPI_ANY_SOURCE, SC_TAG_ABORT, sc_mpicomm, &flag,
+                         MPI_STATUS_IGNORE);
+    }
+#endif
+#ifdef SC_HAVE_TIME_H
+    nanosleep (&ts, NULL);
+#else
+    sleep (1);
+    break;
+#endif
+  }
 }
 
 void
 sc_abort (void)
 {
-  if (0) {
+  if (sc_abort_is_quiet ()) {
+    /* the message has been printed without backtrace */
   }
 #ifdef SC_BACKTRACE
   else if (sc_print_backtrace) {
@@ -562,7 +1078,12 @@ sc_abort (void)
 
   fflush (stdout);
   fflush (stderr);
-  sleep (1);                    /* allow time for pending output */
+  if (sc_abort_is_quiet ()) {
+    sc_abort_wait ();           /* a failing root terminates first */
+  }
+  else {
+    sleep (1);                  /* allow time for pending output */
+  }
 
   if (sc_mpicomm != MPI_COMM_NULL) {
     MPI_Abort (sc_mpicomm, 1);  /* terminate all MPI processes */
@@ -573,6 +1094,11 @@ sc_abort (void)
 void
 sc_abort_verbose (const char *filename, int lineno, const char *msg)
 {
+  if (sc_abort_is_quiet ()) {
+    /* a single line without backtrace */
+    SC_LERRORF ("Abort: %s at %s:%d\n", msg, filename, lineno);
+    sc_abort ();
+  }
   SC_LERRORF ("Abort: %s\n", msg);
   SC_LERRORF ("Abort: %s:%d\n", filename, lineno);
   sc_abort ();
@@ -598,25 +1124,122 @@ sc_abort_verbosev (const char *filename, int lineno,
   sc_abort_verbose (filename, lineno, buffer);
 }
 
-void
-sc_abort_collective (const char *msg)
+static void
+sc_abort_report_add (sc_abort_report_t * report,
+                     int first_rank, int count, const char *text)
+{
+  int                 i;
+
+  for (i = 0; i < report->num_messages; ++i) {
+    if (!strcmp (report->messages[i].text, text)) {
+      report->messages[i].first_rank =
+        SC_MIN (report->messages[i].first_rank, first_rank);
+      report->messages[i].count += count;
+      return;
+    }
+  }
+  if (i == SC_ABORT_MAX_MESSAGES) {
+    report->num_dropped += count;
+    return;
+  }
+  report->messages[i].first_rank = first_rank;
+  report->messages[i].count = count;
+  snprintf (report->messages[i].text, SC_ABORT_MESSAGE_LENGTH, "%s", text);
+  ++report->num_messages;
+}
+
+/** Merge the abort messages of all processes on a binomial tree.
+ * The number of messages sent is the number of processes minus one,
+ * and each process receives at most log_2 of their number.
+ * \param [in] msg      The message of this process or NULL.
+ * \param [out] report  On the root, the distinct messages of all processes.
+ */
+static void
+sc_abort_gather (const char *msg, sc_abort_report_t * report)
 {
   int                 mpiret;
+  int                 i, k;
+  int                 num_procs, rank;
+  sc_abort_report_t   other;
 
+  report->num_messages = report->num_dropped = 0;
+  num_procs = 1;
+  rank = 0;
   if (sc_mpicomm != MPI_COMM_NULL) {
-    mpiret = MPI_Barrier (sc_mpicomm);
+    mpiret = MPI_Comm_size (sc_mpicomm, &num_procs);
     SC_CHECK_MPI (mpiret);
+    mpiret = MPI_Comm_rank (sc_mpicomm, &rank);
+    SC_CHECK_MPI (mpiret);
+  }
+  if (msg != NULL) {
+    sc_abort_report_add (report, rank, 1, msg);
+  }
+  for (k = 1; k < num_procs; k <<= 1) {
+    if (rank & k) {
+      mpiret = MPI_Send (report, (int) sizeof (*report), MPI_BYTE,
+                         rank - k, SC_TAG_ABORT, sc_mpicomm);
+      SC_CHECK_MPI (mpiret);
+      break;
+    }
+    if (rank + k < num_procs) {
+      mpiret = MPI_Recv (&other, (int) sizeof (other), MPI_BYTE,
+                         rank + k, SC_TAG_ABORT, sc_mpicomm,
+                         MPI_STATUS_IGNORE);
+      SC_CHECK_MPI (mpiret);
+      for (i = 0; i < other.num_messages; ++i) {
+        sc_abort_report_add (report, other.messages[i].first_rank,
+                             other.messages[i].count,
+                             other.messages[i].text);
+      }
+      report->num_dropped += other.num_dropped;
+    }
   }
+}
+
+void
+sc_abort_collective (const char *msg)
+{
+  int                 i;
+  sc_abort_report_t   report;
+
+  sc_abort_gather (msg, &report);
 
   if (sc_is_root ()) {
-    SC_ABORT (msg);
+    for (i = 0; i < report.num_messages; ++i) {
+      SC_LERRORF ("Abort: %s (%d process%s, first rank %d)\n",
+                  report.messages[i].text, report.messages[i].count,
+                  report.messages[i].count == 1 ? "" : "es",
+                  report.messages[i].first_rank);
+    }
+    if (report.num_dropped > 0) {
+      SC_LERRORF ("Abort: %d more processes with other messages\n",
+                  report.num_dropped);
+    }
+    sc_abort ();
   }
   else {
-    sleep (3);                  /* wait for root rank's MPI_Abort ()... */
+    sc_abort_wait ();           /* wait for root rank's MPI_Abort ()... */
     abort ();                   /* ... otherwise this may call MPI_Abort () */
   }
 }
 
+void
+sc_check_abort_collective (int success, const char *msg)
+{
+  int                 mpiret;
+  int                 failed, any_failed;
+
+  failed = any_failed = !success;
+  if (sc_mpicomm != MPI_COMM_NULL) {
+    mpiret = MPI_Allreduce (&failed, &any_failed, 1, MPI_INT, MPI_MAX,
+                            sc_mpicomm);
+    SC_CHECK_MPI (mpiret);
+  }
+  if (any_failed) {
+    sc_abort_collective (failed ? msg : NULL);
+  }
+}
+
 int
 sc_package_register (sc_log_handler_t log_handler, int log_threshold,
                      const char *name, const char *full)
@@ -624,7 +1247,6 @@ sc_package_register (sc_log_handler_t log_handler, int log_threshold,
   int                 i;
   sc_package_t       *p;
 
-  SC_CHECK_ABORT (sc_num_packages < SC_MAX_PACKAGES, "Too many packages");
   SC_CHECK_ABORT (log_threshold == SC_LP_DEFAULT ||
                   (log_threshold >= SC_LP_ALWAYS
                    && log_threshold <= SC_LP_SILENT),
@@ -633,6 +1255,9 @@ sc_package_register (sc_log_handler_t log_handler, int log_threshold,
   SC_CHECK_ABORT (strchr (name, ' ') == NULL,
                   "Packages name contains spaces");
 
+  SC_MUTEX_LOCK (&sc_package_mutex);
+  SC_CHECK_ABORT (sc_num_packages < SC_MAX_PACKAGES, "Too many packages");
+
   /* sc_packages is static and thus initialized to all zeros */
   for (i = 0; i < SC_MAX_PACKAGES; ++i) {
     p = sc_packages + i;
@@ -655,6 +1280,11 @@ sc_package_register (sc_log_handler_t log_handler, int log_threshold,
 
   ++sc_num_packages;
   SC_ASSERT (sc_num_packages <= SC_MAX_PACKAGES);
+  if (sc_trace_binary.header != NULL) {
+    sc_trace_package_name (i);
+  }
+  sc_log_cutoff_update ();
+  SC_MUTEX_UNLOCK (&sc_package_mutex);
 
   return i;
 }
@@ -678,6 +1308,7 @@ sc_package_unregister (int package_id)
                   "Package not registered");
   sc_memory_check (package_id);
 
+  SC_MUTEX_LOCK (&sc_package_mutex);
   p = sc_packages + package_id;
   p->is_registered = 0;
   p->log_handler = NULL;
@@ -686,6 +1317,8 @@ sc_package_unregister (int package_id)
   p->name = p->full = NULL;
 
   --sc_num_packages;
+  sc_log_cutoff_update ();
+  SC_MUTEX_UNLOCK (&sc_package_mutex);
 }
 
 void
@@ -716,10 +1349,12 @@ sc_init (MPI_Comm mpicomm,
   int                 w;
   const char         *trace_file_name;
   const char         *trace_file_prio;
+  const char         *trace_binary_name;
 
   sc_identifier = -1;
   sc_mpicomm = MPI_COMM_NULL;
   sc_print_backtrace = print_backtrace;
+  sc_abort_quiet = getenv ("SC_ABORT_QUIET") != NULL;
 
   if (mpicomm != MPI_COMM_NULL) {
     int                 mpiret;
@@ -746,7 +1381,14 @@ sc_init (MPI_Comm mpicomm,
     SC_CHECK_ABORT (sc_trace_file == NULL, "Trace file not NULL");
     sc_trace_file = fopen (buffer, "wb");
     SC_CHECK_ABORT (sc_trace_file != NULL, "Trace file open");
+  }
 
+  trace_binary_name = getenv ("SC_TRACE_BINARY");
+  if (trace_binary_name != NULL) {
+    sc_trace_binary_open (trace_binary_name);
+  }
+
+  if (trace_file_name != NULL || trace_binary_name != NULL) {
     trace_file_prio = getenv ("SC_TRACE_LP");
     if (trace_file_prio != NULL) {
       if (!strcmp (trace_file_prio, "SC_LP_TRACE")) {
@@ -778,6 +1420,12 @@ sc_init (MPI_Comm mpicomm,
       }
     }
   }
+  SC_MUTEX_LOCK (&sc_package_mutex);
+  sc_log_cutoff_update ();
+  SC_MUTEX_UNLOCK (&sc_package_mutex);
+
+  /* choose the collective algorithms, possibly by a benchmark */
+  sc_tune_init (sc_mpicomm);
 
   w = 24;
   SC_GLOBAL_ESSENTIALF ("This is %s\n", SC_PACKAGE_STRING);
@@ -813,21 +1461,28 @@ sc_finalize (void)
   sc_mpicomm = MPI_COMM_NULL;
 
   sc_print_backtrace = 0;
+  sc_abort_quiet = 0;
   sc_identifier = -1;
 
-  /* close trace file */
+  /* close trace files */
   if (sc_trace_file != NULL) {
     retval = fclose (sc_trace_file);
     SC_CHECK_ABORT (!retval, "Trace file close");
 
     sc_trace_file = NULL;
   }
+  sc_trace_binary_close ();
+  sc_flops_perf_close ();
+  SC_MUTEX_LOCK (&sc_package_mutex);
+  sc_log_cutoff_update ();
+  SC_MUTEX_UNLOCK (&sc_package_mutex);
+  sc_tune_reset ();
 }
 
 int
 sc_is_root (void)
 {
-  return sc_identifier <= 0;
+  return sc_log_identifier () <= 0;
 }
 
 /* enable logging for files compiled with C++ */
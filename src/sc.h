@@ -81,10 +81,16 @@ SC_EXTERN_C_BEGIN;
 extern const int    sc_log2_lookup_table[256];
 extern int          sc_package_id;
 
-/* control a trace file by environment variables (see sc_init) */
+/* control trace files by environment variables (see sc_init) */
 extern FILE        *sc_trace_file;
 extern int          sc_trace_prio;
 
+/* runtime log cutoff indexed by [category == SC_LC_GLOBAL][package + 1].
+ * It is maintained by sc_init, sc_set_log_defaults and package registration
+ * and lets the log macros skip argument evaluation and formatting. */
+#define SC_MAX_PACKAGES 128
+extern int          sc_log_cutoff[2][SC_MAX_PACKAGES + 1];
+
 /* define math constants if necessary */
 #ifndef M_E
 #define M_E 2.7182818284590452354       /* e */
@@ -147,6 +153,7 @@ extern int          sc_trace_prio;
 #define SC_CHECK_ABORT(q,s)                     \
   ((q) ? (void) 0 : SC_ABORT (s))
 #define SC_CHECK_MPI(r) SC_CHECK_ABORT ((r) == MPI_SUCCESS, "MPI error")
+#define SC_CHECK_ABORT_COLLECTIVE(q,s) sc_check_abort_collective ((q), (s))
 
 /*
  * C++98 does not allow variadic macros
@@ -259,6 +266,10 @@ void                SC_CHECK_ABORTF (int success, const char *fmt, ...)
 #define SC_LP_ESSENTIAL   7     /* this logs a few lines max per program */
 #define SC_LP_ERROR       8     /* this logs errors only */
 #define SC_LP_SILENT      9     /* this never logs anything */
+
+/* The compile-time threshold removes log calls of lower priority entirely.
+ * It may be predefined on the command line to strip logging per file. */
+#ifndef SC_LP_THRESHOLD
 #ifdef SC_LOG_PRIORITY
 #define SC_LP_THRESHOLD SC_LOG_PRIORITY
 #else
@@ -268,10 +279,23 @@ void                SC_CHECK_ABORTF (int success, const char *fmt, ...)
 #define SC_LP_THRESHOLD SC_LP_INFO
 #endif
 #endif
+#endif
+
+/* the entry of sc_log_cutoff for a package; invalid ids use entry 0
+ * and are reported by sc_log unless the message is filtered */
+#define SC_LOG_CUTOFF_INDEX(package)                                    \
+  ((unsigned) ((package) + 1) <= (unsigned) SC_MAX_PACKAGES ?           \
+   (package) + 1 : 0)
+
+/* true if a message may be logged; checked before evaluating arguments */
+#define SC_LOG_IS_ACTIVE(package,category,priority)                     \
+  ((priority) >= SC_LP_THRESHOLD &&                                     \
+   (priority) >= sc_log_cutoff[(category) == SC_LC_GLOBAL]              \
+   [SC_LOG_CUTOFF_INDEX (package)])
 
 /* generic log macros */
 #define SC_GEN_LOG(package,category,priority,s)                         \
-  ((priority) < SC_LP_THRESHOLD ? (void) 0 :                            \
+  (!SC_LOG_IS_ACTIVE ((package), (category), (priority)) ? (void) 0 :   \
    sc_log (__FILE__, __LINE__, (package), (category), (priority), (s)))
 #define SC_GLOBAL_LOG(p,s) SC_GEN_LOG (sc_package_id, SC_LC_GLOBAL, (p), (s))
 #define SC_LOG(p,s) SC_GEN_LOG (sc_package_id, SC_LC_NORMAL, (p), (s))
@@ -284,7 +308,7 @@ void                SC_LOGF (int priority, const char *fmt, ...)
   __attribute__ ((format (printf, 2, 3)));
 #ifndef __cplusplus
 #define SC_GEN_LOGF(package,category,priority,fmt,...)                  \
-  ((priority) < SC_LP_THRESHOLD ? (void) 0 :                            \
+  (!SC_LOG_IS_ACTIVE ((package), (category), (priority)) ? (void) 0 :   \
    sc_logf (__FILE__, __LINE__, (package), (category), (priority),      \
             (fmt), __VA_ARGS__))
 #define SC_GLOBAL_LOGF(p,fmt,...)                                       \
@@ -420,6 +444,7 @@ void                sc_set_log_defaults (FILE * log_stream,
 
 /** The central log function to be called by all packages.
  * Dispatches the log calls by package and filters by category and priority.
+ * sc_logf and sc_logv return before formatting if the message is filtered.
  * \param [in] package   Must be a registered package id or -1.
  * \param [in] category  Must be SC_LC_NORMAL or SC_LC_GLOBAL.
  * \param [in] priority  Must be > SC_LP_ALWAYS and < SC_LP_SILENT.
@@ -435,7 +460,13 @@ void                sc_logv (const char *filename, int lineno,
                              int package, int category, int priority,
                              const char *fmt, va_list ap);
 
-/** Print a stack trace, call the abort handler and then call abort (). */
+/** Print a stack trace, call the abort handler and then call abort ().
+ * If the environment variable SC_ABORT_QUIET is set during sc_init,
+ * processes other than the root print the message of SC_ABORT and
+ * SC_CHECK_ABORT in a single line without backtrace.  They wait for at
+ * most a second before MPI_Abort, so that a failing root terminates
+ * the program first.
+ */
 void                sc_abort (void)
   __attribute__ ((noreturn));
 
@@ -455,12 +486,27 @@ void                sc_abort_verbosev (const char *filename, int lineno,
                                        const char *fmt, va_list ap)
   __attribute__ ((noreturn));
 
-/** Collective abort where only root prints a message */
+/** Collective abort where only root prints a message.
+ * The messages of all processes are merged on a binomial tree such that
+ * the root prints each distinct message once with the number of processes
+ * and the lowest rank reporting it.  The other processes abort quietly.
+ * \param [in] msg      Message of this process, may be NULL.
+ */
 void                sc_abort_collective (const char *msg)
   __attribute__ ((noreturn));
 
+/** Collective check that aborts if it fails on any process.
+ * The processes agree on failure by a reduction of one integer.
+ * On failure, the messages are reported as in sc_abort_collective.
+ * \param [in] success  True if the check succeeds on this process.
+ * \param [in] msg      Message printed if the check fails.
+ */
+void                sc_check_abort_collective (int success, const char *msg);
+
 /** Register a software package with SC.
  * The logging parameters are as in sc_set_log_defaults.
+ * If configured with --enable-pthread, registering and unregistering
+ * packages, logging and the memory counters are thread-safe.
  * \return                   Returns a unique package id.
  */
 int                 sc_package_register (sc_log_handler_t log_handler,
@@ -482,6 +528,9 @@ void                sc_package_print_summary (int log_priority);
  * If this function is not called or called with log_threshold == SC_LP_DEFAULT,
  * the default SC log threshold will be used.
  * The default SC log settings can be changed with sc_set_log_defaults ().
+ * The environment variable SC_TRACE_FILE opens a per-rank text trace file,
+ * SC_TRACE_BINARY a per-rank binary trace file as described in sc_trace.h.
+ * Both log all messages of priority SC_TRACE_LP and above.
  * \param [in] mpicomm          MPI communicator, can be MPI_COMM_NULL.
  *                              If MPI_COMM_NULL, the identifier is set to -1.
  *                              Otherwise, MPI_Init must have been called.
@@ -23,15 +23,21 @@
 #ifndef SC_ALLGATHER_H
 #define SC_ALLGATHER_H
 
-#include <sc.h>
+#include <sc_coll.h>
 
+/* default of sc_tune_ag_alltoall_max */
 #ifndef SC_AG_ALLTOALL_MAX
 #define SC_AG_ALLTOALL_MAX      5
 #endif
 
+/* default of sc_tune_ag_chunk_max: larger messages are split */
+#ifndef SC_AG_CHUNK_MAX
+#define SC_AG_CHUNK_MAX         INT_MAX
+#endif
+
 SC_EXTERN_C_BEGIN;
 
-#ifdef SC_MPI
+#ifdef SC_MPI_RANKS
 
 /** Allgather by direct point-to-point communication.
  * Only makes sense for small group sizes.
@@ -47,15 +53,43 @@ void                sc_ag_recursive (MPI_Comm mpicomm, char *data,
                                      int datasize, int groupsize,
                                      int myoffset, int myrank);
 
-#endif /* SC_MPI */
+#endif /* SC_MPI_RANKS */
 
 /** Drop-in allgather replacement.
+ * The total size of the received data may exceed 2 GiB.
  */
 int                 sc_allgather (void *sendbuf, int sendcount,
                                   MPI_Datatype sendtype, void *recvbuf,
                                   int recvcount, MPI_Datatype recvtype,
                                   MPI_Comm mpicomm);
 
+/** Drop-in MPI_Allgatherv replacement with the schedule of sc_allgather.
+ * The contribution of each process and the total received data may
+ * exceed 2 GiB, as long as counts and displacements fit into an int.
+ * \param [in] recvcounts  Number of elements received from each process.
+ * \param [in] displs      Offset of each process's data in recvbuf in
+ *                         units of recvtype.  If the data is not stored
+ *                         contiguously in rank order, it is gathered into
+ *                         a temporary buffer first.
+ *                         The sendbuf may coincide with its place in
+ *                         recvbuf if the data is contiguous.
+ */
+int                 sc_allgatherv (void *sendbuf, int sendcount,
+                                   MPI_Datatype sendtype, void *recvbuf,
+                                   int *recvcounts, int *displs,
+                                   MPI_Datatype recvtype, MPI_Comm mpicomm);
+
+/** Nonblocking allgather with the schedule of sc_allgather.
+ * The buffers must not be accessed before the request is complete.
+ * The total size of the received data is limited to 2 GiB.
+ * \param [out] request    Completed by sc_coll_test or sc_coll_wait.
+ */
+int                 sc_iallgather (void *sendbuf, int sendcount,
+                                   MPI_Datatype sendtype, void *recvbuf,
+                                   int recvcount, MPI_Datatype recvtype,
+                                   MPI_Comm mpicomm,
+                                   sc_coll_request_t ** request);
+
 SC_EXTERN_C_END;
 
 #endif /* !SC_ALLGATHER_H */
@@ -22,6 +22,136 @@
 
 #include <sc_amr.h>
 
+/** Return the position of a value in the histogram between 0 and bins.
+ * The bins divide the range of the global errors evenly, on a logarithmic
+ * scale if all errors are positive.
+ */
+static double
+sc_amr_histogram_position (const sc_amr_control_t * amr, double value)
+{
+  const double        emin = amr->estats.min;
+  const double        emax = amr->estats.max;
+  double              position;
+
+  if (!(value > emin)) {
+    return 0.;
+  }
+  if (!(value < emax)) {
+    return (double) SC_AMR_HISTOGRAM_BINS;
+  }
+  if (emin > 0.) {
+    position = log (value / emin) / log (emax / emin);
+  }
+  else {
+    position = (value - emin) / (emax - emin);
+  }
+  return SC_MIN (position * SC_AMR_HISTOGRAM_BINS,
+                 (double) SC_AMR_HISTOGRAM_BINS);
+}
+
+/** Return the value at a position in the histogram. */
+static double
+sc_amr_histogram_value (const sc_amr_control_t * amr, double position)
+{
+  const double        emin = amr->estats.min;
+  const double        emax = amr->estats.max;
+
+  position /= SC_AMR_HISTOGRAM_BINS;
+  if (emin > 0.) {
+    return emin * pow (emax / emin, position);
+  }
+  return emin + position * (emax - emin);
+}
+
+/** Compute the global histogram of the errors in one reduction.
+ * \param [in] num_extra       Number of additional values to sum.
+ * \param [in] local_extra     Local values summed with the histogram.
+ * \param [out] global_extra   Global sums of these values.
+ */
+static void
+sc_amr_histogram_compute (sc_amr_control_t * amr, int num_extra,
+                          const long *local_extra, long *global_extra)
+{
+  int                 mpiret;
+  int                 b;
+  long                i;
+  long               *local, *global;
+
+  local = SC_ALLOC_ZERO (long, 2 * (SC_AMR_HISTOGRAM_BINS + num_extra));
+  global = local + SC_AMR_HISTOGRAM_BINS + num_extra;
+  for (i = 0; i < amr->num_local_elements; ++i) {
+    b = (int) sc_amr_histogram_position (amr, amr->errors[i]);
+    ++local[SC_MIN (b, SC_AMR_HISTOGRAM_BINS - 1)];
+  }
+  for (b = 0; b < num_extra; ++b) {
+    local[SC_AMR_HISTOGRAM_BINS + b] = local_extra[b];
+  }
+  mpiret = MPI_Allreduce (local, global, SC_AMR_HISTOGRAM_BINS + num_extra,
+                          MPI_LONG, MPI_SUM, amr->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  memcpy (amr->histogram, global, SC_AMR_HISTOGRAM_BINS * sizeof (long));
+  for (b = 0; b < num_extra; ++b) {
+    global_extra[b] = global[SC_AMR_HISTOGRAM_BINS + b];
+  }
+  amr->histogram_valid = 1;
+  SC_FREE (local);
+}
+
+/** Estimate the global number of errors below a threshold. */
+static double
+sc_amr_histogram_below (const sc_amr_control_t * amr, double threshold)
+{
+  int                 b, bin;
+  double              position, count;
+
+  SC_ASSERT (amr->histogram_valid);
+
+  position = sc_amr_histogram_position (amr, threshold);
+  bin = (int) position;
+  count = 0.;
+  for (b = 0; b < bin; ++b) {
+    count += (double) amr->histogram[b];
+  }
+  if (bin < SC_AMR_HISTOGRAM_BINS) {
+    count += (position - bin) * amr->histogram[bin];
+  }
+  return count;
+}
+
+/** Estimate the threshold that has a number of errors below it.
+ * Within a bin the errors are assumed to be evenly distributed.
+ */
+static double
+sc_amr_histogram_threshold (const sc_amr_control_t * amr, double count)
+{
+  int                 b;
+  double              cumulative, next;
+
+  SC_ASSERT (amr->histogram_valid);
+
+  cumulative = 0.;
+  for (b = 0; b < SC_AMR_HISTOGRAM_BINS; ++b) {
+    next = cumulative + (double) amr->histogram[b];
+    if (next >= count && amr->histogram[b] > 0) {
+      return sc_amr_histogram_value (amr, b + SC_MAX (count - cumulative, 0.)
+                                     / amr->histogram[b]);
+    }
+    cumulative = next;
+  }
+  return amr->estats.max;
+}
+
+/** Return the ratio of counted elements to errors in the histogram.
+ * Without information the ratio is assumed to be one.
+ */
+static double
+sc_amr_histogram_ratio (long global_count, double histogram_count)
+{
+  return global_count > 0 && histogram_count > 0. ?
+    global_count / histogram_count : 1.;
+}
+
 void
 sc_amr_error_stats (MPI_Comm mpicomm, long num_elements,
                     const double *restrict errors, sc_amr_control_t * amr)
@@ -30,29 +160,18 @@ sc_amr_error_stats (MPI_Comm mpicomm, long num_elements,
   int                 mpiret;
   int                 mpisize;
   long                i;
-  double              sum, squares, emin, emax;
 
   mpiret = MPI_Comm_size (mpicomm, &mpisize);
   SC_CHECK_MPI (mpiret);
 
   amr->errors = errors;
+  amr->num_local_elements = num_elements;
+  amr->histogram_valid = 0;
 
-  sum = squares = 0.;
-  emin = DBL_MAX;
-  emax = -DBL_MAX;
+  sc_stats_init (si, NULL);
   for (i = 0; i < num_elements; ++i) {
-    sum += errors[i];
-    squares += errors[i] * errors[i];
-    emin = SC_MIN (emin, errors[i]);
-    emax = SC_MAX (emax, errors[i]);
+    sc_stats_accumulate (si, errors[i]);
   }
-  si->dirty = 1;
-  si->count = num_elements;
-  si->sum_values = sum;
-  si->sum_squares = squares;
-  si->min = emin;
-  si->max = emax;
-  si->variable = NULL;
   sc_stats_compute (mpicomm, 1, si);
 
   amr->mpicomm = mpicomm;
@@ -96,11 +215,12 @@ sc_amr_coarsen_specify (int package_id,
                amr->num_total_coarsen);
 }
 
-void
-sc_amr_coarsen_search (int package_id, sc_amr_control_t * amr,
-                       long num_total_low, double coarsen_threshold_high,
-                       double target_window, int max_binary_steps,
-                       sc_amr_count_coarsen_fn cfn, void *user_data)
+static void
+sc_amr_coarsen_search_mode (int package_id, sc_amr_control_t * amr,
+                            long num_total_low, double coarsen_threshold_high,
+                            double target_window, int max_binary_steps,
+                            sc_amr_count_coarsen_fn cfn, void *user_data,
+                            int use_histogram)
 {
   const sc_statinfo_t *errors = &amr->estats;
   const long          num_total_elements = amr->num_total_elements;
@@ -110,6 +230,7 @@ sc_amr_coarsen_search (int package_id, sc_amr_control_t * amr,
   long                local_coarsen, global_coarsen;
   long                num_total_high, num_total_estimated;
   double              coarsen_threshold_low;
+  double              guess, threshold, ratio;
 
   SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
                "Search for coarsen threshold assuming %ld refinements\n",
@@ -143,9 +264,14 @@ sc_amr_coarsen_search (int package_id, sc_amr_control_t * amr,
 
     /* call back to count the elements to coarsen locally */
     local_coarsen = cfn (amr, user_data);
-    mpiret = MPI_Allreduce (&local_coarsen, &global_coarsen, 1, MPI_LONG,
-                            MPI_SUM, amr->mpicomm);
-    SC_CHECK_MPI (mpiret);
+    if (use_histogram && !amr->histogram_valid) {
+      sc_amr_histogram_compute (amr, 1, &local_coarsen, &global_coarsen);
+    }
+    else {
+      mpiret = MPI_Allreduce (&local_coarsen, &global_coarsen, 1, MPI_LONG,
+                              MPI_SUM, amr->mpicomm);
+      SC_CHECK_MPI (mpiret);
+    }
     num_total_estimated =
       num_total_elements + num_total_refine - global_coarsen;
     SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
@@ -176,9 +302,25 @@ sc_amr_coarsen_search (int package_id, sc_amr_control_t * amr,
                  num_total_low, coarsen_threshold_low,
                  coarsen_threshold_high);
 
+    /* predict the threshold from the histogram if possible */
+    guess = (coarsen_threshold_low + coarsen_threshold_high) / 2.;
+    if (use_histogram) {
+      ratio = sc_amr_histogram_ratio
+        (global_coarsen, sc_amr_histogram_below (amr, amr->coarsen_threshold));
+      threshold = sc_amr_histogram_threshold
+        (amr, (num_total_elements + num_total_refine -
+               .5 * (num_total_low + num_total_high)) / ratio);
+      if (coarsen_threshold_low < threshold &&
+          threshold < coarsen_threshold_high) {
+        SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
+                     "Histogram predicts threshold %g with ratio %g\n",
+                     threshold, ratio);
+        guess = threshold;
+      }
+    }
+
     /* compute next guess for binary search */
-    amr->coarsen_threshold =
-      (coarsen_threshold_low + coarsen_threshold_high) / 2.;
+    amr->coarsen_threshold = guess;
   }
   amr->num_total_coarsen = global_coarsen;
   amr->num_total_estimated = num_total_estimated;
@@ -196,10 +338,35 @@ sc_amr_coarsen_search (int package_id, sc_amr_control_t * amr,
 }
 
 void
-sc_amr_refine_search (int package_id, sc_amr_control_t * amr,
-                      long num_total_high, double refine_threshold_low,
-                      double target_window, int max_binary_steps,
-                      sc_amr_count_refine_fn rfn, void *user_data)
+sc_amr_coarsen_search (int package_id, sc_amr_control_t * amr,
+                       long num_total_low, double coarsen_threshold_high,
+                       double target_window, int max_binary_steps,
+                       sc_amr_count_coarsen_fn cfn, void *user_data)
+{
+  sc_amr_coarsen_search_mode (package_id, amr, num_total_low,
+                              coarsen_threshold_high, target_window,
+                              max_binary_steps, cfn, user_data, 0);
+}
+
+void
+sc_amr_coarsen_search_histogram (int package_id, sc_amr_control_t * amr,
+                                 long num_total_low,
+                                 double coarsen_threshold_high,
+                                 double target_window, int max_binary_steps,
+                                 sc_amr_count_coarsen_fn cfn,
+                                 void *user_data)
+{
+  sc_amr_coarsen_search_mode (package_id, amr, num_total_low,
+                              coarsen_threshold_high, target_window,
+                              max_binary_steps, cfn, user_data, 1);
+}
+
+static void
+sc_amr_refine_search_mode (int package_id, sc_amr_control_t * amr,
+                           long num_total_high, double refine_threshold_low,
+                           double target_window, int max_binary_steps,
+                           sc_amr_count_refine_fn rfn, void *user_data,
+                           int use_histogram)
 {
   const sc_statinfo_t *errors = &amr->estats;
   const long          num_total_elements = amr->num_total_elements;
@@ -209,6 +376,7 @@ sc_amr_refine_search (int package_id, sc_amr_control_t * amr,
   long                local_refine, global_refine;
   long                num_total_low, num_total_estimated;
   double              refine_threshold_high;
+  double              guess, threshold, ratio;
 
   SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
                "Search for refine threshold assuming %ld coarsenings\n",
@@ -242,9 +410,14 @@ sc_amr_refine_search (int package_id, sc_amr_control_t * amr,
 
     /* call back to count the elements to refine locally */
     local_refine = rfn (amr, user_data);
-    mpiret = MPI_Allreduce (&local_refine, &global_refine, 1, MPI_LONG,
-                            MPI_SUM, amr->mpicomm);
-    SC_CHECK_MPI (mpiret);
+    if (use_histogram && !amr->histogram_valid) {
+      sc_amr_histogram_compute (amr, 1, &local_refine, &global_refine);
+    }
+    else {
+      mpiret = MPI_Allreduce (&local_refine, &global_refine, 1, MPI_LONG,
+                              MPI_SUM, amr->mpicomm);
+      SC_CHECK_MPI (mpiret);
+    }
     num_total_estimated =
       num_total_elements + global_refine - num_total_coarsen;
     SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
@@ -274,9 +447,27 @@ sc_amr_refine_search (int package_id, sc_amr_control_t * amr,
                  "Binary search for %ld elements at low = %g, up = %g\n",
                  num_total_high, refine_threshold_low, refine_threshold_high);
 
+    /* predict the threshold from the histogram if possible */
+    guess = (refine_threshold_low + refine_threshold_high) / 2.;
+    if (use_histogram) {
+      ratio = sc_amr_histogram_ratio
+        (global_refine, num_total_elements -
+         sc_amr_histogram_below (amr, amr->refine_threshold));
+      threshold = sc_amr_histogram_threshold
+        (amr, num_total_elements -
+         (.5 * (num_total_low + num_total_high) - num_total_elements +
+          num_total_coarsen) / ratio);
+      if (refine_threshold_low < threshold &&
+          threshold < refine_threshold_high) {
+        SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
+                     "Histogram predicts threshold %g with ratio %g\n",
+                     threshold, ratio);
+        guess = threshold;
+      }
+    }
+
     /* compute next guess for binary search */
-    amr->refine_threshold =
-      (refine_threshold_low + refine_threshold_high) / 2.;
+    amr->refine_threshold = guess;
   }
   amr->num_total_refine = global_refine;
   amr->num_total_estimated = num_total_estimated;
@@ -291,3 +482,197 @@ sc_amr_refine_search (int package_id, sc_amr_control_t * amr,
                "Estimated global number of elements = %ld\n",
                amr->num_total_estimated);
 }
+
+void
+sc_amr_refine_search (int package_id, sc_amr_control_t * amr,
+                      long num_total_high, double refine_threshold_low,
+                      double target_window, int max_binary_steps,
+                      sc_amr_count_refine_fn rfn, void *user_data)
+{
+  sc_amr_refine_search_mode (package_id, amr, num_total_high,
+                             refine_threshold_low, target_window,
+                             max_binary_steps, rfn, user_data, 0);
+}
+
+void
+sc_amr_refine_search_histogram (int package_id, sc_amr_control_t * amr,
+                                long num_total_high,
+                                double refine_threshold_low,
+                                double target_window, int max_binary_steps,
+                                sc_amr_count_refine_fn rfn, void *user_data)
+{
+  sc_amr_refine_search_mode (package_id, amr, num_total_high,
+                             refine_threshold_low, target_window,
+                             max_binary_steps, rfn, user_data, 1);
+}
+
+/** Estimate the global number of elements from the histogram.
+ * \param [in] coarsen_ratio    Coarsenings per error below the threshold.
+ * \param [in] refine_ratio     Refinements per error above the threshold.
+ */
+static double
+sc_amr_joint_estimate (const sc_amr_control_t * amr, double threshold,
+                       double refine_coarsen_ratio,
+                       double coarsen_ratio, double refine_ratio)
+{
+  const double        num_total = (double) amr->num_total_elements;
+
+  return num_total + refine_ratio *
+    (num_total - sc_amr_histogram_below (amr, refine_coarsen_ratio *
+                                         threshold)) -
+    coarsen_ratio * sc_amr_histogram_below (amr, threshold);
+}
+
+/** Predict the coarsening threshold that yields the ideal number.
+ * The estimate decreases with the threshold and is bisected between the
+ * bounds in histogram coordinates, which requires no communication.
+ */
+static double
+sc_amr_joint_predict (const sc_amr_control_t * amr, double ideal,
+                      double low, double high, double refine_coarsen_ratio,
+                      double coarsen_ratio, double refine_ratio)
+{
+  int                 k;
+  double              plow, phigh, pmid, threshold;
+
+  plow = sc_amr_histogram_position (amr, low);
+  phigh = sc_amr_histogram_position (amr, high);
+  for (k = 0; k < 50; ++k) {
+    pmid = .5 * (plow + phigh);
+    threshold = sc_amr_histogram_value (amr, pmid);
+    if (sc_amr_joint_estimate (amr, threshold, refine_coarsen_ratio,
+                               coarsen_ratio, refine_ratio) > ideal) {
+      plow = pmid;
+    }
+    else {
+      phigh = pmid;
+    }
+  }
+  return sc_amr_histogram_value (amr, .5 * (plow + phigh));
+}
+
+void
+sc_amr_joint_search (int package_id, sc_amr_control_t * amr,
+                     long num_total_ideal, double refine_coarsen_ratio,
+                     double target_window, int max_binary_steps,
+                     sc_amr_count_coarsen_fn cfn, sc_amr_count_refine_fn rfn,
+                     void *user_data)
+{
+  const sc_statinfo_t *errors = &amr->estats;
+  const long          num_total_elements = amr->num_total_elements;
+  int                 mpiret;
+  int                 binary_count;
+  long                local_counts[2], global_counts[2];
+  long                num_total_low, num_total_high, num_total_estimated;
+  double              coarsen_threshold_low, coarsen_threshold_high;
+  double              coarsen_ratio, refine_ratio;
+  double              guess, threshold;
+
+  SC_ASSERT (refine_coarsen_ratio >= 1.);
+
+  SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
+               "Joint search for thresholds with ratio %g\n",
+               refine_coarsen_ratio);
+
+  /* without elements or callbacks there is nothing to search */
+  if (num_total_elements == 0 || (cfn == NULL && rfn == NULL)) {
+    SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
+                 "Joint search skipped with %ld elements\n",
+                 num_total_elements);
+
+    amr->coarsen_threshold = errors->min;
+    amr->refine_threshold = errors->max;
+    amr->num_total_coarsen = amr->num_total_refine = 0;
+    amr->num_total_estimated = num_total_elements;
+    return;
+  }
+
+  /* fix range of acceptable total element counts */
+  num_total_low = (long) (num_total_ideal * sqrt (target_window));
+  num_total_high = (long) (num_total_ideal / sqrt (target_window));
+  SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_INFO,
+               "Range of acceptable total element counts %ld %ld\n",
+               num_total_low, num_total_high);
+
+  /* the first guess assumes one element change per error */
+  if (!amr->histogram_valid) {
+    sc_amr_histogram_compute (amr, 0, NULL, NULL);
+  }
+  coarsen_threshold_low = errors->min;
+  coarsen_threshold_high = errors->max;
+  coarsen_ratio = refine_ratio = 1.;
+  for (binary_count = 0;; ++binary_count) {
+
+    /* predict the threshold from the histogram if possible */
+    guess = (coarsen_threshold_low + coarsen_threshold_high) / 2.;
+    threshold = sc_amr_joint_predict (amr, (double) num_total_ideal,
+                                      coarsen_threshold_low,
+                                      coarsen_threshold_high,
+                                      refine_coarsen_ratio,
+                                      coarsen_ratio, refine_ratio);
+    if (coarsen_threshold_low < threshold &&
+        threshold < coarsen_threshold_high) {
+      guess = threshold;
+    }
+    amr->coarsen_threshold = guess;
+    amr->refine_threshold = refine_coarsen_ratio * guess;
+
+    /* call back to count both changes and sum them in one reduction */
+    local_counts[0] = cfn == NULL ? 0 : cfn (amr, user_data);
+    local_counts[1] = rfn == NULL ? 0 : rfn (amr, user_data);
+    mpiret = MPI_Allreduce (local_counts, global_counts, 2, MPI_LONG,
+                            MPI_SUM, amr->mpicomm);
+    SC_CHECK_MPI (mpiret);
+    num_total_estimated =
+      num_total_elements + global_counts[1] - global_counts[0];
+    SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
+                 "At %g %g total %ld estimated %ld coarsen %ld refine %ld\n",
+                 amr->coarsen_threshold, amr->refine_threshold,
+                 num_total_elements, num_total_estimated,
+                 global_counts[0], global_counts[1]);
+
+    /* check loop condition */
+    if (binary_count == max_binary_steps) {
+      break;
+    }
+
+    /* binary search action */
+    if (num_total_estimated < num_total_low) {
+      coarsen_threshold_high = amr->coarsen_threshold;
+    }
+    else if (num_total_estimated > num_total_high) {
+      coarsen_threshold_low = amr->coarsen_threshold;
+    }
+    else {                      /* binary search sucessful */
+      break;
+    }
+    if (!(coarsen_threshold_low < coarsen_threshold_high)) {
+      break;                    /* the window cannot be reached */
+    }
+
+    /* learn the element changes per error in the histogram */
+    coarsen_ratio = sc_amr_histogram_ratio
+      (global_counts[0], sc_amr_histogram_below (amr, amr->coarsen_threshold));
+    refine_ratio = sc_amr_histogram_ratio
+      (global_counts[1], num_total_elements -
+       sc_amr_histogram_below (amr, amr->refine_threshold));
+    SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
+                 "Joint search for %ld elements at low = %g, up = %g\n",
+                 num_total_ideal, coarsen_threshold_low,
+                 coarsen_threshold_high);
+  }
+  amr->num_total_coarsen = global_counts[0];
+  amr->num_total_refine = global_counts[1];
+  amr->num_total_estimated = num_total_estimated;
+
+  /* joint search is ended */
+  SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
+               "Joint search stopped after %d steps with thresholds %g %g\n",
+               binary_count, amr->coarsen_threshold, amr->refine_threshold);
+  SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_STATISTICS,
+               "Global number of coarsenings = %ld refinements = %ld\n",
+               amr->num_total_coarsen, amr->num_total_refine);
+  SC_GEN_LOGF (package_id, SC_LC_GLOBAL, SC_LP_INFO,
+               "Estimated global number of elements = %ld\n",
+               amr->num_total_estimated);
+}
@@ -27,18 +27,24 @@
 
 SC_EXTERN_C_BEGIN;
 
+/** Number of bins of the global error histogram. */
+#define SC_AMR_HISTOGRAM_BINS 128
+
 typedef struct sc_amr_control
 {
   const double       *restrict errors;
   sc_statinfo_t       estats;
   MPI_Comm            mpicomm;
   long                num_procs_long;
+  long                num_local_elements;
   long                num_total_elements;
   double              coarsen_threshold;
   double              refine_threshold;
   long                num_total_coarsen;
   long                num_total_refine;
   long                num_total_estimated;
+  int                 histogram_valid;  /* histogram is computed */
+  long                histogram[SC_AMR_HISTOGRAM_BINS];
 }
 sc_amr_control_t;
 
@@ -130,6 +136,76 @@ void                sc_amr_refine_search (int package_id,
                                           sc_amr_count_refine_fn rfn,
                                           void *user_data);
 
+/** Search for coarsening threshold using a histogram of the errors.
+ * This is sc_amr_coarsen_search with fewer collective calls.
+ * The global histogram is computed together with the first count.
+ * It has SC_AMR_HISTOGRAM_BINS bins on a logarithmic scale between the
+ * minimum and maximum errors, or on a linear scale if some error is not
+ * positive.  Each following threshold is chosen where the histogram
+ * predicts the target count, scaled by the ratio of the last counted
+ * coarsenings to the errors below the threshold.  The binary search
+ * takes over only if a prediction leaves the current bounds.
+ * The parameters are the same as for sc_amr_coarsen_search.
+ */
+void                sc_amr_coarsen_search_histogram (int package_id,
+                                                     sc_amr_control_t * amr,
+                                                     long num_total_ideal,
+                                                     double
+                                                     coarsen_threshold_high,
+                                                     double target_window,
+                                                     int max_binary_steps,
+                                                     sc_amr_count_coarsen_fn
+                                                     cfn, void *user_data);
+
+/** Search for refinement threshold using a histogram of the errors.
+ * This is sc_amr_refine_search with the choice of thresholds as
+ * described for sc_amr_coarsen_search_histogram.
+ * The parameters are the same as for sc_amr_refine_search.
+ */
+void                sc_amr_refine_search_histogram (int package_id,
+                                                    sc_amr_control_t * amr,
+                                                    long num_total_ideal,
+                                                    double
+                                                    refine_threshold_low,
+                                                    double target_window,
+                                                    int max_binary_steps,
+                                                    sc_amr_count_refine_fn
+                                                    rfn, void *user_data);
+
+/** Search for coarsening and refinement thresholds together.
+ * The refinement threshold is the coarsening threshold times a fixed
+ * ratio, such that a larger coarsening threshold yields fewer elements.
+ * Each step counts both coarsenings and refinements and sums them in
+ * a single reduction of two numbers.  The steps are predicted from the
+ * histogram of the errors as for sc_amr_coarsen_search_histogram,
+ * which is computed by one more reduction unless it is known already.
+ * On return the thresholds and counts of amr are set.
+ *
+ * \param [in] package_id               Registered package id or -1.
+ * \param [in,out] amr                  AMR control structure.
+ * \param [in] num_total_ideal          Target number of global elements.
+ * \param [in] refine_coarsen_ratio     Ratio of refinement to coarsening
+ *                                      threshold, at least 1.
+ * \param [in] target_window            Relative target window (< 1).
+ *                                      The window is centered around the
+ *                                      ideal number on a logarithmic scale.
+ * \param [in] max_binary_steps         Upper bound on search steps.
+ * \param [in] cfn                      Callback to count local coarsenings,
+ *                                      or NULL to not coarsen.
+ * \param [in] rfn                      Callback to count local refinements,
+ *                                      or NULL to not refine.
+ * \param [in] user_data                Will be passed to the callbacks.
+ */
+void                sc_amr_joint_search (int package_id,
+                                         sc_amr_control_t * amr,
+                                         long num_total_ideal,
+                                         double refine_coarsen_ratio,
+                                         double target_window,
+                                         int max_binary_steps,
+                                         sc_amr_count_coarsen_fn cfn,
+                                         sc_amr_count_refine_fn rfn,
+                                         void *user_data);
+
 SC_EXTERN_C_END;
 
 #endif /* !SC_AMR_H */
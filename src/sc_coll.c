@@ -0,0 +1,188 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_coll.h>
+
+#ifdef SC_MPI_RANKS
+
+static int          sc_coll_keyval = MPI_KEYVAL_INVALID;
+
+/* The counter is stored as the value of a communicator attribute
+ * and thus needs no memory of its own.
+ */
+int
+sc_coll_next_tag (MPI_Comm mpicomm)
+{
+  int                 mpiret;
+  int                 flag, count;
+  void               *attr;
+
+#ifndef SC_MPITHREAD
+  if (sc_coll_keyval == MPI_KEYVAL_INVALID)
+#endif
+  {
+    /* emulated ranks share the keyval and create it under a lock */
+    mpiret = MPI_Comm_create_keyval (MPI_COMM_NULL_COPY_FN,
+                                     MPI_COMM_NULL_DELETE_FN,
+                                     &sc_coll_keyval, NULL);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  mpiret = MPI_Comm_get_attr (mpicomm, sc_coll_keyval, &attr, &flag);
+  SC_CHECK_MPI (mpiret);
+  count = flag ? (int) (intptr_t) attr : 0;
+
+  attr = (void *) (intptr_t) ((count + 1) % SC_COLL_NUM_TAGS);
+  mpiret = MPI_Comm_set_attr (mpicomm, sc_coll_keyval, attr);
+  SC_CHECK_MPI (mpiret);
+
+  return SC_TAG_COLL + count;
+}
+
+#else
+
+int
+sc_coll_next_tag (MPI_Comm mpicomm)
+{
+  return SC_TAG_COLL;
+}
+
+#endif /* SC_MPI_RANKS */
+
+/** Run the step function as long as the posted requests are complete.
+ * \return          True if the collective is complete.
+ */
+static int
+sc_coll_progress (sc_coll_request_t * req)
+{
+  int                 mpiret;
+  int                 flag;
+
+  while (!req->done) {
+    if (req->num_requests > 0) {
+      mpiret = MPI_Testall (req->num_requests, req->requests, &flag,
+                            MPI_STATUSES_IGNORE);
+      SC_CHECK_MPI (mpiret);
+      if (!flag) {
+        break;
+      }
+      req->num_requests = 0;
+    }
+    req->done = req->step (req);
+    SC_ASSERT (req->num_requests <= req->max_requests);
+  }
+
+  return req->done;
+}
+
+static void
+sc_coll_request_destroy (sc_coll_request_t * req)
+{
+  SC_ASSERT (req->done && req->num_requests == 0);
+
+  SC_FREE (req->requests);
+  SC_FREE (req);
+}
+
+sc_coll_request_t  *
+sc_coll_request_new (MPI_Comm mpicomm, int max_requests,
+                     sc_coll_step_t step, void *state)
+{
+  int                 i;
+  sc_coll_request_t  *req;
+
+  SC_ASSERT (max_requests >= 0);
+
+  req = SC_ALLOC (sc_coll_request_t, 1);
+  req->mpicomm = mpicomm;
+#ifdef SC_MPI_RANKS
+  req->tag = step != NULL ? sc_coll_next_tag (mpicomm) : MPI_ANY_TAG;
+#else
+  req->tag = MPI_ANY_TAG;
+#endif
+  req->done = (step == NULL);
+  req->num_requests = 0;
+  req->max_requests = max_requests;
+  req->requests = SC_ALLOC (MPI_Request, max_requests);
+  for (i = 0; i < max_requests; ++i) {
+    req->requests[i] = MPI_REQUEST_NULL;
+  }
+  req->step = step;
+  req->state = state;
+
+  sc_coll_progress (req);
+
+  return req;
+}
+
+void
+sc_coll_test (sc_coll_request_t ** req, int *flag)
+{
+  if (*req == NULL) {
+    *flag = 1;
+    return;
+  }
+
+  *flag = sc_coll_progress (*req);
+  if (*flag) {
+    sc_coll_request_destroy (*req);
+    *req = NULL;
+  }
+}
+
+void
+sc_coll_wait (sc_coll_request_t ** req)
+{
+  int                 mpiret;
+  sc_coll_request_t  *r = *req;
+
+  if (r == NULL) {
+    return;
+  }
+
+  while (!r->done) {
+    mpiret = MPI_Waitall (r->num_requests, r->requests, MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+    r->num_requests = 0;
+    r->done = r->step (r);
+    SC_ASSERT (r->num_requests <= r->max_requests);
+  }
+
+  sc_coll_request_destroy (r);
+  *req = NULL;
+}
+
+void
+sc_coll_waitall (int count, sc_coll_request_t ** reqs)
+{
+  int                 i;
+  int                 flag, remaining;
+
+  do {
+    remaining = 0;
+    for (i = 0; i < count; ++i) {
+      sc_coll_test (reqs + i, &flag);
+      remaining += !flag;
+    }
+  }
+  while (remaining > 0);
+}
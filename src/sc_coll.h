@@ -0,0 +1,119 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+/* Requests for nonblocking collectives.
+ *
+ * A nonblocking collective such as sc_iallgather or sc_iallreduce
+ * returns an sc_coll_request_t that is completed by sc_coll_test or
+ * sc_coll_wait.  The communication schedule is cut into steps: each
+ * step posts a number of point-to-point requests and the next step is
+ * started once all of them are complete.  Progress is only made inside
+ * the calls to sc_coll_test and sc_coll_wait, thus sc_coll_test should
+ * be called now and then while other work is overlapped.
+ *
+ * Every nonblocking collective draws a new message tag from a counter
+ * attached to the communicator.  All processes must start the
+ * collectives on a communicator in the same order, as required by MPI.
+ * At most SC_COLL_NUM_TAGS collectives may be in flight at a time.
+ */
+
+#ifndef SC_COLL_H
+#define SC_COLL_H
+
+#include <sc.h>
+
+/* number of tags starting from SC_TAG_COLL used round robin */
+#define SC_COLL_NUM_TAGS        1024
+
+SC_EXTERN_C_BEGIN;
+
+typedef struct sc_coll_request sc_coll_request_t;
+
+/** Advance a collective by one step.
+ * Called when all requests of the previous step are complete.
+ * \param [in,out] req  The function posts the requests of the next step
+ *                      into req->requests and sets req->num_requests.
+ * \return              True if the collective is complete.  In this
+ *                      case the function must have released req->state.
+ */
+typedef int         (*sc_coll_step_t) (sc_coll_request_t * req);
+
+/** The request of a nonblocking collective.
+ * The members are only to be used by the implementation of a collective.
+ */
+struct sc_coll_request
+{
+  MPI_Comm            mpicomm;          /**< Communicator of the collective. */
+  int                 tag;              /**< Tag for all of its messages. */
+  int                 done;             /**< True if complete. */
+  int                 num_requests;     /**< Requests posted in this step. */
+  int                 max_requests;     /**< Allocated length of requests. */
+  MPI_Request        *requests;         /**< Requests of the current step. */
+  sc_coll_step_t      step;             /**< Starts the next step. */
+  void               *state;            /**< Private data of the collective. */
+};
+
+/** Draw the next tag from the counter of a communicator.
+ * This is done by sc_coll_request_new.  Other collectives that rely on
+ * a private tag, for example to probe for messages, may call it directly.
+ * \param [in] mpicomm      Communicator of the collective.
+ * \return                  A tag between SC_TAG_COLL and
+ *                          SC_TAG_COLL + SC_COLL_NUM_TAGS - 1.
+ */
+int                 sc_coll_next_tag (MPI_Comm mpicomm);
+
+/** Create a request and start the first step of a collective.
+ * \param [in] mpicomm      Communicator of the collective.
+ * \param [in] max_requests Maximum number of requests posted in one step.
+ * \param [in] step         Step function.  If NULL the request is
+ *                          created complete.
+ * \param [in] state        Private data passed to the step function.
+ * \return                  Newly allocated request.
+ */
+sc_coll_request_t  *sc_coll_request_new (MPI_Comm mpicomm, int max_requests,
+                                         sc_coll_step_t step, void *state);
+
+/** Make progress on a collective and test for its completion.
+ * \param [in,out] req  Pointer to a request.  If the collective is
+ *                      complete the request is freed and set to NULL.
+ *                      A NULL request counts as complete.
+ * \param [out] flag    True if the collective is complete.
+ */
+void                sc_coll_test (sc_coll_request_t ** req, int *flag);
+
+/** Wait for the completion of a collective.
+ * \param [in,out] req  Pointer to a request.  It is freed and set to NULL.
+ *                      A NULL request is ignored.
+ */
+void                sc_coll_wait (sc_coll_request_t ** req);
+
+/** Wait for the completion of several collectives.
+ * The collectives are progressed alternately such that every process
+ * may pass them in a different order.
+ * \param [in] count        Number of requests.
+ * \param [in,out] reqs     Array of requests, which are all set to NULL.
+ */
+void                sc_coll_waitall (int count, sc_coll_request_t ** reqs);
+
+SC_EXTERN_C_END;
+
+#endif /* !SC_COLL_H */
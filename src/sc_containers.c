@@ -147,6 +147,14 @@ sc_array_reset (sc_array_t * array)
   array->byte_alloc = 0;
 }
 
+void
+sc_array_truncate (sc_array_t * array)
+{
+  SC_ASSERT (SC_ARRAY_IS_OWNER (array));
+
+  array->elem_count = 0;
+}
+
 #ifdef SC_USE_REALLOC
 
 void
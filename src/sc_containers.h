@@ -183,6 +183,12 @@ void                sc_array_init_data (sc_array_t * view, void *base,
  */
 void                sc_array_reset (sc_array_t * array);
 
+/** Sets the array count to zero and keeps the memory for reuse.
+ * \param [in,out]  array       Array structure to be truncated.
+ *                              Must not be a view.
+ */
+void                sc_array_truncate (sc_array_t * array);
+
 /** Sets the element count to new_count.
  * If this a view, new_count cannot be greater than the elem_count of
  * the view when it was created.  The original offset of the view cannot be
@@ -29,6 +29,47 @@
 #include <papi.h>
 #endif
 
+#ifdef SC_HAVE_LINUX_PERF_EVENT_H
+#ifdef SC_HAVE_SYS_IOCTL_H
+#ifdef SC_HAVE_SYS_SYSCALL_H
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#ifdef __NR_perf_event_open
+#define SC_PERF_EVENT
+#endif
+#endif
+#endif
+#endif
+
+/* counts at the time of sc_flops_start */
+static long long    sc_flops_perf_base[SC_FLOPS_PERF_NUM];
+
+#ifdef SC_PERF_EVENT
+
+/* file descriptors of the events; the first is -2 before opening */
+static int          sc_flops_perf_fd[SC_FLOPS_PERF_NUM] = { -2 };
+
+static int
+sc_flops_perf_open (uint32_t type, uint64_t config)
+{
+  struct perf_event_attr attr;
+
+  memset (&attr, 0, sizeof (attr));
+  attr.size = sizeof (attr);
+  attr.type = type;
+  attr.config = config;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return (int) syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#endif /* SC_PERF_EVENT */
+
 void
 sc_flops_papi (float *rtime, float *ptime, long long *flpops, float *mflops)
 {
@@ -43,6 +84,75 @@ sc_flops_papi (float *rtime, float *ptime, long long *flpops, float *mflops)
 #endif
 }
 
+int
+sc_flops_perf (long long *counts)
+{
+  int                 i, num_events = 0;
+#ifdef SC_PERF_EVENT
+  uint64_t            values[3];
+  const char         *fp_event;
+
+  if (sc_flops_perf_fd[0] == -2) {
+    sc_flops_perf_fd[SC_FLOPS_PERF_CYCLES] =
+      sc_flops_perf_open (PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    sc_flops_perf_fd[SC_FLOPS_PERF_INSTRUCTIONS] =
+      sc_flops_perf_open (PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    sc_flops_perf_fd[SC_FLOPS_PERF_CACHE_MISSES] =
+      sc_flops_perf_open (PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    sc_flops_perf_fd[SC_FLOPS_PERF_BRANCH_MISSES] =
+      sc_flops_perf_open (PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    fp_event = getenv ("SC_FLOPS_PERF_FP");
+    sc_flops_perf_fd[SC_FLOPS_PERF_FP_OPS] = fp_event == NULL ? -1 :
+      sc_flops_perf_open (PERF_TYPE_RAW, strtoull (fp_event, NULL, 0));
+    for (i = 0; i < SC_FLOPS_PERF_NUM; ++i) {
+      if (sc_flops_perf_fd[i] < 0) {
+        SC_LDEBUGF ("Hardware counter %d is not available\n", i);
+      }
+    }
+  }
+
+  for (i = 0; i < SC_FLOPS_PERF_NUM; ++i) {
+    counts[i] = 0;
+    if (sc_flops_perf_fd[i] >= 0 &&
+        read (sc_flops_perf_fd[i], values, sizeof (values)) ==
+        (ssize_t) sizeof (values)) {
+      /* extrapolate if the event was not always scheduled */
+      if (values[2] > 0 && values[2] < values[1]) {
+        values[0] = (uint64_t) ((double) values[0] *
+                                ((double) values[1] / values[2]));
+      }
+      counts[i] = (long long) values[0];
+      ++num_events;
+    }
+  }
+#else
+  for (i = 0; i < SC_FLOPS_PERF_NUM; ++i) {
+    counts[i] = 0;
+  }
+#endif
+
+  return num_events;
+}
+
+void
+sc_flops_perf_close (void)
+{
+#ifdef SC_PERF_EVENT
+  int                 i;
+
+  if (sc_flops_perf_fd[0] == -2) {
+    return;
+  }
+  for (i = 0; i < SC_FLOPS_PERF_NUM; ++i) {
+    if (sc_flops_perf_fd[i] >= 0) {
+      close (sc_flops_perf_fd[i]);
+    }
+    sc_flops_perf_fd[i] = -1;
+  }
+  sc_flops_perf_fd[0] = -2;
+#endif
+}
+
 void
 sc_flops_start (sc_flopinfo_t * fi)
 {
@@ -51,6 +161,7 @@ sc_flops_start (sc_flopinfo_t * fi)
 
   fi->seconds = MPI_Wtime ();
   sc_flops_papi (&rtime, &ptime, &flpops, &mflops);     /* ignore results */
+  sc_flops_perf (sc_flops_perf_base);
 
   fi->cwtime = 0.;
   fi->crtime = fi->cptime = 0.;
@@ -59,17 +170,29 @@ sc_flops_start (sc_flopinfo_t * fi)
   fi->iwtime = 0.;
   fi->irtime = fi->iptime = fi->mflops = 0.;
   fi->iflpops = 0;
+
+  fi->ccycles = fi->cinstrs = fi->ccmisses = fi->cbmisses = 0;
+  fi->icycles = fi->iinstrs = fi->icmisses = fi->ibmisses = 0;
 }
 
 void
 sc_flops_count (sc_flopinfo_t * fi)
 {
+  int                 i;
   double              seconds;
   float               rtime, ptime;
   long long           flpops;
+  long long           counts[SC_FLOPS_PERF_NUM];
 
   seconds = MPI_Wtime ();
   sc_flops_papi (&rtime, &ptime, &flpops, &fi->mflops);
+  sc_flops_perf (counts);
+  for (i = 0; i < SC_FLOPS_PERF_NUM; ++i) {
+    counts[i] -= sc_flops_perf_base[i];
+  }
+#ifndef SC_PAPI
+  flpops = counts[SC_FLOPS_PERF_FP_OPS];
+#endif
 
   fi->iwtime = seconds - fi->seconds;
   fi->cwtime += fi->iwtime;
@@ -86,8 +209,19 @@ sc_flops_count (sc_flopinfo_t * fi)
 #else
   fi->irtime = (float) fi->iwtime;
   fi->crtime = (float) fi->cwtime;
+  fi->mflops = fi->iwtime > 0. ?
+    (float) ((double) fi->iflpops / 1.e6 / fi->iwtime) : 0.;
 #endif
   fi->seconds = seconds;
+
+  fi->icycles = counts[SC_FLOPS_PERF_CYCLES] - fi->ccycles;
+  fi->ccycles = counts[SC_FLOPS_PERF_CYCLES];
+  fi->iinstrs = counts[SC_FLOPS_PERF_INSTRUCTIONS] - fi->cinstrs;
+  fi->cinstrs = counts[SC_FLOPS_PERF_INSTRUCTIONS];
+  fi->icmisses = counts[SC_FLOPS_PERF_CACHE_MISSES] - fi->ccmisses;
+  fi->ccmisses = counts[SC_FLOPS_PERF_CACHE_MISSES];
+  fi->ibmisses = counts[SC_FLOPS_PERF_BRANCH_MISSES] - fi->cbmisses;
+  fi->cbmisses = counts[SC_FLOPS_PERF_BRANCH_MISSES];
 }
 
 void
@@ -119,12 +253,20 @@ sc_flops_shotv (sc_flopinfo_t * fi, ...)
     snapshot->iflpops = fi->cflpops - snapshot->cflpops;
     snapshot->mflops =
       (float) ((double) snapshot->iflpops / 1.e6 / snapshot->irtime);
+    snapshot->icycles = fi->ccycles - snapshot->ccycles;
+    snapshot->iinstrs = fi->cinstrs - snapshot->cinstrs;
+    snapshot->icmisses = fi->ccmisses - snapshot->ccmisses;
+    snapshot->ibmisses = fi->cbmisses - snapshot->cbmisses;
 
     snapshot->seconds = fi->seconds;
     snapshot->cwtime = fi->cwtime;
     snapshot->crtime = fi->crtime;
     snapshot->cptime = fi->cptime;
     snapshot->cflpops = fi->cflpops;
+    snapshot->ccycles = fi->ccycles;
+    snapshot->cinstrs = fi->cinstrs;
+    snapshot->ccmisses = fi->ccmisses;
+    snapshot->cbmisses = fi->cbmisses;
   }
   va_end (ap);
 }
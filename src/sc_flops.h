@@ -27,6 +27,18 @@
 
 SC_EXTERN_C_BEGIN;
 
+/* hardware events counted by sc_flops_perf */
+typedef enum sc_flops_perf_event
+{
+  SC_FLOPS_PERF_CYCLES,
+  SC_FLOPS_PERF_INSTRUCTIONS,
+  SC_FLOPS_PERF_CACHE_MISSES,
+  SC_FLOPS_PERF_BRANCH_MISSES,
+  SC_FLOPS_PERF_FP_OPS,
+  SC_FLOPS_PERF_NUM
+}
+sc_flops_perf_event_t;
+
 typedef struct sc_flopinfo
 {
   double              seconds;  /* current time from MPI_Wtime */
@@ -44,7 +56,18 @@ typedef struct sc_flopinfo
   long long           iflpops;  /* interval floating point operations */
   float               mflops;   /* MFlop/s rate in this interval */
 
-  /* without SC_PAPI only seconds, ?wtime and ?rtime are meaningful */
+  /* hardware counters from sc_flops_perf, zero if not available */
+  long long           ccycles;  /* cumulative cpu cycles */
+  long long           cinstrs;  /* cumulative instructions retired */
+  long long           ccmisses; /* cumulative last level cache misses */
+  long long           cbmisses; /* cumulative branch misses */
+  long long           icycles;  /* interval cpu cycles */
+  long long           iinstrs;  /* interval instructions retired */
+  long long           icmisses; /* interval last level cache misses */
+  long long           ibmisses; /* interval branch misses */
+
+  /* without SC_PAPI only seconds, ?wtime and ?rtime are meaningful,
+     and ?flpops and mflops if sc_flops_perf counts floating point ops */
 }
 sc_flopinfo_t;
 
@@ -57,6 +80,30 @@ sc_flopinfo_t;
 void                sc_flops_papi (float *rtime, float *ptime,
                                    long long *flpops, float *mflops);
 
+/**
+ * Read hardware counters of the process with the Linux perf_event_open
+ * interface.  The first call opens the counters; they count user space
+ * events of the calling thread and the threads it creates later.
+ * Events that cannot be opened due to lacking kernel support or
+ * permissions (see /proc/sys/kernel/perf_event_paranoid) are zero.
+ * There is no generic event for floating point operations: it is only
+ * counted if the environment variable SC_FLOPS_PERF_FP contains a raw
+ * event code for the processor, such as 0x1fc7 on Intel Haswell.
+ * Without the perf_event interface all counts are zero.
+ *
+ * \param [out] counts  Array of SC_FLOPS_PERF_NUM cumulative counts,
+ *                      scaled up if the kernel multiplexes the events.
+ * \return              The number of events counted.
+ */
+int                 sc_flops_perf (long long *counts);
+
+/**
+ * Close the hardware counters opened by sc_flops_perf.
+ * A later call to sc_flops_perf opens them again.
+ * This function is called by sc_finalize.
+ */
+void                sc_flops_perf_close (void);
+
 /**
  * Prepare sc_flopinfo_t structure and start flop counters.
  * Must only be called once during the program run.
@@ -70,7 +117,7 @@ void                sc_flops_start (sc_flopinfo_t * fi);
  * Update sc_flopinfo_t structure with current measurement.
  * Must only be called after sc_flops_start.
  * Can be called any number of times.
- * This function calls sc_flops_papi.
+ * This function calls sc_flops_papi and sc_flops_perf.
  *
  * \param [in,out] fi   Members will be updated.
  */
@@ -87,7 +134,10 @@ void                sc_flops_snap (sc_flopinfo_t * fi,
 
 /**
  * Call sc_flops_count (fi) and override snapshot interval timings
- * with the differences since the previous call to sc_flops_snap.
+ * and hardware counts with the differences since the previous call
+ * to sc_flops_snap.  For example, iinstrs / icycles is the number of
+ * instructions per cycle and icmisses / iinstrs indicates whether the
+ * interval is bound by memory access.
  * The interval mflop rate is computed by iflpops / 1e6 / irtime.
  * The cumulative timings in snapshot are copied form fi.
  *
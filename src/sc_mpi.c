@@ -33,6 +33,14 @@
 #include <time.h>
 #endif
 
+#ifdef SC_MPITHREAD
+#include <pthread.h>
+#include <sc_reduce.h>
+#endif
+
+/* with --enable-mpithread these are replaced by the emulation below */
+#ifndef SC_MPITHREAD
+
 static inline void
 mpi_dummy_assert_op (MPI_Op op)
 {
@@ -279,6 +287,1121 @@ MPI_Waitall (int count, MPI_Request * array_of_requests,
   return MPI_SUCCESS;
 }
 
+int
+MPI_Testall (int count, MPI_Request * array_of_requests, int *flag,
+             MPI_Status * array_of_statuses)
+{
+  SC_CHECK_ABORT (count == 0, "MPI_Testall handles zero requests only");
+  *flag = 1;
+  return MPI_SUCCESS;
+}
+
+#else /* SC_MPITHREAD */
+
+/* The ranks of MPI_COMM_WORLD are emulated by the threads started in
+ * sc_mpi_run.  Every rank owns a mailbox that holds the messages that
+ * arrived before a matching receive was posted and the receives that
+ * were posted before a matching message arrived, both in order, which
+ * gives the matching rules of MPI.  Sends are buffered and complete
+ * immediately.  The collectives publish one buffer per rank and copy
+ * between a pair of barriers.  Communicators are MPI_COMM_WORLD and
+ * MPI_COMM_SELF and their duplicates.  Those of MPI_COMM_WORLD are
+ * numbered consistently since all ranks duplicate it collectively and
+ * in the same order.  Duplicates of MPI_COMM_SELF are counted apart,
+ * since a rank may create them alone.
+ * The memory of the emulation is not accounted to libsc, as it would
+ * not be for an MPI library.
+ */
+
+#define SC_MPITHREAD_IS_SELF(comm)      ((comm) & 1)
+#define SC_MPITHREAD_LOCK(m)    SC_CHECK_ABORT (!pthread_mutex_lock (m), \
+                                                "Mutex lock")
+#define SC_MPITHREAD_UNLOCK(m)  SC_CHECK_ABORT (!pthread_mutex_unlock (m), \
+                                                "Mutex unlock")
+
+typedef struct sc_mpithread_message
+{
+  int                 source;
+  int                 tag;
+  MPI_Comm            comm;
+  size_t              bytes;    /* the data follows this struct */
+  struct sc_mpithread_message *next;
+}
+sc_mpithread_message_t;
+
+typedef struct sc_mpithread_request
+{
+  int                 is_send;
+  int                 persistent;
+  int                 active;   /* started and not yet waited for */
+  int                 complete; /* guarded by the mailbox of the rank */
+  void               *buf;
+  size_t              bytes;
+  int                 peer;
+  int                 tag;
+  MPI_Comm            comm;
+  MPI_Status          status;
+  struct sc_mpithread_request *next;
+}
+sc_mpithread_request_t;
+
+typedef struct sc_mpithread_attr
+{
+  MPI_Comm            comm;
+  int                 keyval;
+  void               *value;
+}
+sc_mpithread_attr_t;
+
+struct sc_mpithread_world;
+
+typedef struct sc_mpithread_rank
+{
+  int                 rank;
+  struct sc_mpithread_world *world;
+
+  /* the mailbox */
+  pthread_mutex_t     mutex;
+  pthread_cond_t      cond;
+  sc_mpithread_message_t *messages, **messages_tail;
+  sc_mpithread_request_t *posted, **posted_tail;
+
+  /* requests by handle - 1 and the stack of unused handles */
+  int                 num_requests, num_free, alloc_requests;
+  sc_mpithread_request_t **requests;
+  int                *free_handles;
+
+  int                 num_attrs, alloc_attrs;
+  sc_mpithread_attr_t *attrs;
+  int                 num_dups[2];      /* of MPI_COMM_WORLD and SELF */
+  const void         *self_slot;
+
+  sc_mpi_main_t       main_fn;
+  int                 argc;
+  char              **argv;
+  int                 retval;
+  pthread_t           thread;
+}
+sc_mpithread_rank_t;
+
+typedef struct sc_mpithread_world
+{
+  int                 size;
+  pthread_mutex_t     mutex;
+  pthread_cond_t      cond;
+  int                 arrived;
+  unsigned long       generation;
+  const void        **slots;
+  sc_mpithread_rank_t *ranks;
+}
+sc_mpithread_world_t;
+
+static pthread_once_t sc_mpithread_once = PTHREAD_ONCE_INIT;
+static pthread_key_t sc_mpithread_key;
+static pthread_mutex_t sc_mpithread_keyval_mutex =
+  PTHREAD_MUTEX_INITIALIZER;
+static int          sc_mpithread_num_keyvals = 0;
+
+/* the single rank seen by threads outside of sc_mpi_run */
+static sc_mpithread_world_t sc_mpithread_serial;
+static sc_mpithread_rank_t sc_mpithread_serial_rank;
+static const void  *sc_mpithread_serial_slot;
+
+static void        *
+sc_mpithread_realloc (void *p, size_t size)
+{
+  p = realloc (p, size);
+  SC_CHECK_ABORT (p != NULL || size == 0, "Emulated MPI out of memory");
+  return p;
+}
+
+static void
+sc_mpithread_rank_init (sc_mpithread_rank_t * r,
+                        sc_mpithread_world_t * world, int rank)
+{
+  memset (r, 0, sizeof (*r));
+  r->rank = rank;
+  r->world = world;
+  SC_CHECK_ABORT (!pthread_mutex_init (&r->mutex, NULL), "Mutex init");
+  SC_CHECK_ABORT (!pthread_cond_init (&r->cond, NULL), "Cond init");
+  r->messages_tail = &r->messages;
+  r->posted_tail = &r->posted;
+}
+
+static void
+sc_mpithread_rank_reset (sc_mpithread_rank_t * r)
+{
+  int                 i;
+  sc_mpithread_message_t *msg;
+
+  /* messages that were never received are dropped */
+  while ((msg = r->messages) != NULL) {
+    r->messages = msg->next;
+    free (msg);
+  }
+  SC_CHECK_ABORT (r->posted == NULL, "Receive pending at end of rank");
+  for (i = 0; i < r->num_requests + r->num_free; ++i) {
+    free (r->requests[i]);
+  }
+  free (r->requests);
+  free (r->free_handles);
+  free (r->attrs);
+  SC_CHECK_ABORT (!pthread_mutex_destroy (&r->mutex), "Mutex destroy");
+  SC_CHECK_ABORT (!pthread_cond_destroy (&r->cond), "Cond destroy");
+}
+
+static void
+sc_mpithread_world_init (sc_mpithread_world_t * world, int size,
+                         sc_mpithread_rank_t * ranks, const void **slots)
+{
+  int                 i;
+
+  world->size = size;
+  SC_CHECK_ABORT (!pthread_mutex_init (&world->mutex, NULL), "Mutex init");
+  SC_CHECK_ABORT (!pthread_cond_init (&world->cond, NULL), "Cond init");
+  world->arrived = 0;
+  world->generation = 0;
+  world->slots = slots;
+  world->ranks = ranks;
+  for (i = 0; i < size; ++i) {
+    sc_mpithread_rank_init (ranks + i, world, i);
+  }
+}
+
+static void
+sc_mpithread_init_once (void)
+{
+  SC_CHECK_ABORT (!pthread_key_create (&sc_mpithread_key, NULL),
+                  "Key create");
+  sc_mpithread_world_init (&sc_mpithread_serial, 1,
+                           &sc_mpithread_serial_rank,
+                           &sc_mpithread_serial_slot);
+}
+
+/** Return the rank of the calling thread. */
+static sc_mpithread_rank_t *
+sc_mpithread_current (void)
+{
+  sc_mpithread_rank_t *r;
+
+  SC_CHECK_ABORT (!pthread_once (&sc_mpithread_once, sc_mpithread_init_once),
+                  "Once");
+  r = (sc_mpithread_rank_t *) pthread_getspecific (sc_mpithread_key);
+  return r != NULL ? r : &sc_mpithread_serial_rank;
+}
+
+static void
+sc_mpithread_check_comm (MPI_Comm comm)
+{
+  SC_CHECK_ABORT ((comm & ~0xffffff) == MPI_COMM_WORLD,
+                  "Invalid communicator in emulated MPI");
+}
+
+static int
+sc_mpithread_comm_size (sc_mpithread_rank_t * r, MPI_Comm comm)
+{
+  sc_mpithread_check_comm (comm);
+  return SC_MPITHREAD_IS_SELF (comm) ? 1 : r->world->size;
+}
+
+static int
+sc_mpithread_comm_rank (sc_mpithread_rank_t * r, MPI_Comm comm)
+{
+  sc_mpithread_check_comm (comm);
+  return SC_MPITHREAD_IS_SELF (comm) ? 0 : r->rank;
+}
+
+/** Return the rank that is addressed by a rank in a communicator. */
+static sc_mpithread_rank_t *
+sc_mpithread_peer (sc_mpithread_rank_t * r, MPI_Comm comm, int rank)
+{
+  SC_CHECK_ABORT (0 <= rank && rank < sc_mpithread_comm_size (r, comm),
+                  "Invalid rank in emulated MPI");
+  return SC_MPITHREAD_IS_SELF (comm) ? r : r->world->ranks + rank;
+}
+
+static void
+sc_mpithread_barrier (sc_mpithread_world_t * world)
+{
+  unsigned long       generation;
+
+  SC_MPITHREAD_LOCK (&world->mutex);
+  generation = world->generation;
+  if (++world->arrived == world->size) {
+    world->arrived = 0;
+    ++world->generation;
+    pthread_cond_broadcast (&world->cond);
+  }
+  else {
+    while (generation == world->generation) {
+      pthread_cond_wait (&world->cond, &world->mutex);
+    }
+  }
+  SC_MPITHREAD_UNLOCK (&world->mutex);
+}
+
+/** Publish a buffer and return the buffers of all ranks in the
+ * communicator.  They may be read until sc_mpithread_release.
+ */
+static const void **
+sc_mpithread_publish (sc_mpithread_rank_t * r, MPI_Comm comm, const void *p)
+{
+  sc_mpithread_check_comm (comm);
+  if (SC_MPITHREAD_IS_SELF (comm)) {
+    r->self_slot = p;
+    return &r->self_slot;
+  }
+  r->world->slots[r->rank] = p;
+  sc_mpithread_barrier (r->world);
+  return r->world->slots;
+}
+
+static void
+sc_mpithread_release (sc_mpithread_rank_t * r, MPI_Comm comm)
+{
+  if (!SC_MPITHREAD_IS_SELF (comm)) {
+    sc_mpithread_barrier (r->world);
+  }
+}
+
+static void
+sc_mpithread_empty_status (MPI_Status * status)
+{
+  if (status != MPI_STATUS_IGNORE) {
+    status->count = 0;
+    status->cancelled = 0;
+    status->MPI_SOURCE = MPI_ANY_SOURCE;
+    status->MPI_TAG = MPI_ANY_TAG;
+    status->MPI_ERROR = MPI_SUCCESS;
+  }
+}
+
+static int
+sc_mpithread_matches (int source, int tag, MPI_Comm comm,
+                      const sc_mpithread_message_t * msg)
+{
+  return msg->comm == comm &&
+    (source == MPI_ANY_SOURCE || source == msg->source) &&
+    (tag == MPI_ANY_TAG || tag == msg->tag);
+}
+
+/** Complete a receive request with the message data. */
+static void
+sc_mpithread_receive (sc_mpithread_request_t * req, int source, int tag,
+                      const void *data, size_t bytes)
+{
+  SC_CHECK_ABORT (bytes <= req->bytes, "Message truncated in emulated MPI");
+  SC_ASSERT (bytes <= (size_t) INT_MAX);
+
+  memcpy (req->buf, data, bytes);
+  req->status.count = (int) bytes;
+  req->status.cancelled = 0;
+  req->status.MPI_SOURCE = source;
+  req->status.MPI_TAG = tag;
+  req->status.MPI_ERROR = MPI_SUCCESS;
+  req->complete = 1;
+}
+
+/** Buffer a message in the mailbox of the destination
+ * or copy it directly if a matching receive is posted.
+ */
+static void
+sc_mpithread_deliver (sc_mpithread_rank_t * r, const void *buf,
+                      size_t bytes, int dest, int tag, MPI_Comm comm)
+{
+  int                 source;
+  sc_mpithread_rank_t *d;
+  sc_mpithread_request_t *req, **rp;
+  sc_mpithread_message_t *msg;
+
+  SC_ASSERT (tag >= 0);
+  source = sc_mpithread_comm_rank (r, comm);
+  d = sc_mpithread_peer (r, comm, dest);
+
+  SC_MPITHREAD_LOCK (&d->mutex);
+  for (rp = &d->posted; (req = *rp) != NULL; rp = &req->next) {
+    if (req->comm == comm &&
+        (req->peer == MPI_ANY_SOURCE || req->peer == source) &&
+        (req->tag == MPI_ANY_TAG || req->tag == tag)) {
+      sc_mpithread_receive (req, source, tag, buf, bytes);
+      if ((*rp = req->next) == NULL) {
+        d->posted_tail = rp;
+      }
+      break;
+    }
+  }
+  if (req == NULL) {
+    msg = (sc_mpithread_message_t *)
+      sc_mpithread_realloc (NULL, sizeof (*msg) + bytes);
+    msg->source = source;
+    msg->tag = tag;
+    msg->comm = comm;
+    msg->bytes = bytes;
+    msg->next = NULL;
+    memcpy (msg + 1, buf, bytes);
+    *d->messages_tail = msg;
+    d->messages_tail = &msg->next;
+  }
+  pthread_cond_broadcast (&d->cond);
+  SC_MPITHREAD_UNLOCK (&d->mutex);
+}
+
+/** Receive a buffered message or post the receive request. */
+static void
+sc_mpithread_post (sc_mpithread_rank_t * r, sc_mpithread_request_t * req)
+{
+  sc_mpithread_message_t *msg, **mp;
+
+  SC_MPITHREAD_LOCK (&r->mutex);
+  for (mp = &r->messages; (msg = *mp) != NULL; mp = &msg->next) {
+    if (sc_mpithread_matches (req->peer, req->tag, req->comm, msg)) {
+      sc_mpithread_receive (req, msg->source, msg->tag, msg + 1, msg->bytes);
+      if ((*mp = msg->next) == NULL) {
+        r->messages_tail = mp;
+      }
+      free (msg);
+      break;
+    }
+  }
+  if (msg == NULL) {
+    req->next = NULL;
+    *r->posted_tail = req;
+    r->posted_tail = &req->next;
+  }
+  SC_MPITHREAD_UNLOCK (&r->mutex);
+}
+
+static MPI_Request
+sc_mpithread_request_new (sc_mpithread_rank_t * r, int is_send,
+                          int persistent, void *buf, int count,
+                          MPI_Datatype datatype, int peer, int tag,
+                          MPI_Comm comm)
+{
+  int                 handle;
+  sc_mpithread_request_t *req;
+
+  SC_ASSERT (count >= 0);
+  sc_mpithread_check_comm (comm);
+  if (peer != MPI_ANY_SOURCE) {
+    sc_mpithread_peer (r, comm, peer);
+  }
+
+  if (r->num_free > 0) {
+    handle = r->free_handles[--r->num_free];
+    req = r->requests[handle - 1];
+  }
+  else {
+    if (r->num_requests == r->alloc_requests) {
+      r->alloc_requests = SC_MAX (8, 2 * r->alloc_requests);
+      r->requests = (sc_mpithread_request_t **) sc_mpithread_realloc
+        (r->requests, r->alloc_requests * sizeof (*r->requests));
+      r->free_handles = (int *) sc_mpithread_realloc
+        (r->free_handles, r->alloc_requests * sizeof (int));
+    }
+    handle = r->num_requests + 1;
+    req = r->requests[handle - 1] = (sc_mpithread_request_t *)
+      sc_mpithread_realloc (NULL, sizeof (*req));
+  }
+  ++r->num_requests;
+
+  req->is_send = is_send;
+  req->persistent = persistent;
+  req->active = 0;
+  req->complete = 0;
+  req->buf = buf;
+  req->bytes = (size_t) count * sc_mpi_sizeof (datatype);
+  req->peer = peer;
+  req->tag = tag;
+  req->comm = comm;
+  sc_mpithread_empty_status (&req->status);
+  req->next = NULL;
+
+  return handle;
+}
+
+static sc_mpithread_request_t *
+sc_mpithread_request (sc_mpithread_rank_t * r, MPI_Request request)
+{
+  SC_ASSERT (1 <= request &&
+             request <= r->num_requests + r->num_free);
+  return r->requests[request - 1];
+}
+
+static void
+sc_mpithread_request_free (sc_mpithread_rank_t * r, MPI_Request * request)
+{
+  SC_ASSERT (r->num_requests > 0);
+  --r->num_requests;
+  r->free_handles[r->num_free++] = *request;
+  *request = MPI_REQUEST_NULL;
+}
+
+static void
+sc_mpithread_start (sc_mpithread_rank_t * r, sc_mpithread_request_t * req)
+{
+  SC_ASSERT (!req->active);
+
+  req->active = 1;
+  req->complete = 0;
+  if (req->is_send) {
+    sc_mpithread_deliver (r, req->buf, req->bytes, req->peer,
+                          req->tag, req->comm);
+    req->complete = 1;
+  }
+  else {
+    sc_mpithread_post (r, req);
+  }
+}
+
+/** Return true if a request is null, inactive or complete. */
+static int
+sc_mpithread_done (sc_mpithread_rank_t * r, MPI_Request request)
+{
+  sc_mpithread_request_t *req;
+
+  if (request == MPI_REQUEST_NULL) {
+    return 1;
+  }
+  req = sc_mpithread_request (r, request);
+  return !req->active || req->complete;
+}
+
+/** Return the status of a done request and free or deactivate it. */
+static void
+sc_mpithread_finish (sc_mpithread_rank_t * r, MPI_Request * request,
+                     MPI_Status * status)
+{
+  sc_mpithread_request_t *req;
+
+  if (*request == MPI_REQUEST_NULL) {
+    sc_mpithread_empty_status (status);
+    return;
+  }
+  req = sc_mpithread_request (r, *request);
+  if (!req->active) {
+    sc_mpithread_empty_status (status);
+    return;
+  }
+  SC_ASSERT (req->complete);
+  if (status != MPI_STATUS_IGNORE) {
+    *status = req->status;
+  }
+  req->active = 0;
+  if (!req->persistent) {
+    sc_mpithread_request_free (r, request);
+  }
+}
+
+int
+MPI_Init (int *argc, char ***argv)
+{
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Finalize (void)
+{
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Abort (MPI_Comm comm, int exitcode)
+{
+  abort ();
+}
+
+int
+MPI_Comm_dup (MPI_Comm comm, MPI_Comm * newcomm)
+{
+  const int           is_self = SC_MPITHREAD_IS_SELF (comm);
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  sc_mpithread_check_comm (comm);
+  ++r->num_dups[is_self];
+  SC_CHECK_ABORT (r->num_dups[is_self] < 0x800000, "Too many communicators");
+  *newcomm = MPI_COMM_WORLD + 2 * r->num_dups[is_self] + is_self;
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Comm_free (MPI_Comm * comm)
+{
+  int                 i, j;
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  for (i = j = 0; i < r->num_attrs; ++i) {
+    if (r->attrs[i].comm != *comm) {
+      r->attrs[j++] = r->attrs[i];
+    }
+  }
+  r->num_attrs = j;
+  *comm = MPI_COMM_NULL;
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Comm_size (MPI_Comm comm, int *size)
+{
+  *size = sc_mpithread_comm_size (sc_mpithread_current (), comm);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Comm_rank (MPI_Comm comm, int *rank)
+{
+  *rank = sc_mpithread_comm_rank (sc_mpithread_current (), comm);
+
+  return MPI_SUCCESS;
+}
+
+/* The ranks share the address space and thus any keyval stored in a
+ * global variable.  Creating a keyval into a variable that holds one
+ * already keeps it, such that concurrent ranks agree on its value.
+ */
+int
+MPI_Comm_create_keyval (MPI_Comm_copy_attr_function * copy_fn,
+                        MPI_Comm_delete_attr_function * delete_fn,
+                        int *keyval, void *extra_state)
+{
+  SC_CHECK_ABORT (copy_fn == MPI_COMM_NULL_COPY_FN &&
+                  delete_fn == MPI_COMM_NULL_DELETE_FN,
+                  "Attribute callbacks are not emulated");
+
+  SC_MPITHREAD_LOCK (&sc_mpithread_keyval_mutex);
+  if (*keyval == MPI_KEYVAL_INVALID) {
+    *keyval = MPI_KEYVAL_INVALID + ++sc_mpithread_num_keyvals;
+  }
+  SC_MPITHREAD_UNLOCK (&sc_mpithread_keyval_mutex);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Comm_get_attr (MPI_Comm comm, int keyval, void *attribute_val,
+                   int *flag)
+{
+  int                 i;
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  *flag = 0;
+  for (i = 0; i < r->num_attrs; ++i) {
+    if (r->attrs[i].comm == comm && r->attrs[i].keyval == keyval) {
+      *(void **) attribute_val = r->attrs[i].value;
+      *flag = 1;
+      break;
+    }
+  }
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Comm_set_attr (MPI_Comm comm, int keyval, void *attribute_val)
+{
+  int                 i;
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  sc_mpithread_check_comm (comm);
+  for (i = 0; i < r->num_attrs; ++i) {
+    if (r->attrs[i].comm == comm && r->attrs[i].keyval == keyval) {
+      r->attrs[i].value = attribute_val;
+      return MPI_SUCCESS;
+    }
+  }
+  if (r->num_attrs == r->alloc_attrs) {
+    r->alloc_attrs = SC_MAX (4, 2 * r->alloc_attrs);
+    r->attrs = (sc_mpithread_attr_t *) sc_mpithread_realloc
+      (r->attrs, r->alloc_attrs * sizeof (*r->attrs));
+  }
+  r->attrs[r->num_attrs].comm = comm;
+  r->attrs[r->num_attrs].keyval = keyval;
+  r->attrs[r->num_attrs].value = attribute_val;
+  ++r->num_attrs;
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Barrier (MPI_Comm comm)
+{
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  sc_mpithread_check_comm (comm);
+  sc_mpithread_release (r, comm);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Bcast (void *p, int n, MPI_Datatype t, int root, MPI_Comm comm)
+{
+  const void        **slots;
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  SC_ASSERT (n >= 0);
+  sc_mpithread_peer (r, comm, root);
+
+  slots = sc_mpithread_publish (r, comm, p);
+  if (sc_mpithread_comm_rank (r, comm) != root) {
+    memcpy (p, slots[root], (size_t) n * sc_mpi_sizeof (t));
+  }
+  sc_mpithread_release (r, comm);
+
+  return MPI_SUCCESS;
+}
+
+/** Gather to the root or to all ranks if root is -1.
+ * If recvc is NULL, all ranks contribute nq items at displacement i * nq.
+ */
+static int
+sc_mpithread_gather (void *p, int np, MPI_Datatype tp,
+                     void *q, int nq, int *recvc, int *displ,
+                     MPI_Datatype tq, int root, MPI_Comm comm)
+{
+  int                 i, size;
+  size_t              lq;
+  const void        **slots;
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  SC_ASSERT (np >= 0 && nq >= 0);
+  size = sc_mpithread_comm_size (r, comm);
+  if (root >= 0) {
+    sc_mpithread_peer (r, comm, root);
+  }
+  lq = sc_mpi_sizeof (tq);
+
+  slots = sc_mpithread_publish (r, comm, p);
+  if (root == -1 || sc_mpithread_comm_rank (r, comm) == root) {
+    for (i = 0; i < size; ++i) {
+      if (recvc == NULL) {
+        SC_ASSERT ((size_t) np * sc_mpi_sizeof (tp) == (size_t) nq * lq);
+        memcpy ((char *) q + (size_t) i * nq * lq, slots[i],
+                (size_t) nq * lq);
+      }
+      else {
+        SC_ASSERT (recvc[i] >= 0 && displ[i] >= 0);
+        memcpy ((char *) q + (size_t) displ[i] * lq, slots[i],
+                (size_t) recvc[i] * lq);
+      }
+    }
+  }
+  sc_mpithread_release (r, comm);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Gather (void *p, int np, MPI_Datatype tp,
+            void *q, int nq, MPI_Datatype tq, int rank, MPI_Comm comm)
+{
+  return sc_mpithread_gather (p, np, tp, q, nq, NULL, NULL, tq, rank, comm);
+}
+
+int
+MPI_Gatherv (void *p, int np, MPI_Datatype tp,
+             void *q, int *recvc, int *displ,
+             MPI_Datatype tq, int rank, MPI_Comm comm)
+{
+  return sc_mpithread_gather (p, np, tp, q, 0, recvc, displ, tq, rank, comm);
+}
+
+int
+MPI_Allgather (void *p, int np, MPI_Datatype tp,
+               void *q, int nq, MPI_Datatype tq, MPI_Comm comm)
+{
+  return sc_mpithread_gather (p, np, tp, q, nq, NULL, NULL, tq, -1, comm);
+}
+
+int
+MPI_Allgatherv (void *p, int np, MPI_Datatype tp,
+                void *q, int *recvc, int *displ,
+                MPI_Datatype tq, MPI_Comm comm)
+{
+  return sc_mpithread_gather (p, np, tp, q, 0, recvc, displ, tq, -1, comm);
+}
+
+/** Reduce to the root or to all ranks if root is -1.
+ * Every receiving rank combines the contributions in the order of the
+ * ranks, such that all of them obtain the same result.
+ */
+static int
+sc_mpithread_reduce (void *p, void *q, int n, MPI_Datatype t,
+                     MPI_Op op, int root, MPI_Comm comm)
+{
+  int                 i, size;
+  const void        **slots;
+  sc_reduce_t         reduce_fn;
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  SC_ASSERT (n >= 0);
+  reduce_fn = sc_reduce_operation_fn (op);
+  size = sc_mpithread_comm_size (r, comm);
+  if (root >= 0) {
+    sc_mpithread_peer (r, comm, root);
+  }
+
+  slots = sc_mpithread_publish (r, comm, p);
+  if (root == -1 || sc_mpithread_comm_rank (r, comm) == root) {
+    memcpy (q, slots[0], (size_t) n * sc_mpi_sizeof (t));
+    for (i = 1; i < size; ++i) {
+      reduce_fn ((void *) slots[i], q, n, t);
+    }
+  }
+  sc_mpithread_release (r, comm);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Reduce (void *p, void *q, int n, MPI_Datatype t,
+            MPI_Op op, int rank, MPI_Comm comm)
+{
+  return sc_mpithread_reduce (p, q, n, t, op, rank, comm);
+}
+
+int
+MPI_Allreduce (void *p, void *q, int n, MPI_Datatype t,
+               MPI_Op op, MPI_Comm comm)
+{
+  return sc_mpithread_reduce (p, q, n, t, op, -1, comm);
+}
+
+int
+MPI_Recv (void *buf, int count, MPI_Datatype datatype, int source, int tag,
+          MPI_Comm comm, MPI_Status * status)
+{
+  MPI_Request         request;
+
+  MPI_Irecv (buf, count, datatype, source, tag, comm, &request);
+  return MPI_Wait (&request, status);
+}
+
+int
+MPI_Irecv (void *buf, int count, MPI_Datatype datatype, int source, int tag,
+           MPI_Comm comm, MPI_Request * request)
+{
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  *request = sc_mpithread_request_new (r, 0, 0, buf, count, datatype,
+                                       source, tag, comm);
+  sc_mpithread_start (r, sc_mpithread_request (r, *request));
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Send (void *buf, int count, MPI_Datatype datatype,
+          int dest, int tag, MPI_Comm comm)
+{
+  SC_ASSERT (count >= 0);
+  sc_mpithread_deliver (sc_mpithread_current (), buf,
+                        (size_t) count * sc_mpi_sizeof (datatype),
+                        dest, tag, comm);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Isend (void *buf, int count, MPI_Datatype datatype, int dest, int tag,
+           MPI_Comm comm, MPI_Request * request)
+{
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  *request = sc_mpithread_request_new (r, 1, 0, buf, count, datatype,
+                                       dest, tag, comm);
+  sc_mpithread_start (r, sc_mpithread_request (r, *request));
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Send_init (void *buf, int count, MPI_Datatype datatype, int dest,
+               int tag, MPI_Comm comm, MPI_Request * request)
+{
+  *request = sc_mpithread_request_new (sc_mpithread_current (), 1, 1, buf,
+                                       count, datatype, dest, tag, comm);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Recv_init (void *buf, int count, MPI_Datatype datatype, int source,
+               int tag, MPI_Comm comm, MPI_Request * request)
+{
+  *request = sc_mpithread_request_new (sc_mpithread_current (), 0, 1, buf,
+                                       count, datatype, source, tag, comm);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Startall (int count, MPI_Request * array_of_requests)
+{
+  int                 i;
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+  sc_mpithread_request_t *req;
+
+  for (i = 0; i < count; ++i) {
+    req = sc_mpithread_request (r, array_of_requests[i]);
+    SC_CHECK_ABORT (req->persistent, "MPI_Startall needs persistent requests");
+    sc_mpithread_start (r, req);
+  }
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Request_free (MPI_Request * request)
+{
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+  int                 done;
+
+  SC_MPITHREAD_LOCK (&r->mutex);
+  done = sc_mpithread_done (r, *request);
+  SC_MPITHREAD_UNLOCK (&r->mutex);
+  SC_CHECK_ABORT (done, "MPI_Request_free needs a completed request");
+
+  if (*request != MPI_REQUEST_NULL) {
+    sc_mpithread_request (r, *request)->active = 0;
+    sc_mpithread_request_free (r, request);
+  }
+
+  return MPI_SUCCESS;
+}
+
+/** Find the first buffered message that matches.
+ * The mailbox of the rank must be locked.
+ */
+static sc_mpithread_message_t *
+sc_mpithread_probe (sc_mpithread_rank_t * r, int source, int tag,
+                    MPI_Comm comm, MPI_Status * status)
+{
+  sc_mpithread_message_t *msg;
+
+  for (msg = r->messages; msg != NULL; msg = msg->next) {
+    if (sc_mpithread_matches (source, tag, comm, msg)) {
+      if (status != MPI_STATUS_IGNORE) {
+        SC_ASSERT (msg->bytes <= (size_t) INT_MAX);
+        status->count = (int) msg->bytes;
+        status->cancelled = 0;
+        status->MPI_SOURCE = msg->source;
+        status->MPI_TAG = msg->tag;
+        status->MPI_ERROR = MPI_SUCCESS;
+      }
+      break;
+    }
+  }
+  return msg;
+}
+
+int
+MPI_Probe (int source, int tag, MPI_Comm comm, MPI_Status * status)
+{
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  sc_mpithread_check_comm (comm);
+  SC_MPITHREAD_LOCK (&r->mutex);
+  while (sc_mpithread_probe (r, source, tag, comm, status) == NULL) {
+    pthread_cond_wait (&r->cond, &r->mutex);
+  }
+  SC_MPITHREAD_UNLOCK (&r->mutex);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Iprobe (int source, int tag, MPI_Comm comm, int *flag,
+            MPI_Status * status)
+{
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  sc_mpithread_check_comm (comm);
+  SC_MPITHREAD_LOCK (&r->mutex);
+  *flag = (sc_mpithread_probe (r, source, tag, comm, status) != NULL);
+  SC_MPITHREAD_UNLOCK (&r->mutex);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Get_count (MPI_Status * status, MPI_Datatype datatype, int *count)
+{
+  size_t              size = sc_mpi_sizeof (datatype);
+
+  *count = (size_t) status->count % size != 0 ? MPI_UNDEFINED :
+    (int) ((size_t) status->count / size);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Wait (MPI_Request * request, MPI_Status * status)
+{
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  SC_MPITHREAD_LOCK (&r->mutex);
+  while (!sc_mpithread_done (r, *request)) {
+    pthread_cond_wait (&r->cond, &r->mutex);
+  }
+  SC_MPITHREAD_UNLOCK (&r->mutex);
+  sc_mpithread_finish (r, request, status);
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Waitsome (int incount, MPI_Request * array_of_requests,
+              int *outcount, int *array_of_indices,
+              MPI_Status * array_of_statuses)
+{
+  int                 i, num_active;
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  SC_MPITHREAD_LOCK (&r->mutex);
+  for (;;) {
+    num_active = *outcount = 0;
+    for (i = 0; i < incount; ++i) {
+      if (array_of_requests[i] != MPI_REQUEST_NULL &&
+          sc_mpithread_request (r, array_of_requests[i])->active) {
+        ++num_active;
+        if (sc_mpithread_done (r, array_of_requests[i])) {
+          array_of_indices[(*outcount)++] = i;
+        }
+      }
+    }
+    if (num_active == 0 || *outcount > 0) {
+      break;
+    }
+    pthread_cond_wait (&r->cond, &r->mutex);
+  }
+  SC_MPITHREAD_UNLOCK (&r->mutex);
+
+  if (num_active == 0) {
+    *outcount = MPI_UNDEFINED;
+  }
+  for (i = 0; i < *outcount; ++i) {
+    sc_mpithread_finish (r, array_of_requests + array_of_indices[i],
+                         array_of_statuses == MPI_STATUSES_IGNORE ?
+                         MPI_STATUS_IGNORE : array_of_statuses + i);
+  }
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Waitall (int count, MPI_Request * array_of_requests,
+             MPI_Status * array_of_statuses)
+{
+  int                 i;
+
+  for (i = 0; i < count; ++i) {
+    MPI_Wait (array_of_requests + i,
+              array_of_statuses == MPI_STATUSES_IGNORE ?
+              MPI_STATUS_IGNORE : array_of_statuses + i);
+  }
+
+  return MPI_SUCCESS;
+}
+
+int
+MPI_Test (MPI_Request * request, int *flag, MPI_Status * status)
+{
+  return MPI_Testall (1, request, flag, status);
+}
+
+int
+MPI_Testall (int count, MPI_Request * array_of_requests, int *flag,
+             MPI_Status * array_of_statuses)
+{
+  int                 i;
+  sc_mpithread_rank_t *r = sc_mpithread_current ();
+
+  *flag = 1;
+  SC_MPITHREAD_LOCK (&r->mutex);
+  for (i = 0; i < count; ++i) {
+    if (!sc_mpithread_done (r, array_of_requests[i])) {
+      *flag = 0;
+      break;
+    }
+  }
+  SC_MPITHREAD_UNLOCK (&r->mutex);
+
+  if (*flag) {
+    for (i = 0; i < count; ++i) {
+      sc_mpithread_finish (r, array_of_requests + i,
+                           array_of_statuses == MPI_STATUSES_IGNORE ?
+                           MPI_STATUS_IGNORE : array_of_statuses + i);
+    }
+  }
+
+  return MPI_SUCCESS;
+}
+
+static void        *
+sc_mpithread_main (void *arg)
+{
+  sc_mpithread_rank_t *r = (sc_mpithread_rank_t *) arg;
+
+  SC_CHECK_ABORT (!pthread_setspecific (sc_mpithread_key, r),
+                  "Set specific");
+  r->retval = r->main_fn (r->argc, r->argv);
+
+  return NULL;
+}
+
+int
+sc_mpi_run (int num_ranks, sc_mpi_main_t main_fn, int argc, char **argv)
+{
+  int                 i, retval;
+  const char         *env;
+  sc_mpithread_world_t world;
+  sc_mpithread_rank_t *r;
+
+  r = sc_mpithread_current ();
+  SC_CHECK_ABORT (r == &sc_mpithread_serial_rank,
+                  "sc_mpi_run must not be nested");
+
+  if (num_ranks <= 0) {
+    env = getenv ("SC_MPI_THREADS");
+    num_ranks = SC_MAX (env != NULL ? atoi (env) : 1, 1);
+  }
+
+  sc_mpithread_world_init
+    (&world, num_ranks, (sc_mpithread_rank_t *) sc_mpithread_realloc
+     (NULL, num_ranks * sizeof (sc_mpithread_rank_t)),
+     (const void **) sc_mpithread_realloc (NULL,
+                                          num_ranks * sizeof (void *)));
+  for (i = 0; i < num_ranks; ++i) {
+    r = world.ranks + i;
+    r->main_fn = main_fn;
+    r->argc = argc;
+    r->argv = argv;
+    SC_CHECK_ABORT (!pthread_create (&r->thread, NULL,
+                                     sc_mpithread_main, r), "Create rank");
+  }
+
+  retval = 0;
+  for (i = 0; i < num_ranks; ++i) {
+    r = world.ranks + i;
+    SC_CHECK_ABORT (!pthread_join (r->thread, NULL), "Join rank");
+    if (retval == 0) {
+      retval = r->retval;
+    }
+    sc_mpithread_rank_reset (r);
+  }
+  SC_CHECK_ABORT (!pthread_mutex_destroy (&world.mutex), "Mutex destroy");
+  SC_CHECK_ABORT (!pthread_cond_destroy (&world.cond), "Cond destroy");
+  free (world.ranks);
+  free (world.slots);
+
+  return retval;
+}
+
+#endif /* SC_MPITHREAD */
+
 double
 MPI_Wtime (void)
 {
@@ -314,6 +1437,24 @@ sc_mpi_sizeof (MPI_Datatype t)
     return sizeof (double);
   if (t == MPI_LONG_DOUBLE)
     return sizeof (long double);
+  if (t == MPI_2INT)
+    return 2 * sizeof (int);
+  if (t == MPI_FLOAT_INT)
+    return sizeof (sc_mpi_float_int_t);
+  if (t == MPI_DOUBLE_INT)
+    return sizeof (sc_mpi_double_int_t);
+  if (t == MPI_LONG_INT)
+    return sizeof (sc_mpi_long_int_t);
 
   SC_ABORT_NOT_REACHED ();
 }
+
+#ifndef SC_MPITHREAD
+
+int
+sc_mpi_run (int num_ranks, sc_mpi_main_t main_fn, int argc, char **argv)
+{
+  return main_fn (argc, argv);
+}
+
+#endif /* !SC_MPITHREAD */
@@ -33,10 +33,14 @@ typedef enum
   SC_TAG_AG_RECURSIVE_A,
   SC_TAG_AG_RECURSIVE_B,
   SC_TAG_AG_RECURSIVE_C,
-  SC_TAG_NOTIFY_RECURSIVE,
-  SC_TAG_REDUCE,
+  SC_TAG_NOTIFY_RECURSIVE,     /* first of 32 tags, one per level */
+  SC_TAG_REDUCE = SC_TAG_NOTIFY_RECURSIVE + 32,
   SC_TAG_PSORT_LO,
-  SC_TAG_PSORT_HI
+  SC_TAG_PSORT_HI,
+  SC_TAG_ABORT,
+  SC_TAG_NOTIFY_NODE,
+  SC_TAG_NEIGHBOR,
+  SC_TAG_COLL           /* first of SC_COLL_NUM_TAGS tags in sc_coll.h */
 }
 sc_tag_t;
 
@@ -68,6 +72,10 @@ sc_tag_t;
 #define MPI_FLOAT               ((MPI_Datatype) 0x4c00040a)
 #define MPI_DOUBLE              ((MPI_Datatype) 0x4c00080b)
 #define MPI_LONG_DOUBLE         ((MPI_Datatype) 0x4c000c0c)
+#define MPI_2INT                ((MPI_Datatype) 0x4c000816)
+#define MPI_FLOAT_INT           ((MPI_Datatype) 0x8c000000)
+#define MPI_DOUBLE_INT          ((MPI_Datatype) 0x8c000001)
+#define MPI_LONG_INT            ((MPI_Datatype) 0x8c000002)
 
 #define MPI_MAX                 ((MPI_Op) 0x58000001)
 #define MPI_MIN                 ((MPI_Op) 0x58000002)
@@ -99,7 +107,10 @@ typedef struct MPI_Status
 }
 MPI_Status;
 
-/* These functions are valid and functional for a single process. */
+/* These functions are valid and functional for a single process.
+ * With --enable-mpithread they are functional for the ranks emulated
+ * by threads in sc_mpi_run, see below.
+ */
 
 int                 MPI_Init (int *, char ***);
 int                 MPI_Finalize (void);
@@ -128,7 +139,7 @@ int                 MPI_Allreduce (void *, void *, int, MPI_Datatype,
 
 double              MPI_Wtime (void);
 
-/* These functions will abort. */
+/* These functions will abort unless the ranks are emulated. */
 int                 MPI_Recv (void *, int, MPI_Datatype, int, int, MPI_Comm,
                               MPI_Status *);
 int                 MPI_Irecv (void *, int, MPI_Datatype, int, int, MPI_Comm,
@@ -140,14 +151,110 @@ int                 MPI_Probe (int, int, MPI_Comm, MPI_Status *);
 int                 MPI_Iprobe (int, int, MPI_Comm, int *, MPI_Status *);
 int                 MPI_Get_count (MPI_Status *, MPI_Datatype, int *);
 
-/* These functions are only allowed to be called with zero size arrays. */
+/* These functions are only allowed to be called with zero size arrays
+ * unless the ranks are emulated. */
 int                 MPI_Wait (MPI_Request *, MPI_Status *);
 int                 MPI_Waitsome (int, MPI_Request *,
                                   int *, int *, MPI_Status *);
 int                 MPI_Waitall (int, MPI_Request *, MPI_Status *);
+int                 MPI_Testall (int, MPI_Request *, int *, MPI_Status *);
+
+#ifdef SC_MPITHREAD
+
+/* These functions exist only where the ranks are emulated by threads. */
+
+#define MPI_KEYVAL_INVALID      0x24000000
+#define MPI_COMM_NULL_COPY_FN   ((MPI_Comm_copy_attr_function *) 0)
+#define MPI_COMM_NULL_DELETE_FN ((MPI_Comm_delete_attr_function *) 0)
+
+typedef int         MPI_Comm_copy_attr_function (MPI_Comm, int, void *,
+                                                 void *, void *, int *);
+typedef int         MPI_Comm_delete_attr_function (MPI_Comm, int,
+                                                   void *, void *);
+
+int                 MPI_Comm_create_keyval (MPI_Comm_copy_attr_function *,
+                                            MPI_Comm_delete_attr_function *,
+                                            int *, void *);
+int                 MPI_Comm_get_attr (MPI_Comm, int, void *, int *);
+int                 MPI_Comm_set_attr (MPI_Comm, int, void *);
+
+int                 MPI_Send_init (void *, int, MPI_Datatype, int, int,
+                                   MPI_Comm, MPI_Request *);
+int                 MPI_Recv_init (void *, int, MPI_Datatype, int, int,
+                                   MPI_Comm, MPI_Request *);
+int                 MPI_Startall (int, MPI_Request *);
+int                 MPI_Request_free (MPI_Request *);
+int                 MPI_Test (MPI_Request *, int *, MPI_Status *);
+
+#endif /* SC_MPITHREAD */
 
 #endif /* !SC_MPI */
 
+/** Defined if a communicator may contain more than one process,
+ * either with MPI or with the ranks emulated by threads.
+ */
+#if defined SC_MPI || defined SC_MPITHREAD
+#define SC_MPI_RANKS
+#endif
+
+/** The value and index pairs of MPI_MINLOC and MPI_MAXLOC. */
+typedef struct sc_mpi_float_int
+{
+  float               value;
+  int                 index;
+}
+sc_mpi_float_int_t;
+
+typedef struct sc_mpi_double_int
+{
+  double              value;
+  int                 index;
+}
+sc_mpi_double_int_t;
+
+typedef struct sc_mpi_long_int
+{
+  long                value;
+  int                 index;
+}
+sc_mpi_long_int_t;
+
+typedef struct sc_mpi_2int
+{
+  int                 value;
+  int                 index;
+}
+sc_mpi_2int_t;
+
+/** The main function of a program run by sc_mpi_run. */
+typedef int         (*sc_mpi_main_t) (int argc, char **argv);
+
+/** Run a function on all ranks of MPI_COMM_WORLD.
+ * With --enable-mpithread and without MPI, the function is run by
+ * num_ranks threads of this process, each of which sees MPI_COMM_WORLD
+ * with num_ranks processes and itself as the rank of its thread.
+ * The emulation delivers messages through in-memory mailboxes and
+ * implements the collectives with a barrier over shared buffers, such
+ * that the communication algorithms of libsc can be tested and profiled
+ * at scale on a single machine.  Outside of sc_mpi_run the calling
+ * thread sees MPI_COMM_WORLD with a single process.
+ * Since the ranks share the process, sc_init and sc_finalize, the
+ * parsing of options, and any other global setup are to be done once
+ * around this call and not by main_fn.
+ * Otherwise this function just calls main_fn and num_ranks is ignored;
+ * with MPI the number of ranks is chosen by mpirun as usual.
+ * \param [in] num_ranks   The number of emulated ranks.  If not positive,
+ *                          it is taken from the environment variable
+ *                          SC_MPI_THREADS or defaults to 1.
+ * \param [in] main_fn     Function to run on every rank.
+ * \param [in] argc        Passed to main_fn.
+ * \param [in] argv        Passed to main_fn, shared by all ranks.
+ * \return                 The first nonzero return value of main_fn
+ *                          in the order of the ranks, or 0.
+ */
+int                 sc_mpi_run (int num_ranks, sc_mpi_main_t main_fn,
+                                int argc, char **argv);
+
 /** Return the size of MPI data types.
  * \param [in] t    MPI data type.
  * \return          Returns the size in bytes.
@@ -0,0 +1,259 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_containers.h>
+#include <sc_neighbor.h>
+
+/** The coalesced message of one peer. */
+typedef struct sc_neighbor_peer
+{
+  int                 rank;
+  size_t              offset;
+  size_t              bytes;
+}
+sc_neighbor_peer_t;
+
+struct sc_neighbor
+{
+  MPI_Comm            mpicomm;  /* duplicate owned by the exchange */
+  int                 mpirank;
+  int                 active;
+  size_t             *send_offsets, *recv_offsets;
+  char               *sendbuf, *recvbuf;
+  sc_array_t          send_peers, recv_peers;
+  sc_neighbor_peer_t *self_send, *self_recv;
+  int                 num_requests;
+  MPI_Request        *requests;
+};
+
+static int
+sc_neighbor_compare (const void *v1, const void *v2)
+{
+  const int          *p1 = (const int *) v1;
+  const int          *p2 = (const int *) v2;
+
+  /* order by peer and keep the order of the messages of one peer */
+  return p1[0] != p2[0] ? (p1[0] < p2[0] ? -1 : 1) :
+    p1[1] == p2[1] ? 0 : (p1[1] < p2[1] ? -1 : 1);
+}
+
+/** Place the messages of each peer next to each other in one buffer.
+ * \param [out] offsets     The offset of every message.
+ * \param [in,out] peers    Initialized array of sc_neighbor_peer_t,
+ *                          filled with the coalesced messages.
+ * \return                  The size of the buffer.
+ */
+static size_t
+sc_neighbor_layout (int num, const int *ranks, const size_t *bytes,
+                    size_t *offsets, sc_array_t * peers)
+{
+  int                 i, k;
+  int                *order;
+  size_t              total;
+  sc_neighbor_peer_t *peer;
+
+  order = SC_ALLOC (int, 2 * num);
+  for (i = 0; i < num; ++i) {
+    order[2 * i] = ranks[i];
+    order[2 * i + 1] = i;
+  }
+  qsort (order, num, 2 * sizeof (int), sc_neighbor_compare);
+
+  total = 0;
+  peer = NULL;
+  for (i = 0; i < num; ++i) {
+    k = order[2 * i + 1];
+    if (peer == NULL || peer->rank != ranks[k]) {
+      peer = (sc_neighbor_peer_t *) sc_array_push (peers);
+      peer->rank = ranks[k];
+      peer->offset = total;
+      peer->bytes = 0;
+    }
+    offsets[k] = total;
+    peer->bytes += bytes[k];
+    total += bytes[k];
+  }
+  SC_FREE (order);
+
+  return total;
+}
+
+/** Find the coalesced message of a peer. */
+static sc_neighbor_peer_t *
+sc_neighbor_find (sc_array_t * peers, int rank)
+{
+  size_t              zz;
+  sc_neighbor_peer_t *peer;
+
+  for (zz = 0; zz < peers->elem_count; ++zz) {
+    peer = (sc_neighbor_peer_t *) sc_array_index (peers, zz);
+    if (peer->rank == rank) {
+      return peer;
+    }
+  }
+  return NULL;
+}
+
+sc_neighbor_t      *
+sc_neighbor_new (MPI_Comm mpicomm,
+                 int num_receivers, const int *receivers,
+                 const size_t *sendbytes,
+                 int num_senders, const int *senders,
+                 const size_t *recvbytes)
+{
+  int                 mpiret;
+  sc_neighbor_t      *nb;
+#ifdef SC_MPI_RANKS
+  size_t              zz;
+  sc_neighbor_peer_t *peer;
+#endif
+
+  SC_ASSERT (num_receivers >= 0 && num_senders >= 0);
+
+  nb = SC_ALLOC (sc_neighbor_t, 1);
+  /* no other message can match the persistent requests */
+  mpiret = MPI_Comm_dup (mpicomm, &nb->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (nb->mpicomm, &nb->mpirank);
+  SC_CHECK_MPI (mpiret);
+  nb->active = 0;
+
+  /* the buffers are allocated once for all steps */
+  sc_array_init (&nb->send_peers, sizeof (sc_neighbor_peer_t));
+  sc_array_init (&nb->recv_peers, sizeof (sc_neighbor_peer_t));
+  nb->send_offsets = SC_ALLOC (size_t, num_receivers);
+  nb->recv_offsets = SC_ALLOC (size_t, num_senders);
+  nb->sendbuf = SC_ALLOC (char, sc_neighbor_layout
+                          (num_receivers, receivers, sendbytes,
+                           nb->send_offsets, &nb->send_peers));
+  nb->recvbuf = SC_ALLOC (char, sc_neighbor_layout
+                          (num_senders, senders, recvbytes,
+                           nb->recv_offsets, &nb->recv_peers));
+
+  nb->self_send = sc_neighbor_find (&nb->send_peers, nb->mpirank);
+  nb->self_recv = sc_neighbor_find (&nb->recv_peers, nb->mpirank);
+  SC_CHECK_ABORT ((nb->self_send == NULL) == (nb->self_recv == NULL) &&
+                  (nb->self_send == NULL ||
+                   nb->self_send->bytes == nb->self_recv->bytes),
+                  "Mismatched messages to self");
+
+  nb->num_requests = 0;
+  nb->requests = SC_ALLOC (MPI_Request, nb->send_peers.elem_count +
+                           nb->recv_peers.elem_count);
+#ifdef SC_MPI_RANKS
+  for (zz = 0; zz < nb->recv_peers.elem_count; ++zz) {
+    peer = (sc_neighbor_peer_t *) sc_array_index (&nb->recv_peers, zz);
+    if (peer != nb->self_recv) {
+      SC_CHECK_ABORT (peer->bytes <= (size_t) INT_MAX, "Message too large");
+      mpiret = MPI_Recv_init (nb->recvbuf + peer->offset, (int) peer->bytes,
+                              MPI_BYTE, peer->rank, SC_TAG_NEIGHBOR,
+                              nb->mpicomm, nb->requests + nb->num_requests++);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  for (zz = 0; zz < nb->send_peers.elem_count; ++zz) {
+    peer = (sc_neighbor_peer_t *) sc_array_index (&nb->send_peers, zz);
+    if (peer != nb->self_send) {
+      SC_CHECK_ABORT (peer->bytes <= (size_t) INT_MAX, "Message too large");
+      mpiret = MPI_Send_init (nb->sendbuf + peer->offset, (int) peer->bytes,
+                              MPI_BYTE, peer->rank, SC_TAG_NEIGHBOR,
+                              nb->mpicomm, nb->requests + nb->num_requests++);
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+#endif
+
+  return nb;
+}
+
+void
+sc_neighbor_destroy (sc_neighbor_t * nb)
+{
+  int                 mpiret;
+#ifdef SC_MPI_RANKS
+  int                 i;
+
+  for (i = 0; i < nb->num_requests; ++i) {
+    mpiret = MPI_Request_free (nb->requests + i);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+  SC_ASSERT (!nb->active);
+  mpiret = MPI_Comm_free (&nb->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  SC_FREE (nb->requests);
+  SC_FREE (nb->send_offsets);
+  SC_FREE (nb->recv_offsets);
+  SC_FREE (nb->sendbuf);
+  SC_FREE (nb->recvbuf);
+  sc_array_reset (&nb->send_peers);
+  sc_array_reset (&nb->recv_peers);
+  SC_FREE (nb);
+}
+
+void               *
+sc_neighbor_send_buffer (sc_neighbor_t * nb, int i)
+{
+  return nb->sendbuf + nb->send_offsets[i];
+}
+
+void               *
+sc_neighbor_recv_buffer (sc_neighbor_t * nb, int i)
+{
+  return nb->recvbuf + nb->recv_offsets[i];
+}
+
+void
+sc_neighbor_start (sc_neighbor_t * nb)
+{
+#ifdef SC_MPI_RANKS
+  int                 mpiret;
+#endif
+
+  SC_ASSERT (!nb->active);
+
+#ifdef SC_MPI_RANKS
+  if (nb->num_requests > 0) {
+    mpiret = MPI_Startall (nb->num_requests, nb->requests);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+  if (nb->self_send != NULL && nb->self_send->bytes > 0) {
+    memcpy (nb->recvbuf + nb->self_recv->offset,
+            nb->sendbuf + nb->self_send->offset, nb->self_send->bytes);
+  }
+  nb->active = 1;
+}
+
+void
+sc_neighbor_wait (sc_neighbor_t * nb)
+{
+  int                 mpiret;
+
+  SC_ASSERT (nb->active);
+
+  mpiret = MPI_Waitall (nb->num_requests, nb->requests,
+                        MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  nb->active = 0;
+}
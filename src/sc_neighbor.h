@@ -0,0 +1,93 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+/* Persistent exchange of messages with a fixed set of neighbors.
+ *
+ * A ghost or halo exchange sends the same kind of messages to the same
+ * processes in every step.  sc_neighbor_new is called once with the
+ * lists of messages to send and to receive, which may be obtained by
+ * sc_notify or sc_notify_exchange.  It allocates one send and one
+ * receive buffer and sets up persistent requests.  In every step the
+ * messages are written into sc_neighbor_send_buffer, the exchange is
+ * run by sc_neighbor_start and sc_neighbor_wait, and the received
+ * messages are read from sc_neighbor_recv_buffer.
+ *
+ * Several messages to the same process are coalesced into one, in the
+ * order in which they are listed.  The receiver must list the messages
+ * from that process in the same order and with the same sizes.
+ * Messages from a process to itself are copied.
+ */
+
+#ifndef SC_NEIGHBOR_H
+#define SC_NEIGHBOR_H
+
+#include <sc.h>
+
+SC_EXTERN_C_BEGIN;
+
+typedef struct sc_neighbor sc_neighbor_t;
+
+/** Collectively create a persistent neighbor exchange.
+ * \param [in] mpicomm          MPI communicator to use.  It is duplicated
+ *                              so that other messages never match.
+ * \param [in] num_receivers    Number of messages to send.
+ * \param [in] receivers        For each message the receiving rank.
+ *                              A rank may appear several times.
+ * \param [in] sendbytes        For each message its size in bytes.
+ * \param [in] num_senders      Number of messages to receive.
+ * \param [in] senders          For each message the sending rank.
+ * \param [in] recvbytes        For each message its size in bytes.
+ * \return                      The exchange, to be freed by
+ *                              sc_neighbor_destroy.
+ */
+sc_neighbor_t      *sc_neighbor_new (MPI_Comm mpicomm,
+                                     int num_receivers, const int *receivers,
+                                     const size_t *sendbytes,
+                                     int num_senders, const int *senders,
+                                     const size_t *recvbytes);
+
+/** Free an exchange that is not active. */
+void                sc_neighbor_destroy (sc_neighbor_t * nb);
+
+/** Return the place of a message to send.
+ * \param [in] i    Index into the receivers passed to sc_neighbor_new.
+ * \return          Memory of sendbytes[i] bytes, valid until destroy.
+ */
+void               *sc_neighbor_send_buffer (sc_neighbor_t * nb, int i);
+
+/** Return the place of a received message.
+ * \param [in] i    Index into the senders passed to sc_neighbor_new.
+ * \return          Memory of recvbytes[i] bytes, valid until destroy.
+ */
+void               *sc_neighbor_recv_buffer (sc_neighbor_t * nb, int i);
+
+/** Start the exchange of the send buffers.
+ * The send buffers must not be modified until sc_neighbor_wait.
+ */
+void                sc_neighbor_start (sc_neighbor_t * nb);
+
+/** Complete the exchange.  The receive buffers are then valid. */
+void                sc_neighbor_wait (sc_neighbor_t * nb);
+
+SC_EXTERN_C_END;
+
+#endif /* !SC_NEIGHBOR_H */
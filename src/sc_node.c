@@ -0,0 +1,544 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_allgather.h>
+#include <sc_containers.h>
+#include <sc_node.h>
+#include <sc_notify.h>
+
+#ifdef SC_NODE_SHARED
+
+/** Allocate a window of the node whose memory belongs to the leader.
+ * \param [out] base    Address of the leader's memory on this process.
+ */
+static void
+sc_node_window_new (sc_node_comm_t * node, size_t bytes,
+                    MPI_Win * win, void *base)
+{
+  int                 mpiret;
+  int                 disp_unit;
+  void               *local;
+  MPI_Aint            size;
+
+  size = (MPI_Aint) (node->node_rank == 0 ? SC_MAX (bytes, 1) : 0);
+  mpiret = MPI_Win_allocate_shared (size, 1, MPI_INFO_NULL,
+                                    node->intranode, &local, win);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_shared_query (*win, 0, &size, &disp_unit, base);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_lock_all (MPI_MODE_NOCHECK, *win);
+  SC_CHECK_MPI (mpiret);
+}
+
+static void
+sc_node_window_destroy (MPI_Win * win)
+{
+  int                 mpiret;
+
+  mpiret = MPI_Win_unlock_all (*win);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_free (win);
+  SC_CHECK_MPI (mpiret);
+}
+
+#endif /* SC_NODE_SHARED */
+
+/** Make the shared data of the node at least this large.
+ * This function is collective on the node and invalidates the data.
+ */
+static void
+sc_node_reserve (sc_node_comm_t * node, size_t bytes)
+{
+  if (bytes <= node->data_bytes) {
+    return;
+  }
+#ifdef SC_NODE_SHARED
+  if (node->data_bytes > 0) {
+    sc_node_window_destroy (&node->data_win);
+  }
+  sc_node_window_new (node, bytes, &node->data_win, &node->data);
+#else
+  SC_FREE (node->data);
+  node->data = SC_ALLOC (char, bytes);
+#endif
+  node->data_bytes = bytes;
+}
+
+/** Make the writes to the shared memory visible on the node.
+ * This function is collective on the node.
+ */
+static void
+sc_node_sync (sc_node_comm_t * node)
+{
+#ifdef SC_NODE_SHARED
+  int                 mpiret;
+
+  mpiret = MPI_Win_sync (node->ctrl_win);
+  SC_CHECK_MPI (mpiret);
+  if (node->data_bytes > 0) {
+    mpiret = MPI_Win_sync (node->data_win);
+    SC_CHECK_MPI (mpiret);
+  }
+  mpiret = MPI_Barrier (node->intranode);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Win_sync (node->ctrl_win);
+  SC_CHECK_MPI (mpiret);
+  if (node->data_bytes > 0) {
+    mpiret = MPI_Win_sync (node->data_win);
+    SC_CHECK_MPI (mpiret);
+  }
+#endif
+}
+
+sc_node_comm_t     *
+sc_node_comm_new (MPI_Comm mpicomm, int processes_per_node)
+{
+  int                 mpiret;
+  int                 i, k;
+  int                 ids[2];
+  int                *allids;
+  sc_node_comm_t     *node;
+#ifdef SC_NODE_SHARED
+  int                 shared_rank;
+  MPI_Comm            shared;
+#endif
+
+  node = SC_ALLOC_ZERO (sc_node_comm_t, 1);
+  node->mpicomm = mpicomm;
+  mpiret = MPI_Comm_size (mpicomm, &node->mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &node->mpirank);
+  SC_CHECK_MPI (mpiret);
+
+#ifdef SC_NODE_SHARED
+  mpiret = MPI_Comm_split_type (mpicomm, MPI_COMM_TYPE_SHARED,
+                                node->mpirank, MPI_INFO_NULL, &shared);
+  SC_CHECK_MPI (mpiret);
+  if (processes_per_node > 0) {
+    mpiret = MPI_Comm_rank (shared, &shared_rank);
+    SC_CHECK_MPI (mpiret);
+    mpiret = MPI_Comm_split (shared, shared_rank / processes_per_node,
+                             shared_rank, &node->intranode);
+    SC_CHECK_MPI (mpiret);
+    mpiret = MPI_Comm_free (&shared);
+    SC_CHECK_MPI (mpiret);
+  }
+  else {
+    node->intranode = shared;
+  }
+  mpiret = MPI_Comm_size (node->intranode, &node->node_size);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (node->intranode, &node->node_rank);
+  SC_CHECK_MPI (mpiret);
+
+  mpiret = MPI_Comm_split (mpicomm, node->node_rank == 0 ? 0 : MPI_UNDEFINED,
+                           node->mpirank, &node->internode);
+  SC_CHECK_MPI (mpiret);
+  if (node->node_rank == 0) {
+    mpiret = MPI_Comm_size (node->internode, &ids[0]);
+    SC_CHECK_MPI (mpiret);
+    mpiret = MPI_Comm_rank (node->internode, &ids[1]);
+    SC_CHECK_MPI (mpiret);
+  }
+  mpiret = MPI_Bcast (ids, 2, MPI_INT, 0, node->intranode);
+  SC_CHECK_MPI (mpiret);
+  node->num_nodes = ids[0];
+  node->node_index = ids[1];
+
+  sc_node_window_new (node, node->node_size * sizeof (size_t),
+                      &node->ctrl_win, &node->ctrl);
+#else
+  /* every process is a node of its own */
+  node->intranode = MPI_COMM_SELF;
+  node->internode = mpicomm;
+  node->node_size = 1;
+  node->node_rank = 0;
+  node->num_nodes = node->mpisize;
+  node->node_index = node->mpirank;
+  node->ctrl = SC_ALLOC (size_t, 1);
+#endif
+
+  /* find the position of every rank in node-major order */
+  ids[0] = node->node_index;
+  ids[1] = node->node_rank;
+  allids = SC_ALLOC (int, 2 * node->mpisize);
+  mpiret = MPI_Allgather (ids, 2, MPI_INT, allids, 2, MPI_INT, mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  node->node_offsets = SC_ALLOC_ZERO (int, node->num_nodes + 1);
+  for (i = 0; i < node->mpisize; ++i) {
+    ++node->node_offsets[allids[2 * i] + 1];
+  }
+  for (k = 0; k < node->num_nodes; ++k) {
+    node->node_offsets[k + 1] += node->node_offsets[k];
+  }
+  SC_ASSERT (node->node_offsets[node->num_nodes] == node->mpisize);
+
+  node->nodes = SC_ALLOC (int, node->mpisize);
+  node->positions = SC_ALLOC (int, node->mpisize);
+  node->ranks = SC_ALLOC (int, node->mpisize);
+  node->contiguous = 1;
+  for (i = 0; i < node->mpisize; ++i) {
+    node->nodes[i] = allids[2 * i];
+    k = node->node_offsets[allids[2 * i]] + allids[2 * i + 1];
+    node->positions[i] = k;
+    node->ranks[k] = i;
+    if (k != i) {
+      node->contiguous = 0;
+    }
+  }
+  SC_FREE (allids);
+
+  return node;
+}
+
+void
+sc_node_comm_destroy (sc_node_comm_t * node)
+{
+#ifdef SC_NODE_SHARED
+  int                 mpiret;
+
+  if (node->data_bytes > 0) {
+    sc_node_window_destroy (&node->data_win);
+  }
+  sc_node_window_destroy (&node->ctrl_win);
+  if (node->internode != MPI_COMM_NULL) {
+    mpiret = MPI_Comm_free (&node->internode);
+    SC_CHECK_MPI (mpiret);
+  }
+  mpiret = MPI_Comm_free (&node->intranode);
+  SC_CHECK_MPI (mpiret);
+#else
+  SC_FREE (node->data);
+  SC_FREE (node->ctrl);
+#endif
+
+  SC_FREE (node->node_offsets);
+  SC_FREE (node->nodes);
+  SC_FREE (node->positions);
+  SC_FREE (node->ranks);
+  SC_FREE (node);
+}
+
+int
+sc_node_allgather (sc_node_comm_t * node, void *sendbuf, int sendcount,
+                   MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                   MPI_Datatype recvtype)
+{
+  int                 mpiret;
+  int                 i, k;
+  int                *counts, *displs;
+  size_t              datasize;
+
+  SC_ASSERT (sendcount >= 0 && recvcount >= 0);
+
+  /* *INDENT-OFF* HORRIBLE indent bug */
+  datasize = (size_t) sendcount * sc_mpi_sizeof (sendtype);
+  /* *INDENT-ON* */
+  SC_ASSERT (datasize == (size_t) recvcount * sc_mpi_sizeof (recvtype));
+
+  /* collect the contributions of this node in node-major order */
+  sc_node_reserve (node, node->mpisize * datasize);
+  memcpy (node->data + node->positions[node->mpirank] * datasize,
+          sendbuf, datasize);
+  sc_node_sync (node);
+
+  /* the leaders exchange the data of their nodes in place */
+  if (node->node_rank == 0 && node->num_nodes > 1) {
+    counts = SC_ALLOC (int, node->num_nodes);
+    displs = SC_ALLOC (int, node->num_nodes);
+    for (k = 0; k < node->num_nodes; ++k) {
+      counts[k] = (node->node_offsets[k + 1] - node->node_offsets[k]) *
+        recvcount;
+      displs[k] = node->node_offsets[k] * recvcount;
+    }
+    mpiret = sc_allgatherv (node->data + displs[node->node_index] *
+                            sc_mpi_sizeof (recvtype),
+                            counts[node->node_index], recvtype, node->data,
+                            counts, displs, recvtype, node->internode);
+    SC_CHECK_MPI (mpiret);
+    SC_FREE (counts);
+    SC_FREE (displs);
+  }
+  sc_node_sync (node);
+
+  if (node->contiguous) {
+    memcpy (recvbuf, node->data, node->mpisize * datasize);
+  }
+  else {
+    for (i = 0; i < node->mpisize; ++i) {
+      memcpy (((char *) recvbuf) + i * datasize,
+              node->data + node->positions[i] * datasize, datasize);
+    }
+  }
+
+  /* the shared data must not be overwritten while it is read */
+  sc_node_sync (node);
+
+  return MPI_SUCCESS;
+}
+
+int
+sc_node_allreduce_custom (sc_node_comm_t * node, void *sendbuf,
+                          void *recvbuf, int sendcount,
+                          MPI_Datatype sendtype, sc_reduce_t reduce_fn)
+{
+  int                 mpiret;
+  int                 i;
+  int                 first, last;
+  size_t              typesize, datasize;
+  char               *result;
+
+  SC_ASSERT (sendcount >= 0);
+  SC_ASSERT (reduce_fn != NULL);
+
+  typesize = sc_mpi_sizeof (sendtype);
+  datasize = (size_t) sendcount * typesize;
+
+  /* one slot per process of the node followed by the result */
+  sc_node_reserve (node, (node->node_size + 1) * datasize);
+  result = node->data + node->node_size * datasize;
+  memcpy (node->data + node->node_rank * datasize, sendbuf, datasize);
+  sc_node_sync (node);
+
+  /* every process reduces one segment of the slots into the first */
+  first = (int) (((long long) sendcount * node->node_rank) /
+                 node->node_size);
+  last = (int) (((long long) sendcount * (node->node_rank + 1)) /
+                node->node_size);
+  if (first < last) {
+    for (i = 1; i < node->node_size; ++i) {
+      reduce_fn (node->data + i * datasize + first * typesize,
+                 node->data + first * typesize,
+                 last - first, sendtype);
+    }
+  }
+  sc_node_sync (node);
+
+  if (node->node_rank == 0) {
+    if (node->num_nodes > 1) {
+      mpiret = sc_allreduce_custom (node->data, result, sendcount,
+                                    sendtype, reduce_fn, node->internode);
+      SC_CHECK_MPI (mpiret);
+    }
+    else {
+      memcpy (result, node->data, datasize);
+    }
+  }
+  sc_node_sync (node);
+
+  memcpy (recvbuf, result, datasize);
+  sc_node_sync (node);
+
+  return MPI_SUCCESS;
+}
+
+int
+sc_node_allreduce (sc_node_comm_t * node, void *sendbuf, void *recvbuf,
+                   int sendcount, MPI_Datatype sendtype, MPI_Op operation)
+{
+  return sc_node_allreduce_custom (node, sendbuf, recvbuf, sendcount,
+                                   sendtype,
+                                   sc_reduce_operation_fn (operation));
+}
+
+static int
+sc_node_pair_compare (const void *v1, const void *v2)
+{
+  const int          *p1 = (const int *) v1;
+  const int          *p2 = (const int *) v2;
+
+  if (p1[0] != p2[0]) {
+    return p1[0] < p2[0] ? -1 : 1;
+  }
+  return p1[1] == p2[1] ? 0 : p1[1] < p2[1] ? -1 : 1;
+}
+
+/** Exchange the (receiver, sender) pairs among the leaders.
+ * \param [in] pairs    The pairs of all processes of this node.
+ * \param [in,out] mine The pairs whose receivers are on this node
+ *                      are appended in no particular order.
+ */
+static void
+sc_node_notify_leaders (sc_node_comm_t * node, sc_array_t * pairs,
+                        sc_array_t * mine)
+{
+  const int           num_nodes = node->num_nodes;
+  int                 mpiret;
+  int                 i, k, count;
+  int                 num_dests, num_sources;
+  int                *pint, *sorted;
+  int                *node_first, *node_fill;
+  int                *dests, *sources;
+  MPI_Request        *requests;
+  MPI_Status          status;
+
+  /* bucket the pairs by the node of their receiver */
+  node_first = SC_ALLOC_ZERO (int, num_nodes + 1);
+  for (i = 0; i < (int) pairs->elem_count; ++i) {
+    pint = (int *) sc_array_index_int (pairs, i);
+    ++node_first[node->nodes[pint[0]] + 1];
+  }
+  node_fill = SC_ALLOC (int, num_nodes);
+  for (k = 0; k < num_nodes; ++k) {
+    node_first[k + 1] += node_first[k];
+    node_fill[k] = node_first[k];
+  }
+  sorted = SC_ALLOC (int, 2 * pairs->elem_count);
+  for (i = 0; i < (int) pairs->elem_count; ++i) {
+    pint = (int *) sc_array_index_int (pairs, i);
+    k = node_fill[node->nodes[pint[0]]]++;
+    sorted[2 * k] = pint[0];
+    sorted[2 * k + 1] = pint[1];
+  }
+  SC_FREE (node_fill);
+
+  /* the leaders learn which other leaders send to them */
+  dests = SC_ALLOC (int, num_nodes);
+  sources = SC_ALLOC (int, num_nodes);
+  num_dests = 0;
+  for (k = 0; k < num_nodes; ++k) {
+    if (k != node->node_index && node_first[k + 1] > node_first[k]) {
+      dests[num_dests++] = k;
+    }
+  }
+  mpiret = sc_notify (dests, num_dests, sources, &num_sources,
+                      node->internode);
+  SC_CHECK_MPI (mpiret);
+
+  requests = SC_ALLOC (MPI_Request, num_dests);
+  for (i = 0; i < num_dests; ++i) {
+    k = dests[i];
+    mpiret = MPI_Isend (sorted + 2 * node_first[k],
+                        2 * (node_first[k + 1] - node_first[k]), MPI_INT,
+                        k, SC_TAG_NOTIFY_NODE, node->internode,
+                        requests + i);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  k = node->node_index;
+  count = node_first[k + 1] - node_first[k];
+  if (count > 0) {
+    pint = (int *) sc_array_push_count (mine, (size_t) count);
+    memcpy (pint, sorted + 2 * node_first[k], 2 * count * sizeof (int));
+  }
+  for (i = 0; i < num_sources; ++i) {
+    mpiret = MPI_Probe (sources[i], SC_TAG_NOTIFY_NODE, node->internode,
+                        &status);
+    SC_CHECK_MPI (mpiret);
+    mpiret = MPI_Get_count (&status, MPI_INT, &count);
+    SC_CHECK_MPI (mpiret);
+    SC_ASSERT (count > 0 && count % 2 == 0);
+    pint = (int *) sc_array_push_count (mine, (size_t) (count / 2));
+    mpiret = MPI_Recv (pint, count, MPI_INT, sources[i], SC_TAG_NOTIFY_NODE,
+                       node->internode, MPI_STATUS_IGNORE);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  mpiret = MPI_Waitall (num_dests, requests, MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+
+  SC_FREE (requests);
+  SC_FREE (dests);
+  SC_FREE (sources);
+  SC_FREE (sorted);
+  SC_FREE (node_first);
+}
+
+int
+sc_node_notify (sc_node_comm_t * node, int *receivers, int num_receivers,
+                int *senders, int *num_senders)
+{
+  const int           node_size = node->node_size;
+  const int           first = node->node_offsets[node->node_index];
+  int                 i, l, sender;
+  int                *offsets, *lists, *pint;
+  sc_array_t         *pairs, *mine = NULL;
+
+  SC_ASSERT (num_receivers >= 0);
+  SC_ASSERT (senders != NULL && num_senders != NULL);
+
+  /* gather the receivers of all processes of this node */
+  offsets = SC_ALLOC (int, node_size + 1);
+  node->ctrl[node->node_rank] = (size_t) num_receivers;
+  sc_node_sync (node);
+  offsets[0] = 0;
+  for (l = 0; l < node_size; ++l) {
+    offsets[l + 1] = offsets[l] + (int) node->ctrl[l];
+  }
+  sc_node_reserve (node, offsets[node_size] * sizeof (int));
+  memcpy (node->data + offsets[node->node_rank] * sizeof (int), receivers,
+          num_receivers * sizeof (int));
+  sc_node_sync (node);
+
+  if (node->node_rank == 0) {
+    pairs = sc_array_new (2 * sizeof (int));
+    lists = (int *) node->data;
+    for (l = 0; l < node_size; ++l) {
+      sender = node->ranks[first + l];
+      for (i = offsets[l]; i < offsets[l + 1]; ++i) {
+        SC_ASSERT (0 <= lists[i] && lists[i] < node->mpisize);
+        pint = (int *) sc_array_push (pairs);
+        pint[0] = lists[i];
+        pint[1] = sender;
+      }
+    }
+    mine = sc_array_new (2 * sizeof (int));
+    sc_node_notify_leaders (node, pairs, mine);
+    sc_array_destroy (pairs);
+
+    /* sort the senders by the node rank of their receiver */
+    for (l = 0; l < node_size; ++l) {
+      node->ctrl[l] = 0;
+    }
+    for (i = 0; i < (int) mine->elem_count; ++i) {
+      pint = (int *) sc_array_index_int (mine, i);
+      pint[0] = node->positions[pint[0]] - first;
+      SC_ASSERT (0 <= pint[0] && pint[0] < node_size);
+      ++node->ctrl[pint[0]];
+    }
+    sc_array_sort (mine, sc_node_pair_compare);
+  }
+  sc_node_sync (node);
+
+  /* scatter the senders to the processes of this node */
+  for (l = 0; l < node_size; ++l) {
+    offsets[l + 1] = offsets[l] + (int) node->ctrl[l];
+  }
+  sc_node_reserve (node, offsets[node_size] * sizeof (int));
+  if (node->node_rank == 0) {
+    lists = (int *) node->data;
+    for (i = 0; i < (int) mine->elem_count; ++i) {
+      lists[i] = ((int *) sc_array_index_int (mine, i))[1];
+    }
+    sc_array_destroy (mine);
+  }
+  sc_node_sync (node);
+
+  *num_senders = offsets[node->node_rank + 1] - offsets[node->node_rank];
+  memcpy (senders, node->data + offsets[node->node_rank] * sizeof (int),
+          *num_senders * sizeof (int));
+  SC_FREE (offsets);
+  sc_node_sync (node);
+
+  return MPI_SUCCESS;
+}
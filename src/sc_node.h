@@ -0,0 +1,131 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+/* Hierarchical collectives on shared-memory nodes.
+ *
+ * An sc_node_comm_t splits a communicator into node communicators with
+ * MPI_Comm_split_type and a communicator of one leader per node.  The
+ * hierarchical collectives first combine the contributions of a node
+ * in an MPI-3 shared-memory window, then communicate among the leaders
+ * with the recursive schedules of sc_allgather, sc_reduce and sc_notify,
+ * and finally read the result from the window on every process.
+ * Without MPI-3 every process is a node of its own.
+ */
+
+#ifndef SC_NODE_H
+#define SC_NODE_H
+
+#include <sc_reduce.h>
+
+#if defined SC_MPI && MPI_VERSION >= 3
+#define SC_NODE_SHARED
+#endif
+
+SC_EXTERN_C_BEGIN;
+
+/** A communicator split into nodes.
+ * Nodes are numbered by the rank of their leader in the internode
+ * communicator, which are ordered as in the original communicator.
+ * The members below the comment are private.
+ */
+typedef struct sc_node_comm
+{
+  MPI_Comm            mpicomm;          /**< The original communicator. */
+  MPI_Comm            intranode;        /**< The processes of this node. */
+  MPI_Comm            internode;        /**< Leaders or MPI_COMM_NULL. */
+  int                 mpisize, mpirank;
+  int                 node_size;        /**< Size of intranode. */
+  int                 node_rank;        /**< Rank in intranode, 0 leads. */
+  int                 num_nodes;        /**< Size of internode. */
+  int                 node_index;       /**< Index of this node. */
+  int                *node_offsets;     /**< First position of each node. */
+  int                *nodes;            /**< Node index by rank. */
+  int                *positions;        /**< Node-major position by rank. */
+  int                *ranks;            /**< Rank by position. */
+
+  /* private */
+  int                 contiguous;       /**< Positions equal the ranks. */
+  size_t             *ctrl;             /**< node_size shared entries. */
+  char               *data;             /**< Shared data of the node. */
+  size_t              data_bytes;
+#ifdef SC_NODE_SHARED
+  MPI_Win             ctrl_win, data_win;
+#endif
+}
+sc_node_comm_t;
+
+/** Create the node communicators.  This function is collective.
+ * \param [in] mpicomm      Communicator to split.  It is not duplicated
+ *                          and must be valid until the node communicator
+ *                          is destroyed.
+ * \param [in] processes_per_node   If positive, each shared-memory node
+ *                          is split further into nodes of this many
+ *                          processes.  This allows to test the
+ *                          hierarchical algorithms on one machine.
+ * \return                  A new node communicator.
+ */
+sc_node_comm_t     *sc_node_comm_new (MPI_Comm mpicomm,
+                                      int processes_per_node);
+
+/** Free the node communicators.  This function is collective. */
+void                sc_node_comm_destroy (sc_node_comm_t * node);
+
+/** Hierarchical allgather with the semantics of sc_allgather. */
+int                 sc_node_allgather (sc_node_comm_t * node,
+                                       void *sendbuf, int sendcount,
+                                       MPI_Datatype sendtype, void *recvbuf,
+                                       int recvcount,
+                                       MPI_Datatype recvtype);
+
+/** Hierarchical allreduce with a custom reduction.
+ * The contributions of a node are reduced in the order of their node
+ * rank; thus the result may differ in rounding from sc_allreduce.
+ */
+int                 sc_node_allreduce_custom (sc_node_comm_t * node,
+                                              void *sendbuf, void *recvbuf,
+                                              int sendcount,
+                                              MPI_Datatype sendtype,
+                                              sc_reduce_t reduce_fn);
+
+/** Hierarchical allreduce with the semantics of sc_allreduce. */
+int                 sc_node_allreduce (sc_node_comm_t * node,
+                                       void *sendbuf, void *recvbuf,
+                                       int sendcount, MPI_Datatype sendtype,
+                                       MPI_Op operation);
+
+/** Hierarchical notify with the semantics of sc_notify.
+ * The leaders collect the messages of their node, notify each other
+ * by sc_notify and exchange the lists of all processes at once.
+ * \param [in] receivers        Sorted and unique array of ranks to inform.
+ * \param [in] num_receivers    Count of ranks contained in receivers.
+ * \param [in,out] senders      Array of at least size MPI_Comm_size.
+ *                              On output it contains the notifying ranks
+ *                              in ascending order.
+ * \param [out] num_senders     On output the number of notifying ranks.
+ */
+int                 sc_node_notify (sc_node_comm_t * node,
+                                    int *receivers, int num_receivers,
+                                    int *senders, int *num_senders);
+
+SC_EXTERN_C_END;
+
+#endif /* !SC_NODE_H */
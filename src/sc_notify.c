@@ -20,8 +20,9 @@
   02110-1301, USA.
 */
 
-#include <sc_containers.h>
+#include <sc_coll.h>
 #include <sc_notify.h>
+#include <sc_reduce.h>
 
 int
 sc_notify_allgather (int *receivers, int num_receivers,
@@ -432,3 +433,522 @@ sc_notify (int *receivers, int num_receivers,
 
   return MPI_SUCCESS;
 }
+
+/** Find the subgroup of a rank when splitting a range into parts.
+ * Part b of num_parts covers lo + (b * n) / num_parts until the start
+ * of part b + 1, where n = hi - lo.  The sizes differ by at most one.
+ */
+static int
+sc_notify_part_start (int lo, int hi, int num_parts, int b)
+{
+  return lo + (int) (((long) (hi - lo) * b) / num_parts);
+}
+
+/** Return the number of the first record with torank >= rank. */
+static size_t
+sc_notify_record_lower (sc_array_t * records, size_t first, int rank)
+{
+  int                *pint;
+
+  while (first < records->elem_count) {
+    pint = (int *) sc_array_index (records, first);
+    if (pint[0] >= rank) {
+      break;
+    }
+    first += 2 + pint[1];
+  }
+  return first;
+}
+
+int
+sc_notify_radix (int *receivers, int num_receivers,
+                 int *senders, int *num_senders, int radix, MPI_Comm mpicomm)
+{
+  int                 mpiret;
+  int                 mpisize, mpirank;
+  int                 i, b, a, g, t, j;
+  int                 lo, hi, tag, source, count;
+  int                 start[SC_NOTIFY_MAX_RADIX + 1];
+  int                *pint;
+  size_t              first[SC_NOTIFY_MAX_RADIX + 1];
+  sc_array_t          arrays[4];
+  sc_array_t         *cur, *acc, *out, *recvbuf, *temp;
+  sc_array_t          local;
+  MPI_Request         requests[SC_NOTIFY_MAX_RADIX];
+  MPI_Status          status;
+
+  SC_ASSERT (2 <= radix && radix <= SC_NOTIFY_MAX_RADIX);
+  SC_ASSERT (num_receivers >= 0);
+  SC_ASSERT (senders != NULL && num_senders != NULL);
+
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+  tag = sc_coll_next_tag (mpicomm);
+
+  /* the buffers are reused on all levels */
+  for (i = 0; i < 4; ++i) {
+    sc_array_init (arrays + i, sizeof (int));
+  }
+  cur = arrays + 0;
+  acc = arrays + 1;
+  out = arrays + 2;
+  recvbuf = arrays + 3;
+
+  pint = (int *) sc_array_push_count (cur, 3 * num_receivers);
+  for (i = 0; i < num_receivers; ++i) {
+    SC_ASSERT (i == 0 || receivers[i - 1] < receivers[i]);
+    SC_ASSERT (0 <= receivers[i] && receivers[i] < mpisize);
+    pint[3 * i + 0] = receivers[i];
+    pint[3 * i + 1] = 1;
+    pint[3 * i + 2] = mpirank;
+  }
+
+  /* each level narrows the range of ranks by the radix */
+  lo = 0;
+  hi = mpisize;
+  while (hi - lo > 1) {
+    g = SC_MIN (radix, hi - lo);
+    a = -1;
+    for (b = 0; b <= g; ++b) {
+      start[b] = sc_notify_part_start (lo, hi, g, b);
+      if (b > 0 && start[b - 1] <= mpirank && mpirank < start[b]) {
+        a = b - 1;
+      }
+      first[b] = b == 0 ? 0 : sc_notify_record_lower (cur, first[b - 1],
+                                                      start[b]);
+    }
+    SC_ASSERT (0 <= a && a < g);
+    SC_ASSERT (first[g] == cur->elem_count);
+    j = mpirank - start[a];
+
+    /* send the records of every other part to the same position in it */
+    for (b = 0; b < g; ++b) {
+      if (b == a) {
+        requests[b] = MPI_REQUEST_NULL;
+        continue;
+      }
+      mpiret = MPI_Isend (first[b] < cur->elem_count ?
+                          sc_array_index (cur, first[b]) : NULL,
+                          (int) (first[b + 1] - first[b]), MPI_INT,
+                          start[b] + j % (start[b + 1] - start[b]), tag,
+                          mpicomm, requests + b);
+      SC_CHECK_MPI (mpiret);
+    }
+
+    /* receive from the processes of other parts that map to me */
+    sc_array_init_view (&local, cur, first[a], first[a + 1] - first[a]);
+    temp = &local;
+    for (b = 0; b < g; ++b) {
+      if (b == a) {
+        continue;
+      }
+      for (t = j; t < start[b + 1] - start[b]; t += start[a + 1] - start[a]) {
+        source = start[b] + t;
+        mpiret = MPI_Probe (source, tag, mpicomm, &status);
+        SC_CHECK_MPI (mpiret);
+        mpiret = MPI_Get_count (&status, MPI_INT, &count);
+        SC_CHECK_MPI (mpiret);
+        sc_array_resize (recvbuf, (size_t) count);
+        mpiret = MPI_Recv (recvbuf->array, count, MPI_INT, source, tag,
+                           mpicomm, MPI_STATUS_IGNORE);
+        SC_CHECK_MPI (mpiret);
+
+        /* merge into the buffer that is not the current input */
+        sc_array_truncate (out);
+        sc_notify_merge (out, temp, recvbuf);
+        temp = out;
+        out = acc;
+        acc = temp;
+      }
+    }
+    if (temp == &local) {
+      sc_array_truncate (acc);
+      sc_array_copy (acc, &local);
+    }
+
+    mpiret = MPI_Waitall (g, requests, MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
+
+    /* the merged records become the input of the next level */
+    temp = cur;
+    cur = acc;
+    acc = temp;
+    lo = start[a];
+    hi = start[a + 1];
+  }
+
+  *num_senders = 0;
+  if (cur->elem_count > 0) {
+    pint = (int *) sc_array_index (cur, 0);
+    SC_ASSERT (pint[0] == mpirank);
+    SC_ASSERT (cur->elem_count == 2 + (size_t) pint[1]);
+    *num_senders = pint[1];
+    memcpy (senders, pint + 2, pint[1] * sizeof (int));
+  }
+  for (i = 0; i < 4; ++i) {
+    sc_array_reset (arrays + i);
+  }
+
+  return MPI_SUCCESS;
+}
+
+/* the NBX algorithm needs MPI_Ibarrier, new in MPI 3 */
+#if defined SC_MPI && MPI_VERSION >= 3 && !defined SC_NOTIFY_NO_NBX
+#define SC_NOTIFY_NBX
+#endif
+
+/** A message received by sc_notify_exchange. */
+typedef struct sc_notify_message
+{
+  int                 sender;
+  size_t              bytes;
+  char               *buffer;   /**< The size header and the payload. */
+}
+sc_notify_message_t;
+
+static int
+sc_notify_message_compare (const void *v1, const void *v2)
+{
+  return sc_int_compare (&((const sc_notify_message_t *) v1)->sender,
+                         &((const sc_notify_message_t *) v2)->sender);
+}
+
+/** Add a message whose payload is to be stored after a size header. */
+static sc_notify_message_t *
+sc_notify_message_push (sc_array_t * messages, int sender, size_t bytes)
+{
+  sc_notify_message_t *msg;
+
+  msg = (sc_notify_message_t *) sc_array_push (messages);
+  msg->sender = sender;
+  msg->bytes = bytes;
+  msg->buffer = SC_ALLOC (char, sizeof (size_t) + bytes);
+  memcpy (msg->buffer, &bytes, sizeof (size_t));
+
+  return msg;
+}
+
+#ifdef SC_NOTIFY_NBX
+
+/** Exchange the messages by the NBX algorithm of Hoefler et al.
+ * Synchronous sends complete once they are matched by a receive.  When
+ * all sends of a process are complete, it enters a nonblocking barrier,
+ * and the exchange is over once the barrier completes.  Messages up to
+ * SC_NOTIFY_EAGER_BYTES carry their payload after the size header.
+ * Larger payloads follow with a second tag as soon as the header is in.
+ */
+static void
+sc_notify_exchange_nbx (int *receivers, int num_receivers,
+                        void **sendbufs, size_t *sendbytes,
+                        sc_array_t * messages, MPI_Comm mpicomm)
+{
+  int                 mpiret;
+  int                 mpirank;
+  int                 i, count;
+  int                 header_tag, payload_tag;
+  int                 flag, barrier_active, done;
+  size_t              bytes, eager_bytes;
+  char              **headers;
+  sc_array_t          sends, recvs;
+  sc_notify_message_t *msg;
+  MPI_Request         barrier;
+  MPI_Status          status;
+
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+  header_tag = sc_coll_next_tag (mpicomm);
+  payload_tag = sc_coll_next_tag (mpicomm);
+
+  /* post a synchronous send to every receiver */
+  sc_array_init (&sends, sizeof (MPI_Request));
+  sc_array_init (&recvs, sizeof (MPI_Request));
+  headers = SC_ALLOC (char *, num_receivers);
+  for (i = 0; i < num_receivers; ++i) {
+    headers[i] = NULL;
+    bytes = sendbytes[i];
+    if (receivers[i] == mpirank) {
+      msg = sc_notify_message_push (messages, mpirank, bytes);
+      memcpy (msg->buffer + sizeof (size_t), sendbufs[i], bytes);
+      continue;
+    }
+    SC_CHECK_ABORT (bytes <= (size_t) INT_MAX, "Message too large");
+    eager_bytes = bytes <= SC_NOTIFY_EAGER_BYTES ? bytes : 0;
+    headers[i] = SC_ALLOC (char, sizeof (size_t) + eager_bytes);
+    memcpy (headers[i], &bytes, sizeof (size_t));
+    memcpy (headers[i] + sizeof (size_t), sendbufs[i], eager_bytes);
+    mpiret = MPI_Issend (headers[i], (int) (sizeof (size_t) + eager_bytes),
+                         MPI_BYTE, receivers[i], header_tag, mpicomm,
+                         (MPI_Request *) sc_array_push (&sends));
+    SC_CHECK_MPI (mpiret);
+    if (bytes > SC_NOTIFY_EAGER_BYTES) {
+      mpiret = MPI_Isend (sendbufs[i], (int) bytes, MPI_BYTE, receivers[i],
+                          payload_tag, mpicomm,
+                          (MPI_Request *) sc_array_push (&sends));
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+
+  /* receive until all processes have seen their sends matched */
+  barrier_active = done = 0;
+  while (!done) {
+    mpiret = MPI_Iprobe (MPI_ANY_SOURCE, header_tag, mpicomm, &flag,
+                         &status);
+    SC_CHECK_MPI (mpiret);
+    if (flag) {
+      mpiret = MPI_Get_count (&status, MPI_BYTE, &count);
+      SC_CHECK_MPI (mpiret);
+      SC_ASSERT (count >= (int) sizeof (size_t));
+      msg = sc_notify_message_push (messages, status.MPI_SOURCE,
+                                    count - sizeof (size_t));
+      mpiret = MPI_Recv (msg->buffer, count, MPI_BYTE, status.MPI_SOURCE,
+                         header_tag, mpicomm, MPI_STATUS_IGNORE);
+      SC_CHECK_MPI (mpiret);
+      memcpy (&bytes, msg->buffer, sizeof (size_t));
+      if (bytes != msg->bytes) {
+        /* the header announces a payload with a tag of its own */
+        msg->bytes = bytes;
+        msg->buffer = SC_REALLOC (msg->buffer, char,
+                                  sizeof (size_t) + bytes);
+        mpiret = MPI_Irecv (msg->buffer + sizeof (size_t), (int) bytes,
+                            MPI_BYTE, status.MPI_SOURCE, payload_tag,
+                            mpicomm, (MPI_Request *) sc_array_push (&recvs));
+        SC_CHECK_MPI (mpiret);
+      }
+    }
+    if (barrier_active) {
+      mpiret = MPI_Test (&barrier, &done, MPI_STATUS_IGNORE);
+      SC_CHECK_MPI (mpiret);
+    }
+    else {
+      mpiret = MPI_Testall ((int) sends.elem_count,
+                            (MPI_Request *) sends.array, &flag,
+                            MPI_STATUSES_IGNORE);
+      SC_CHECK_MPI (mpiret);
+      if (flag) {
+        mpiret = MPI_Ibarrier (mpicomm, &barrier);
+        SC_CHECK_MPI (mpiret);
+        barrier_active = 1;
+      }
+    }
+  }
+
+  /* the payloads may still be in flight */
+  mpiret = MPI_Waitall ((int) recvs.elem_count,
+                        (MPI_Request *) recvs.array, MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  for (i = 0; i < num_receivers; ++i) {
+    SC_FREE (headers[i]);
+  }
+  SC_FREE (headers);
+  sc_array_reset (&sends);
+  sc_array_reset (&recvs);
+}
+
+#else
+
+/** Exchange the messages after determining the senders by sc_notify.
+ * The sizes are sent in one round and the payloads in a second one.
+ */
+static void
+sc_notify_exchange_p2p (int *receivers, int num_receivers,
+                        void **sendbufs, size_t *sendbytes,
+                        sc_array_t * messages, MPI_Comm mpicomm)
+{
+  int                 mpiret;
+  int                 mpisize, mpirank;
+  int                 i, num_senders;
+  int                 size_tag, payload_tag;
+  int                *sorted, *senders;
+  size_t             *recvbytes;
+  sc_array_t          requests;
+  sc_notify_message_t *msg;
+
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+  size_tag = sc_coll_next_tag (mpicomm);
+  payload_tag = sc_coll_next_tag (mpicomm);
+
+  sorted = SC_ALLOC (int, num_receivers);
+  memcpy (sorted, receivers, num_receivers * sizeof (int));
+  qsort (sorted, num_receivers, sizeof (int), sc_int_compare);
+  senders = SC_ALLOC (int, mpisize);
+  mpiret = sc_notify (sorted, num_receivers, senders, &num_senders,
+                      mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_FREE (sorted);
+
+  /* exchange the sizes of the messages */
+  sc_array_init (&requests, sizeof (MPI_Request));
+  recvbytes = SC_ALLOC (size_t, num_senders);
+  for (i = 0; i < num_senders; ++i) {
+    if (senders[i] != mpirank) {
+      mpiret = MPI_Irecv (recvbytes + i, (int) sizeof (size_t), MPI_BYTE,
+                          senders[i], size_tag, mpicomm,
+                          (MPI_Request *) sc_array_push (&requests));
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  for (i = 0; i < num_receivers; ++i) {
+    if (receivers[i] != mpirank) {
+      SC_CHECK_ABORT (sendbytes[i] <= (size_t) INT_MAX, "Message too large");
+      mpiret = MPI_Isend (sendbytes + i, (int) sizeof (size_t), MPI_BYTE,
+                          receivers[i], size_tag, mpicomm,
+                          (MPI_Request *) sc_array_push (&requests));
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  mpiret = MPI_Waitall ((int) requests.elem_count,
+                        (MPI_Request *) requests.array, MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  sc_array_resize (&requests, 0);
+
+  /* exchange the payloads */
+  for (i = 0; i < num_receivers; ++i) {
+    if (receivers[i] == mpirank) {
+      msg = sc_notify_message_push (messages, mpirank, sendbytes[i]);
+      memcpy (msg->buffer + sizeof (size_t), sendbufs[i], sendbytes[i]);
+    }
+    else {
+      mpiret = MPI_Isend (sendbufs[i], (int) sendbytes[i], MPI_BYTE,
+                          receivers[i], payload_tag, mpicomm,
+                          (MPI_Request *) sc_array_push (&requests));
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  for (i = 0; i < num_senders; ++i) {
+    if (senders[i] != mpirank) {
+      msg = sc_notify_message_push (messages, senders[i], recvbytes[i]);
+      mpiret = MPI_Irecv (msg->buffer + sizeof (size_t), (int) msg->bytes,
+                          MPI_BYTE, senders[i], payload_tag, mpicomm,
+                          (MPI_Request *) sc_array_push (&requests));
+      SC_CHECK_MPI (mpiret);
+    }
+  }
+  mpiret = MPI_Waitall ((int) requests.elem_count,
+                        (MPI_Request *) requests.array, MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+
+  sc_array_reset (&requests);
+  SC_FREE (recvbytes);
+  SC_FREE (senders);
+}
+
+#endif /* SC_NOTIFY_NBX */
+
+int
+sc_notify_exchange (int *receivers, int num_receivers,
+                    void **sendbufs, size_t *sendbytes,
+                    sc_array_t * senders, sc_array_t * offsets,
+                    sc_array_t * payload, MPI_Comm mpicomm)
+{
+  size_t              zz, offset;
+  sc_array_t          messages;
+  sc_notify_message_t *msg;
+
+  SC_ASSERT (num_receivers >= 0);
+  SC_ASSERT (senders != NULL && senders->elem_size == sizeof (int));
+  SC_ASSERT (offsets != NULL && offsets->elem_size == sizeof (size_t));
+  SC_ASSERT (payload != NULL && payload->elem_size == 1);
+
+  sc_array_init (&messages, sizeof (sc_notify_message_t));
+#ifdef SC_NOTIFY_NBX
+  sc_notify_exchange_nbx (receivers, num_receivers, sendbufs, sendbytes,
+                          &messages, mpicomm);
+#else
+  sc_notify_exchange_p2p (receivers, num_receivers, sendbufs, sendbytes,
+                          &messages, mpicomm);
+#endif
+
+  /* concatenate the messages in the order of the senders */
+  sc_array_sort (&messages, sc_notify_message_compare);
+  sc_array_resize (senders, messages.elem_count);
+  sc_array_resize (offsets, messages.elem_count + 1);
+  offset = 0;
+  for (zz = 0; zz < messages.elem_count; ++zz) {
+    msg = (sc_notify_message_t *) sc_array_index (&messages, zz);
+    *(int *) sc_array_index (senders, zz) = msg->sender;
+    *(size_t *) sc_array_index (offsets, zz) = offset;
+    offset += msg->bytes;
+  }
+  *(size_t *) sc_array_index (offsets, messages.elem_count) = offset;
+  sc_array_resize (payload, offset);
+  for (zz = 0; zz < messages.elem_count; ++zz) {
+    msg = (sc_notify_message_t *) sc_array_index (&messages, zz);
+    if (msg->bytes > 0) {
+      memcpy (sc_array_index (payload,
+                              *(size_t *) sc_array_index (offsets, zz)),
+              msg->buffer + sizeof (size_t), msg->bytes);
+    }
+    SC_FREE (msg->buffer);
+  }
+  sc_array_reset (&messages);
+
+  return MPI_SUCCESS;
+}
+
+sc_notify_pattern_t *
+sc_notify_pattern_new (MPI_Comm mpicomm)
+{
+  sc_notify_pattern_t *pattern;
+
+  pattern = SC_ALLOC (sc_notify_pattern_t, 1);
+  pattern->mpicomm = mpicomm;
+  pattern->valid = 0;
+  pattern->num_notify = 0;
+  pattern->receivers = sc_array_new (sizeof (int));
+  pattern->senders = sc_array_new (sizeof (int));
+
+  return pattern;
+}
+
+void
+sc_notify_pattern_destroy (sc_notify_pattern_t * pattern)
+{
+  sc_array_destroy (pattern->receivers);
+  sc_array_destroy (pattern->senders);
+  SC_FREE (pattern);
+}
+
+int
+sc_notify_pattern (sc_notify_pattern_t * pattern,
+                   int *receivers, int num_receivers,
+                   int *senders, int *num_senders)
+{
+  int                 mpiret;
+  int                 changed, any_changed;
+
+  SC_ASSERT (num_receivers >= 0);
+  SC_ASSERT (senders != NULL && num_senders != NULL);
+
+  /* the processes agree on a change of any receiver list */
+  changed = !pattern->valid ||
+    pattern->receivers->elem_count != (size_t) num_receivers ||
+    (num_receivers > 0 && memcmp (pattern->receivers->array, receivers,
+                                  num_receivers * sizeof (int)));
+  mpiret = sc_allreduce (&changed, &any_changed, 1, MPI_INT, MPI_MAX,
+                         pattern->mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  if (any_changed) {
+    mpiret = sc_notify (receivers, num_receivers, senders, num_senders,
+                        pattern->mpicomm);
+    SC_CHECK_MPI (mpiret);
+    sc_array_resize (pattern->receivers, (size_t) num_receivers);
+    memcpy (pattern->receivers->array, receivers,
+            num_receivers * sizeof (int));
+    sc_array_resize (pattern->senders, (size_t) *num_senders);
+    memcpy (pattern->senders->array, senders, *num_senders * sizeof (int));
+    pattern->valid = 1;
+    ++pattern->num_notify;
+  }
+  else {
+    *num_senders = (int) pattern->senders->elem_count;
+    memcpy (senders, pattern->senders->array, *num_senders * sizeof (int));
+  }
+
+  return MPI_SUCCESS;
+}
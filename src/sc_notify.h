@@ -23,7 +23,15 @@
 #ifndef SC_NOTIFY_H
 #define SC_NOTIFY_H
 
-#include <sc.h>
+#include <sc_containers.h>
+
+/* sc_notify_exchange sends larger messages after their size */
+#ifndef SC_NOTIFY_EAGER_BYTES
+#define SC_NOTIFY_EAGER_BYTES           (1 << 12)
+#endif
+
+/* the largest radix accepted by sc_notify_radix */
+#define SC_NOTIFY_MAX_RADIX             64
 
 SC_EXTERN_C_BEGIN;
 
@@ -55,6 +63,90 @@ int                 sc_notify (int *receivers, int num_receivers,
                                int *senders, int *num_senders,
                                MPI_Comm mpicomm);
 
+/** Collective call to notify a set of receiver ranks of current rank.
+ * The ranks are split into radix contiguous parts of almost equal size,
+ * and every process sends the records for each other part to one of
+ * its processes.  This is repeated within the own part, such that
+ * ceil (log_radix (P)) rounds of radix - 1 messages each are needed.
+ * The number of processes P need not be a power of the radix.
+ * \param [in] receivers        Sorted and unique array of MPI ranks to inform.
+ * \param [in] num_receivers    Count of ranks contained in receivers.
+ * \param [in,out] senders      Array of at least size MPI_Comm_size.
+ *                              On output it contains the notifying ranks.
+ * \param [out] num_senders     On output the number of notifying ranks.
+ * \param [in] radix            Between 2 and SC_NOTIFY_MAX_RADIX.
+ * \param [in] mpicomm          MPI communicator to use.
+ * \return                      Aborts on MPI error or returns MPI_SUCCESS.
+ */
+int                 sc_notify_radix (int *receivers, int num_receivers,
+                                     int *senders, int *num_senders,
+                                     int radix, MPI_Comm mpicomm);
+
+/** Collective call to send messages to a set of receivers and receive
+ * the messages of all processes that send to the current rank.
+ * With MPI 3 this is done by the NBX algorithm in a single round of
+ * synchronous sends and a nonblocking barrier, where messages above
+ * SC_NOTIFY_EAGER_BYTES follow their size header right away.
+ * Otherwise the senders are found by sc_notify first.
+ * \param [in] receivers        Unique array of MPI ranks in any order.
+ * \param [in] num_receivers    Count of ranks contained in receivers.
+ * \param [in] sendbufs         For each receiver the message to send.
+ * \param [in] sendbytes        For each receiver the size of the message.
+ * \param [in,out] senders      Array of int, resized to the ranks that
+ *                              sent to this rank in ascending order.
+ * \param [in,out] offsets      Array of size_t, resized to one more than
+ *                              senders.  The message of senders[i] lies
+ *                              between offsets[i] and offsets[i + 1].
+ * \param [in,out] payload      Array of element size 1, resized to the
+ *                              concatenation of the received messages.
+ * \param [in] mpicomm          MPI communicator to use.
+ * \return                      Aborts on MPI error or returns MPI_SUCCESS.
+ */
+int                 sc_notify_exchange (int *receivers, int num_receivers,
+                                        void **sendbufs, size_t *sendbytes,
+                                        sc_array_t * senders,
+                                        sc_array_t * offsets,
+                                        sc_array_t * payload,
+                                        MPI_Comm mpicomm);
+
+/** A communication pattern remembered between calls to sc_notify.
+ * The members are private.
+ */
+typedef struct sc_notify_pattern
+{
+  MPI_Comm            mpicomm;
+  int                 valid;            /**< True after the first call. */
+  long                num_notify;       /**< Calls that ran sc_notify. */
+  sc_array_t         *receivers;        /**< Receivers of the last call. */
+  sc_array_t         *senders;          /**< The senders found for them. */
+}
+sc_notify_pattern_t;
+
+/** Create an empty communication pattern.
+ * \param [in] mpicomm      MPI communicator of all later calls.
+ */
+sc_notify_pattern_t *sc_notify_pattern_new (MPI_Comm mpicomm);
+
+/** Free a communication pattern. */
+void                sc_notify_pattern_destroy (sc_notify_pattern_t *
+                                               pattern);
+
+/** Collective replacement of sc_notify that reuses the last result.
+ * Each process compares its receivers with those of the previous call,
+ * and one allreduce of a single integer tells whether any process has
+ * new receivers.  Only then sc_notify is run and its result stored.
+ * \param [in,out] pattern      Pattern shared by a sequence of calls.
+ * \param [in] receivers        Sorted and unique array of MPI ranks.
+ * \param [in] num_receivers    Count of ranks contained in receivers.
+ * \param [in,out] senders      Array of at least size MPI_Comm_size.
+ *                              On output it contains the notifying ranks.
+ * \param [out] num_senders     On output the number of notifying ranks.
+ * \return                      Aborts on MPI error or returns MPI_SUCCESS.
+ */
+int                 sc_notify_pattern (sc_notify_pattern_t * pattern,
+                                       int *receivers, int num_receivers,
+                                       int *senders, int *num_senders);
+
 SC_EXTERN_C_END;
 
 #endif /* !SC_NOTIFY_H */
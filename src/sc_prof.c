@@ -0,0 +1,367 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_prof.h>
+#include <sc_containers.h>
+#include <sc_statistics.h>
+
+#ifdef SC_HAVE_TIME_H
+#include <time.h>
+#endif
+#ifdef SC_HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+/* the regions form a tree rooted at region 0 */
+typedef struct sc_prof_region
+{
+  char               *name;
+  int                 parent;
+  int                 first_child, next_sibling;
+  long                calls;
+  uint64_t            start, total;     /* nanoseconds */
+}
+sc_prof_region_t;
+
+/* a region identified by the names of all enclosing regions */
+typedef struct sc_prof_path
+{
+  char               *path;
+  int                 region;
+}
+sc_prof_path_t;
+
+static MPI_Comm     sc_prof_mpicomm = MPI_COMM_NULL;
+static sc_array_t  *sc_prof_regions = NULL;
+static int          sc_prof_current = -1;
+
+static              uint64_t
+sc_prof_time (void)
+{
+#ifdef SC_HAVE_CLOCK_GETTIME
+  struct timespec     ts;
+
+  (void) clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+#else
+  struct timeval      tv;
+
+  (void) gettimeofday (&tv, NULL);
+  return (uint64_t) tv.tv_sec * 1000000000 + (uint64_t) tv.tv_usec * 1000;
+#endif
+}
+
+static sc_prof_region_t *
+sc_prof_region (int r)
+{
+  return (sc_prof_region_t *) sc_array_index_int (sc_prof_regions, r);
+}
+
+static int
+sc_prof_region_new (const char *name, int parent)
+{
+  int                 r;
+  sc_prof_region_t   *region, *p;
+
+  r = (int) sc_prof_regions->elem_count;
+  region = (sc_prof_region_t *) sc_array_push (sc_prof_regions);
+  region->name = SC_STRDUP (name);
+  region->parent = parent;
+  region->first_child = region->next_sibling = -1;
+  region->calls = 0;
+  region->start = region->total = 0;
+
+  if (parent >= 0) {
+    p = sc_prof_region (parent);
+    region->next_sibling = p->first_child;
+    p->first_child = r;
+  }
+  return r;
+}
+
+/** Compare paths such that every region precedes its subregions. */
+static int
+sc_prof_path_compare (const void *v1, const void *v2)
+{
+  const char         *s1 = ((const sc_prof_path_t *) v1)->path;
+  const char         *s2 = ((const sc_prof_path_t *) v2)->path;
+  int                 c1, c2;
+
+  for (;; ++s1, ++s2) {
+    c1 = *s1 == '/' ? 1 : (int) (unsigned char) *s1;
+    c2 = *s2 == '/' ? 1 : (int) (unsigned char) *s2;
+    if (c1 != c2 || c1 == 0) {
+      return c1 - c2;
+    }
+  }
+}
+
+void
+sc_prof_init (MPI_Comm mpicomm)
+{
+  SC_ASSERT (sc_prof_regions == NULL);
+
+  sc_prof_mpicomm = mpicomm;
+  sc_prof_regions = sc_array_new (sizeof (sc_prof_region_t));
+  sc_prof_current = sc_prof_region_new ("", -1);
+  sc_prof_region (sc_prof_current)->start = sc_prof_time ();
+}
+
+void
+sc_prof_begin (const char *name)
+{
+  int                 r;
+  sc_prof_region_t   *region;
+
+  SC_ASSERT (sc_prof_regions != NULL);
+  SC_ASSERT (strchr (name, '/') == NULL);
+
+  for (r = sc_prof_region (sc_prof_current)->first_child; r >= 0;
+       r = region->next_sibling) {
+    region = sc_prof_region (r);
+    if (!strcmp (region->name, name)) {
+      break;
+    }
+  }
+  if (r < 0) {
+    r = sc_prof_region_new (name, sc_prof_current);
+  }
+  sc_prof_current = r;
+
+  /* take the time last to exclude the lookup */
+  sc_prof_region (r)->start = sc_prof_time ();
+}
+
+void
+sc_prof_end (void)
+{
+  const uint64_t      now = sc_prof_time ();
+  sc_prof_region_t   *region;
+
+  SC_ASSERT (sc_prof_regions != NULL);
+  region = sc_prof_region (sc_prof_current);
+  SC_CHECK_ABORT (region->parent >= 0, "No open profiler region");
+
+  region->total += now - region->start;
+  ++region->calls;
+  sc_prof_current = region->parent;
+}
+
+/** Gather the paths of all regions on all processes.
+ * \param [in] local    Sorted local paths.
+ * \param [out] global  Sorted unique paths of all processes.
+ * \return              Buffer holding the global path strings.
+ */
+static char        *
+sc_prof_gather_paths (sc_array_t * local, sc_array_t * global)
+{
+  int                 mpiret;
+  int                 num_procs, q;
+  int                 local_bytes, total_bytes;
+  int                *recvcounts, *displs;
+  size_t              zz, len;
+  char               *sendbuf, *recvbuf, *pos;
+  sc_prof_path_t     *lp, *gp;
+
+  mpiret = MPI_Comm_size (sc_prof_mpicomm, &num_procs);
+  SC_CHECK_MPI (mpiret);
+
+  local_bytes = 0;
+  for (zz = 0; zz < local->elem_count; ++zz) {
+    lp = (sc_prof_path_t *) sc_array_index (local, zz);
+    local_bytes += (int) strlen (lp->path) + 1;
+  }
+  sendbuf = pos = SC_ALLOC (char, local_bytes + 1);
+  for (zz = 0; zz < local->elem_count; ++zz) {
+    lp = (sc_prof_path_t *) sc_array_index (local, zz);
+    len = strlen (lp->path) + 1;
+    memcpy (pos, lp->path, len);
+    pos += len;
+  }
+
+  recvcounts = SC_ALLOC (int, num_procs);
+  displs = SC_ALLOC (int, num_procs);
+  mpiret = MPI_Allgather (&local_bytes, 1, MPI_INT,
+                          recvcounts, 1, MPI_INT, sc_prof_mpicomm);
+  SC_CHECK_MPI (mpiret);
+  total_bytes = 0;
+  for (q = 0; q < num_procs; ++q) {
+    displs[q] = total_bytes;
+    total_bytes += recvcounts[q];
+  }
+  recvbuf = SC_ALLOC (char, total_bytes + 1);
+  mpiret = MPI_Allgatherv (sendbuf, local_bytes, MPI_CHAR,
+                           recvbuf, recvcounts, displs, MPI_CHAR,
+                           sc_prof_mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_FREE (sendbuf);
+  SC_FREE (recvcounts);
+  SC_FREE (displs);
+
+  for (pos = recvbuf; pos < recvbuf + total_bytes; pos += strlen (pos) + 1) {
+    gp = (sc_prof_path_t *) sc_array_push (global);
+    gp->path = pos;
+    gp->region = -1;
+  }
+  sc_array_sort (global, sc_prof_path_compare);
+  sc_array_uniq (global, sc_prof_path_compare);
+
+  return recvbuf;
+}
+
+void
+sc_prof_report (int package_id, int log_priority)
+{
+  int                 r, num_regions, depth;
+  size_t              zz, num_global;
+  ssize_t             found;
+  char               *recvbuf, *s;
+  double              self;
+  const char         *name;
+  sc_array_t         *local, *global;
+  sc_prof_path_t     *lp, *gp;
+  sc_prof_region_t   *region, *child;
+  sc_statinfo_t      *stats, *si;
+
+  SC_ASSERT (sc_prof_regions != NULL);
+
+  /* construct the path of every local region that has been closed */
+  num_regions = (int) sc_prof_regions->elem_count;
+  local = sc_array_new_size (sizeof (sc_prof_path_t), num_regions);
+  lp = (sc_prof_path_t *) sc_array_index (local, 0);
+  lp->path = SC_STRDUP ("");
+  lp->region = 0;
+  for (r = 1; r < num_regions; ++r) {
+    region = sc_prof_region (r);
+    name = ((sc_prof_path_t *) sc_array_index_int (local, region->parent))
+      ->path;
+    lp = (sc_prof_path_t *) sc_array_index_int (local, r);
+    lp->path = SC_ALLOC (char, strlen (name) + strlen (region->name) + 2);
+    sprintf (lp->path, "%s%s%s", name, *name ? "/" : "", region->name);
+    lp->region = r;
+  }
+
+  /* remove the root and the regions that have never been closed */
+  for (r = 0, zz = 0; r < num_regions; ++r) {
+    lp = (sc_prof_path_t *) sc_array_index_int (local, r);
+    if (r > 0 && sc_prof_region (r)->calls > 0) {
+      *(sc_prof_path_t *) sc_array_index (local, zz++) = *lp;
+    }
+    else {
+      SC_FREE (lp->path);
+    }
+  }
+  sc_array_resize (local, zz);
+  sc_array_sort (local, sc_prof_path_compare);
+
+  global = sc_array_new (sizeof (sc_prof_path_t));
+  recvbuf = sc_prof_gather_paths (local, global);
+  num_global = global->elem_count;
+
+  /* inclusive time, exclusive time and calls of each region */
+  stats = SC_ALLOC (sc_statinfo_t, 3 * num_global + 1);
+  region = sc_prof_region (0);
+  sc_stats_set1 (&stats[0], (sc_prof_time () - region->start) * 1.e-9,
+                 "Total");
+  for (zz = 0; zz < num_global; ++zz) {
+    gp = (sc_prof_path_t *) sc_array_index (global, zz);
+    si = &stats[1 + 3 * zz];
+    found = sc_array_bsearch (local, gp, sc_prof_path_compare);
+    if (found < 0) {
+      sc_stats_init (&si[0], gp->path);
+      sc_stats_init (&si[1], gp->path);
+      sc_stats_init (&si[2], gp->path);
+      continue;
+    }
+    lp = (sc_prof_path_t *) sc_array_index (local, (size_t) found);
+    region = sc_prof_region (lp->region);
+    self = (double) region->total;
+    for (r = region->first_child; r >= 0; r = child->next_sibling) {
+      child = sc_prof_region (r);
+      self -= (double) child->total;
+    }
+    sc_stats_set1 (&si[0], region->total * 1.e-9, gp->path);
+    sc_stats_set1 (&si[1], self * 1.e-9, gp->path);
+    sc_stats_set1 (&si[2], (double) region->calls, gp->path);
+  }
+  sc_stats_compute (sc_prof_mpicomm, (int) (3 * num_global + 1), stats);
+
+  SC_GEN_LOGF (package_id, SC_LC_GLOBAL, log_priority,
+               "Profile of %lld regions in %g seconds\n",
+               (long long) num_global, stats[0].max);
+  SC_GEN_LOGF (package_id, SC_LC_GLOBAL, log_priority,
+               "%-32s %5s %9s %10s %10s %10s %7s %10s\n", "Region", "Procs",
+               "Calls", "Min", "Avg", "Max", "Max/Avg", "Self avg");
+  for (zz = 0; zz < num_global; ++zz) {
+    gp = (sc_prof_path_t *) sc_array_index (global, zz);
+    si = &stats[1 + 3 * zz];
+
+    /* indent the name of the region by its depth */
+    depth = 0;
+    name = gp->path;
+    for (s = gp->path; *s != '\0'; ++s) {
+      if (*s == '/') {
+        ++depth;
+        name = s + 1;
+      }
+    }
+    depth = SC_MIN (depth, 8);
+    SC_GEN_LOGF (package_id, SC_LC_GLOBAL, log_priority,
+                 "%*s%-*s %5ld %9.0f %10.4g %10.4g %10.4g %7.3f %10.4g\n",
+                 2 * depth, "", 32 - 2 * depth, name, si[0].count,
+                 si[2].average, si[0].min, si[0].average, si[0].max,
+                 si[0].average > 0. ? si[0].max / si[0].average : 1.,
+                 si[1].average);
+  }
+
+  SC_FREE (stats);
+  SC_FREE (recvbuf);
+  sc_array_destroy (global);
+  for (zz = 0; zz < local->elem_count; ++zz) {
+    lp = (sc_prof_path_t *) sc_array_index (local, zz);
+    SC_FREE (lp->path);
+  }
+  sc_array_destroy (local);
+}
+
+void
+sc_prof_finalize (int package_id, int log_priority)
+{
+  size_t              zz;
+  sc_prof_region_t   *region;
+
+  SC_ASSERT (sc_prof_regions != NULL);
+  SC_CHECK_ABORT (sc_prof_current == 0, "Open profiler regions");
+
+  if (log_priority != SC_LP_SILENT) {
+    sc_prof_report (package_id, log_priority);
+  }
+
+  for (zz = 0; zz < sc_prof_regions->elem_count; ++zz) {
+    region = (sc_prof_region_t *) sc_array_index (sc_prof_regions, zz);
+    SC_FREE (region->name);
+  }
+  sc_array_destroy (sc_prof_regions);
+  sc_prof_regions = NULL;
+  sc_prof_current = -1;
+  sc_prof_mpicomm = MPI_COMM_NULL;
+}
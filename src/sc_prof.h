@@ -0,0 +1,75 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+/* A hierarchical region profiler.
+ *
+ * Regions are opened with sc_prof_begin and closed with sc_prof_end.
+ * They may be nested; a region is identified by the names of all
+ * enclosing regions, such that the same name opened in different
+ * contexts is timed separately.  Each region records its number of
+ * calls and the time spent inside it, including and excluding the
+ * time of its subregions.  sc_prof_report combines the regions of all
+ * processes with sc_stats_compute and prints minimum, average and
+ * maximum over the processes together with the load imbalance.
+ */
+
+#ifndef SC_PROF_H
+#define SC_PROF_H
+
+#include <sc.h>
+
+SC_EXTERN_C_BEGIN;
+
+/** Start the profiler.  The profiler is not thread-safe.
+ * \param [in] mpicomm      Communicator used by sc_prof_report.
+ */
+void                sc_prof_init (MPI_Comm mpicomm);
+
+/** Open a region nested into the currently open region.
+ * \param [in] name     Name of the region, copied internally.
+ *                      Must not contain the character '/'.
+ */
+void                sc_prof_begin (const char *name);
+
+/** Close the region opened most recently. */
+void                sc_prof_end (void);
+
+/** Collectively compute and print statistics of all regions.
+ * The regions need not be the same on all processes.
+ * Regions that are still open are not included.
+ * This function uses the SC_LC_GLOBAL log category.
+ * \param [in] package_id       Registered package id or -1.
+ * \param [in] log_priority     Log priority for output according to sc.h.
+ */
+void                sc_prof_report (int package_id, int log_priority);
+
+/** Collectively print the report and free all memory of the profiler.
+ * All regions must be closed.
+ * \param [in] package_id       Registered package id or -1.
+ * \param [in] log_priority     Log priority for the report.
+ *                              SC_LP_SILENT skips the report.
+ */
+void                sc_prof_finalize (int package_id, int log_priority);
+
+SC_EXTERN_C_END;
+
+#endif /* !SC_PROF_H */
@@ -20,6 +20,7 @@
   02110-1301, USA.
 */
 
+#include <sc_notify.h>
 #include <sc_ranges.h>
 #include <sc_statistics.h>
 
@@ -28,159 +29,270 @@
 #define MPI_Allgather sc_allgather
 #endif
 
+/* the number of nonpeers in an empty range, which may contain the rank */
+#define SC_RANGES_GAP_NONPEERS(g,r) \
+  ((g)[1] - (g)[0] + 1 - ((g)[0] <= (r) && (r) <= (g)[1]))
+
+/** Return the k-th smallest entry of an array, which is reordered.
+ * This is Hoare's selection with a median of three pivot,
+ * which takes linear time in the expected case.
+ */
 static int
-sc_ranges_compare (const void *v1, const void *v2)
+sc_ranges_select (int *a, int n, int k)
 {
-  return *(int *) v1 - *(int *) v2;
+  int                 lo, hi, i, j;
+  int                 pivot, t;
+
+  SC_ASSERT (0 <= k && k < n);
+
+  lo = 0;
+  hi = n - 1;
+  while (lo < hi) {
+    /* order a[lo], a[mid], a[hi] and take the middle one as pivot */
+    i = lo + (hi - lo) / 2;
+    if (a[i] < a[lo]) {
+      t = a[i];
+      a[i] = a[lo];
+      a[lo] = t;
+    }
+    if (a[hi] < a[lo]) {
+      t = a[hi];
+      a[hi] = a[lo];
+      a[lo] = t;
+    }
+    if (a[hi] < a[i]) {
+      t = a[hi];
+      a[hi] = a[i];
+      a[i] = t;
+    }
+    pivot = a[i];
+
+    /* partition into entries <= pivot and >= pivot */
+    i = lo;
+    j = hi;
+    while (i <= j) {
+      while (a[i] < pivot) {
+        ++i;
+      }
+      while (pivot < a[j]) {
+        --j;
+      }
+      if (i <= j) {
+        t = a[i];
+        a[i] = a[j];
+        a[j] = t;
+        ++i;
+        --j;
+      }
+    }
+    if (k <= j) {
+      hi = j;
+    }
+    else if (k >= i) {
+      lo = i;
+    }
+    else {
+      break;
+    }
+  }
+  return a[k];
 }
 
-int
-sc_ranges_compute (int package_id, int num_procs, const int *procs,
-                   int rank, int first_peer, int last_peer,
-                   int num_ranges, int *ranges)
+/** Compute the ranges from the sorted peers, skipping the rank.
+ * This is the common part of sc_ranges_compute and its sparse variant.
+ * The processors between the first and the last peer are covered except
+ * for the num_ranges - 1 empty ranges between successive peers that
+ * contain the most nonpeers, which are found by selection in time linear
+ * in the number of peers.
+ * This minimizes the number of processors covered that are no peers.
+ */
+static int
+sc_ranges_compute_peers (int package_id, int num_peers, const int *peers,
+                         int rank, int num_ranges, int *ranges)
 {
-  int                 i, j;
-  int                 lastw, prev, nwin, length;
-  int                 shortest_range, shortest_length;
+  int                 i, k;
+  int                 first, last, next;
+  int                 num_gaps, keep, threshold, ties, length;
+  int                *gaps, *lengths;
 
-  SC_ASSERT (rank >= 0 && rank < num_procs);
+  SC_ASSERT (num_ranges >= 1);
 
   /* initialize ranges as empty */
-  nwin = 0;
   for (i = 0; i < num_ranges; ++i) {
     ranges[2 * i] = -1;
     ranges[2 * i + 1] = -2;
   }
 
-  /* if no peers are present there are no ranges */
-  if (first_peer > last_peer) {
-    SC_ASSERT (first_peer == num_procs && last_peer == -1);
-    return nwin;
-  }
-
-#ifdef SC_DEBUG
-  SC_ASSERT (0 <= first_peer && first_peer <= last_peer &&
-             last_peer < num_procs);
-  SC_ASSERT (first_peer != rank && last_peer != rank);
-  SC_ASSERT (procs[first_peer] && procs[last_peer]);
-  for (j = 0; j < first_peer; ++j) {
-    SC_ASSERT (j == rank || !procs[j]);
-  }
-  for (j = last_peer + 1; j < num_procs; ++j) {
-    SC_ASSERT (j == rank || !procs[j]);
-  }
-#endif
-
-  /* find a maximum of num_ranges - 1 empty ranges with (start, end) */
-  lastw = num_ranges - 1;
-  prev = -1;
-  for (j = 0; j < num_procs; ++j) {
-    if (!procs[j] || j == rank) {
+  /* collect the empty ranges between successive peers */
+  gaps = SC_ALLOC (int, 2 * SC_MAX (num_peers - 1, 0));
+  num_gaps = 0;
+  first = last = -1;
+  for (k = 0; k < num_peers; ++k) {
+    next = peers[k];
+    SC_ASSERT (k == 0 || peers[k - 1] < next);
+    if (next == rank) {
       continue;
     }
-    if (prev == -1) {
-      prev = j;
-      continue;
+    if (last == -1) {
+      first = next;
     }
-    if (prev < j - 1) {
-      length = j - 1 - prev;
+    else if (last < next - 1) {
       SC_GEN_LOGF (package_id, SC_LC_NORMAL, SC_LP_DEBUG,
                    "found empty range prev %d j %d length %d\n",
-                   prev, j, length);
-
-      /* claim unused range */
-      for (i = 0; i < num_ranges; ++i) {
-        if (ranges[2 * i] == -1) {
-          ranges[2 * i] = prev + 1;
-          ranges[2 * i + 1] = j - 1;
-          break;
-        }
-      }
-      SC_ASSERT (i < num_ranges);
-      nwin = i + 1;
-
-      /* if all ranges are used, remove the shortest */
-      if (nwin == num_ranges) {
-        nwin = lastw;
-        shortest_range = -1;
-        shortest_length = num_procs + 1;
-        for (i = 0; i < num_ranges; ++i) {
-          length = ranges[2 * i + 1] - ranges[2 * i] + 1;
-          if (length < shortest_length) {
-            shortest_range = i;
-            shortest_length = length;
-          }
-        }
-        SC_ASSERT (shortest_range >= 0 && shortest_range <= lastw);
-        if (shortest_range < lastw) {
-          ranges[2 * shortest_range] = ranges[2 * lastw];
-          ranges[2 * shortest_range + 1] = ranges[2 * lastw + 1];
-        }
-        ranges[2 * lastw] = -1;
-        ranges[2 * lastw + 1] = -2;
-      }
+                   last, next, next - 1 - last);
+      gaps[2 * num_gaps] = last + 1;
+      gaps[2 * num_gaps + 1] = next - 1;
+      ++num_gaps;
     }
-    prev = j;
+    last = next;
   }
-  SC_ASSERT (nwin >= 0 && nwin < num_ranges);
 
-  /* sort empty ranges by start rank */
-  qsort (ranges, (size_t) nwin, 2 * sizeof (int), sc_ranges_compare);
+  /* if no peers are present there are no ranges */
+  if (first == -1) {
+    SC_FREE (gaps);
+    return 0;
+  }
 
-#ifdef SC_DEBUG
-  /* check consistency of empty ranges */
-  for (i = 0; i < nwin; ++i) {
-    SC_ASSERT (ranges[2 * i] <= ranges[2 * i + 1]);
-    if (i < nwin - 1) {
-      SC_ASSERT (ranges[2 * i + 1] < ranges[2 * (i + 1)] - 1);
+  /* keep the empty ranges with the most nonpeers in their order */
+  keep = num_ranges - 1;
+  if (num_gaps > keep) {
+    threshold = INT_MAX;
+    ties = 0;
+    if (keep > 0) {
+      lengths = SC_ALLOC (int, num_gaps);
+      for (i = 0; i < num_gaps; ++i) {
+        lengths[i] = SC_RANGES_GAP_NONPEERS (gaps + 2 * i, rank);
+      }
+      threshold = sc_ranges_select (lengths, num_gaps, num_gaps - keep);
+      ties = keep;
+      for (i = 0; i < num_gaps; ++i) {
+        ties -= (lengths[i] > threshold);
+      }
+      SC_FREE (lengths);
     }
+    SC_ASSERT (ties >= 0);
+
+    /* ties are resolved in favor of the leftmost empty ranges */
+    for (i = k = 0; i < num_gaps; ++i) {
+      length = SC_RANGES_GAP_NONPEERS (gaps + 2 * i, rank);
+      if (length > threshold || (length == threshold && ties-- > 0)) {
+        gaps[2 * k] = gaps[2 * i];
+        gaps[2 * k + 1] = gaps[2 * i + 1];
+        ++k;
+      }
+    }
+    SC_ASSERT (k == keep);
+    num_gaps = keep;
   }
-  for (i = nwin; i < num_ranges; ++i) {
-    SC_ASSERT (ranges[2 * i] == -1);
-    SC_ASSERT (ranges[2 * i + 1] == -2);
-  }
-  for (i = 0; i < nwin; ++i) {
+
+#ifdef SC_DEBUG
+  for (i = 0; i < num_gaps; ++i) {
     SC_GEN_LOGF (package_id, SC_LC_NORMAL, SC_LP_DEBUG,
                  "empty range %d from %d to %d\n",
-                 i, ranges[2 * i], ranges[2 * i + 1]);
+                 i, gaps[2 * i], gaps[2 * i + 1]);
   }
 #endif
 
   /* compute real ranges from empty ranges */
-  ranges[2 * nwin + 1] = last_peer;
-  for (i = nwin; i > 0; --i) {
-    ranges[2 * i] = ranges[2 * i - 1] + 1;
-    ranges[2 * i - 1] = ranges[2 * (i - 1)] - 1;
+  ranges[0] = first;
+  for (i = 0; i < num_gaps; ++i) {
+    ranges[2 * i + 1] = gaps[2 * i] - 1;
+    ranges[2 * i + 2] = gaps[2 * i + 1] + 1;
   }
-  ranges[0] = first_peer;
-  ++nwin;
+  ranges[2 * num_gaps + 1] = last;
+  SC_FREE (gaps);
 
 #ifdef SC_DEBUG
-  for (i = 0; i < nwin; ++i) {
+  for (i = 0; i <= num_gaps; ++i) {
     SC_ASSERT (ranges[2 * i] <= ranges[2 * i + 1]);
-    if (i < nwin - 1) {
+    if (i < num_gaps) {
       SC_ASSERT (ranges[2 * i + 1] < ranges[2 * (i + 1)] - 1);
     }
   }
-  for (i = nwin; i < num_ranges; ++i) {
+  for (i = num_gaps + 1; i < num_ranges; ++i) {
     SC_ASSERT (ranges[2 * i] == -1);
     SC_ASSERT (ranges[2 * i + 1] == -2);
   }
+  for (i = 0; i <= num_gaps; ++i) {
+    SC_GEN_LOGF (package_id, SC_LC_NORMAL, SC_LP_DEBUG,
+                 "range %d from %d to %d\n", i,
+                 ranges[2 * i], ranges[2 * i + 1]);
+  }
+#endif
+
+  return num_gaps + 1;
+}
+
+int
+sc_ranges_compute (int package_id, int num_procs, const int *procs,
+                   int rank, int first_peer, int last_peer,
+                   int num_ranges, int *ranges)
+{
+  int                 j;
+  int                 nwin, num_peers;
+  int                *peers;
+#ifdef SC_DEBUG
+  int                 i;
+#endif
+
+  SC_ASSERT (rank >= 0 && rank < num_procs);
+
+#ifdef SC_DEBUG
+  if (first_peer > last_peer) {
+    SC_ASSERT (first_peer == num_procs && last_peer == -1);
+  }
+  else {
+    SC_ASSERT (0 <= first_peer && first_peer <= last_peer &&
+               last_peer < num_procs);
+    SC_ASSERT (first_peer != rank && last_peer != rank);
+    SC_ASSERT (procs[first_peer] && procs[last_peer]);
+  }
+  for (j = 0; j < first_peer; ++j) {
+    SC_ASSERT (j == rank || !procs[j]);
+  }
+  for (j = last_peer + 1; j < num_procs; ++j) {
+    SC_ASSERT (j == rank || !procs[j]);
+  }
+#endif
+
+  /* collect the peers between first and last */
+  num_peers = 0;
+  for (j = first_peer; j <= last_peer; ++j) {
+    num_peers += (procs[j] != 0);
+  }
+  peers = SC_ALLOC (int, num_peers);
+  num_peers = 0;
+  for (j = first_peer; j <= last_peer; ++j) {
+    if (procs[j]) {
+      peers[num_peers++] = j;
+    }
+  }
+
+  nwin = sc_ranges_compute_peers (package_id, num_peers, peers, rank,
+                                  num_ranges, ranges);
+  SC_FREE (peers);
+
+#ifdef SC_DEBUG
   for (i = 0; i < nwin - 1; ++i) {
     for (j = ranges[2 * i + 1] + 1; j < ranges[2 * (i + 1)]; ++j) {
       SC_ASSERT (j == rank || !procs[j]);
     }
   }
-  for (i = 0; i < nwin; ++i) {
-    SC_GEN_LOGF (package_id, SC_LC_NORMAL, SC_LP_DEBUG,
-                 "range %d from %d to %d\n", i,
-                 ranges[2 * i], ranges[2 * i + 1]);
-  }
 #endif
 
   return nwin;
 }
 
+int
+sc_ranges_compute_sparse (int package_id, int num_peers, const int *peers,
+                          int rank, int num_ranges, int *ranges)
+{
+  SC_ASSERT (num_peers >= 0 && num_ranges >= 1);
+
+  return sc_ranges_compute_peers (package_id, num_peers, peers, rank,
+                                  num_ranges, ranges);
+}
+
 int
 sc_ranges_adaptive (int package_id, MPI_Comm mpicomm,
                     const int *procs, int *inout1, int *inout2,
@@ -228,6 +340,37 @@ sc_ranges_adaptive (int package_id, MPI_Comm mpicomm,
   return nwin;
 }
 
+int
+sc_ranges_adaptive_sparse (int package_id, MPI_Comm mpicomm,
+                           int num_peers, const int *peers,
+                           int *max_peers, int *max_ranges,
+                           int num_ranges, int *ranges)
+{
+  int                 mpiret;
+  int                 k, rank;
+  int                 local[2], global[2];
+
+  mpiret = MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+
+  /* count peers and compute the local ranges */
+  local[0] = 0;
+  for (k = 0; k < num_peers; ++k) {
+    local[0] += (peers[k] != rank);
+  }
+  local[1] = sc_ranges_compute_sparse (package_id, num_peers, peers, rank,
+                                       num_ranges, ranges);
+
+  /* communicate the maximum number of peers and ranges */
+  mpiret = MPI_Allreduce (local, global, 2, MPI_INT, MPI_MAX, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  *max_peers = global[0];
+  *max_ranges = global[1];
+  SC_ASSERT (local[1] <= global[1] && global[1] <= num_ranges);
+
+  return local[1];
+}
+
 void
 sc_ranges_decode (int num_procs, int rank,
                   int max_ranges, const int *global_ranges,
@@ -308,26 +451,138 @@ sc_ranges_decode (int num_procs, int rank,
   *num_senders = ns;
 }
 
+void
+sc_ranges_decode_sparse (int num_ranges, const int *ranges,
+                         MPI_Comm mpicomm,
+                         sc_array_t * receivers, sc_array_t * senders)
+{
+  int                 mpiret;
+  int                 i, j, rank;
+  int                 num_receivers;
+  char                empty;
+  void              **sendbufs;
+  size_t             *sendbytes;
+  sc_array_t          offsets, payload;
+
+  SC_ASSERT (receivers->elem_size == sizeof (int));
+  SC_ASSERT (senders->elem_size == sizeof (int));
+
+  mpiret = MPI_Comm_rank (mpicomm, &rank);
+  SC_CHECK_MPI (mpiret);
+
+  /* identify receivers */
+  sc_array_truncate (receivers);
+  for (i = 0; i < num_ranges && ranges[2 * i] >= 0; ++i) {
+    SC_ASSERT (ranges[2 * i] <= ranges[2 * i + 1]);
+    SC_ASSERT (i == 0 || ranges[2 * (i - 1) + 1] + 1 < ranges[2 * i]);
+    for (j = ranges[2 * i]; j <= ranges[2 * i + 1]; ++j) {
+      /* exclude self */
+      if (j != rank) {
+        *(int *) sc_array_push (receivers) = j;
+      }
+    }
+  }
+  num_receivers = (int) receivers->elem_count;
+
+  /* the senders are those that have this rank in their ranges */
+  sendbufs = SC_ALLOC (void *, num_receivers);
+  sendbytes = SC_ALLOC_ZERO (size_t, num_receivers);
+  for (i = 0; i < num_receivers; ++i) {
+    sendbufs[i] = &empty;
+  }
+  sc_array_init (&offsets, sizeof (size_t));
+  sc_array_init (&payload, 1);
+  mpiret = sc_notify_exchange ((int *) receivers->array, num_receivers,
+                               sendbufs, sendbytes, senders,
+                               &offsets, &payload, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_array_reset (&offsets);
+  sc_array_reset (&payload);
+  SC_FREE (sendbufs);
+  SC_FREE (sendbytes);
+}
+
+/** Log the global statistics of nonpeers and peers covered by ranges.
+ * The over-communication ratio is the number of messages sent to all
+ * covered processors divided by the number of messages actually needed.
+ */
+static void
+sc_ranges_log_statistics (int package_id, int log_priority,
+                          MPI_Comm mpicomm, int num_ranges,
+                          int empties, int peers)
+{
+  sc_statinfo_t       si[3];
+
+  sc_stats_set1 (si + 0, (double) empties, NULL);
+  sc_stats_set1 (si + 1, (double) peers, NULL);
+  sc_stats_set1 (si + 2,
+                 peers > 0 ? (double) (empties + peers) / peers : 1., NULL);
+  sc_stats_compute (mpicomm, 3, si);
+  SC_GEN_LOGF (package_id, SC_LC_GLOBAL, log_priority,
+               "Ranges %d nonpeer %g +- %g min/max %g %g\n",
+               num_ranges, si[0].average, si[0].standev,
+               si[0].min, si[0].max);
+  SC_GEN_LOGF (package_id, SC_LC_GLOBAL, log_priority,
+               "Ranges %d overcomm %g total %g peers %g max %g\n",
+               num_ranges, si[1].sum_values > 0. ?
+               (si[0].sum_values + si[1].sum_values) / si[1].sum_values :
+               1., si[0].sum_values + si[1].sum_values, si[1].sum_values,
+               si[2].max);
+}
+
 void
 sc_ranges_statistics (int package_id, int log_priority,
                       MPI_Comm mpicomm, int num_procs, const int *procs,
                       int rank, int num_ranges, int *ranges)
 {
   int                 i, j;
-  int                 empties;
-  sc_statinfo_t       si;
+  int                 empties, peers;
 
-  empties = 0;
+  empties = peers = 0;
   for (i = 0; i < num_ranges; ++i) {
     SC_ASSERT (ranges[2 * i] >= 0 || ranges[2 * i] > ranges[2 * i + 1]);
     for (j = ranges[2 * i]; j <= ranges[2 * i + 1]; ++j) {
-      empties += (j != rank && procs[j] == 0);
+      SC_ASSERT (0 <= j && j < num_procs);
+      if (j != rank) {
+        if (procs[j] == 0) {
+          ++empties;
+        }
+        else {
+          ++peers;
+        }
+      }
     }
   }
 
-  sc_stats_set1 (&si, (double) empties, NULL);
-  sc_stats_compute (mpicomm, 1, &si);
-  SC_GEN_LOGF (package_id, SC_LC_GLOBAL, log_priority,
-               "Ranges %d nonpeer %g +- %g min/max %g %g\n",
-               num_ranges, si.average, si.standev, si.min, si.max);
+  sc_ranges_log_statistics (package_id, log_priority, mpicomm,
+                            num_ranges, empties, peers);
+}
+
+void
+sc_ranges_statistics_sparse (int package_id, int log_priority,
+                             MPI_Comm mpicomm, int num_peers,
+                             const int *peers, int rank,
+                             int num_ranges, const int *ranges)
+{
+  int                 i, k;
+  int                 covered, inside;
+
+  /* count the covered processors in linear time of peers plus ranges */
+  covered = inside = 0;
+  for (i = k = 0; i < num_ranges; ++i) {
+    if (ranges[2 * i] > ranges[2 * i + 1]) {
+      continue;
+    }
+    covered += ranges[2 * i + 1] - ranges[2 * i] + 1;
+    covered -= (ranges[2 * i] <= rank && rank <= ranges[2 * i + 1]);
+    while (k < num_peers && peers[k] < ranges[2 * i]) {
+      ++k;
+    }
+    for (; k < num_peers && peers[k] <= ranges[2 * i + 1]; ++k) {
+      inside += (peers[k] != rank);
+    }
+  }
+
+  sc_ranges_log_statistics (package_id, log_priority, mpicomm,
+                            num_ranges, covered - inside, inside);
 }
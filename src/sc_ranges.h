@@ -23,7 +23,7 @@
 #ifndef SC_RANGES_H
 #define SC_RANGES_H
 
-#include <sc.h>
+#include <sc_containers.h>
 
 SC_EXTERN_C_BEGIN;
 
@@ -49,6 +49,26 @@ int                 sc_ranges_compute (int package_id, int num_procs,
                                        int first_peer, int last_peer,
                                        int num_ranges, int *ranges);
 
+/** Compute the optimal ranges of processors from a sparse list of peers.
+ * The result is the same as that of sc_ranges_compute with procs nonzero
+ * exactly at the peers, while time and memory scale with num_peers.
+ *
+ * \param [in] package_id   Registered package id or -1.
+ * \param [in] num_peers    Number of entries in peers.
+ * \param [in] peers        Sorted and unique array of the processors
+ *                          that need to be talked to.
+ * \param [in] rank         The id of the calling process.
+ *                          Will be excluded from the ranges.
+ * \param [in] num_ranges   The maximum number of ranges to fill.
+ * \param [in,out] ranges   Array [2 * num_ranges] filled as in
+ *                          sc_ranges_compute.
+ * \return                  Returns the number of filled ranges.
+ */
+int                 sc_ranges_compute_sparse (int package_id,
+                                              int num_peers,
+                                              const int *peers, int rank,
+                                              int num_ranges, int *ranges);
+
 /** Compute the globally optimal ranges of processors.
  *
  * \param [in] package_id   Registered package id or -1.
@@ -76,6 +96,29 @@ int                 sc_ranges_adaptive (int package_id, MPI_Comm mpicomm,
                                         int num_ranges, int *ranges,
                                         int **global_ranges);
 
+/** Compute the globally optimal ranges of processors from sparse peers.
+ * Unlike sc_ranges_adaptive, no table of everybody's ranges is created;
+ * use sc_ranges_decode_sparse to find the senders instead.
+ *
+ * \param [in] package_id   Registered package id or -1.
+ * \param [in] mpicomm      MPI Communicator for Allreduce.
+ * \param [in] num_peers    Number of entries in peers.
+ * \param [in] peers        Same as in sc_ranges_compute_sparse ().
+ * \param [out] max_peers   Global maximum of peer counts.
+ * \param [out] max_ranges  Global maximum number of ranges.
+ * \param [in] num_ranges   The maximum number of ranges to fill.
+ * \param [in,out] ranges   Array [2 * num_ranges] of the local ranges
+ *                          filled as in sc_ranges_compute.
+ * \return                  Returns the number of locally filled ranges.
+ */
+int                 sc_ranges_adaptive_sparse (int package_id,
+                                               MPI_Comm mpicomm,
+                                               int num_peers,
+                                               const int *peers,
+                                               int *max_peers,
+                                               int *max_ranges,
+                                               int num_ranges, int *ranges);
+
 /** Determine an array of receivers and an array of senders from ranges.
  * This function is intended for compatibility and debugging only.
  * In particular, sc_ranges_adaptive may include non-receiving processors.
@@ -98,7 +141,32 @@ void                sc_ranges_decode (int num_procs, int rank,
                                       int *num_receivers, int *receiver_ranks,
                                       int *num_senders, int *sender_ranks);
 
+/** Collectively determine receivers and senders from the local ranges.
+ * The receivers are all processors in the ranges except this one.
+ * The senders are found by sc_notify_exchange, such that no processor
+ * needs to know the ranges of the others.  Time and memory scale with
+ * the number of processors covered by the ranges and not with mpisize.
+ *
+ * \param [in] num_ranges   Number of entries in ranges, at least the
+ *                          number of filled ranges.
+ * \param [in] ranges       The local ranges as filled by
+ *                          sc_ranges_adaptive_sparse.
+ * \param [in] mpicomm      MPI communicator to use.
+ * \param [in,out] receivers    Array of int, resized to the receivers.
+ * \param [in,out] senders      Array of int, resized to the processors
+ *                              that have this one in their ranges,
+ *                              in ascending order.
+ */
+void                sc_ranges_decode_sparse (int num_ranges,
+                                             const int *ranges,
+                                             MPI_Comm mpicomm,
+                                             sc_array_t * receivers,
+                                             sc_array_t * senders);
+
 /** Compute global statistical information on the ranges.
+ * Logs the number of covered processors that are no peers and the
+ * over-communication ratio, which is the number of messages sent to
+ * all covered processors divided by the number of messages needed.
  *
  * \param [in] package_id       Registered package id or -1.
  * \param [in] log_priority     Priority to use for logging.
@@ -108,6 +176,26 @@ void                sc_ranges_statistics (int package_id, int log_priority,
                                           const int *procs, int rank,
                                           int num_ranges, int *ranges);
 
+/** Compute global statistical information on ranges from a peer list.
+ * This is the same as sc_ranges_statistics for sc_ranges_compute_sparse.
+ *
+ * \param [in] package_id       Registered package id or -1.
+ * \param [in] log_priority     Priority to use for logging.
+ * \param [in] mpicomm          MPI communicator to use.
+ * \param [in] num_peers        Number of entries in peers.
+ * \param [in] peers            Strictly ascending processor numbers.
+ * \param [in] rank             This processor, is not counted.
+ * \param [in] num_ranges       Number of entries in ranges.
+ * \param [in] ranges           The ranges as computed.
+ */
+void                sc_ranges_statistics_sparse (int package_id,
+                                                 int log_priority,
+                                                 MPI_Comm mpicomm,
+                                                 int num_peers,
+                                                 const int *peers, int rank,
+                                                 int num_ranges,
+                                                 const int *ranges);
+
 SC_EXTERN_C_END;
 
 #endif /* !SC_RANGES_H */
@@ -22,8 +22,9 @@
 
 #include <sc_reduce.h>
 #include <sc_search.h>
+#include <sc_tune.h>
 
-#ifdef SC_MPI
+#ifdef SC_MPI_RANKS
 
 static void
 sc_reduce_alltoall (MPI_Comm mpicomm,
@@ -161,19 +162,20 @@ sc_reduce_recursive (MPI_Comm mpicomm,
   SC_ASSERT (0 <= myrank && myrank < groupsize);
   SC_ASSERT (reduce_fn != NULL);
 
+  /* *INDENT-OFF* HORRIBLE indent bug */
+  datasize = (size_t) count * sc_mpi_sizeof (datatype);
+  /* *INDENT-ON* */
+
   if (level == 0) {
     /* result is in data */
   }
-  else if (level <= SC_REDUCE_ALLTOALL_LEVEL) {
+  else if (level <= sc_tune_reduce_alltoall_level (datasize)) {
     /* all-to-all communication */
     sc_reduce_alltoall (mpicomm, data, count, datatype,
                         groupsize, orig_target,
                         maxlevel, level, branch, reduce_fn);
   }
   else {
-    /* *INDENT-OFF* HORRIBLE indent bug */
-    datasize = (size_t) count * sc_mpi_sizeof (datatype);
-    /* *INDENT-ON* */
     peer = sc_search_bias (maxlevel, level, branch ^ 0x01, target);
     SC_ASSERT (peer != myrank);
 
@@ -220,94 +222,494 @@ sc_reduce_recursive (MPI_Comm mpicomm,
   }
 }
 
-#endif /* SC_MPI */
+/** Stages of the nonblocking reduction in sc_ireduce_step. */
+typedef enum sc_ireduce_stage
+{
+  SC_IREDUCE_DOWN,              /* descend to the next recursion level */
+  SC_IREDUCE_RECEIVED,          /* reduce the data received from a peer */
+  SC_IREDUCE_ALLTOALL,          /* reduce the data of the all-to-all level */
+  SC_IREDUCE_RESULT,            /* copy the result received from a peer */
+  SC_IREDUCE_UP,                /* send the result to the lower peers */
+  SC_IREDUCE_DONE
+}
+sc_ireduce_stage_t;
+
+/** State of the nonblocking reduction.  It follows sc_reduce_recursive
+ * with the recursion unrolled into a loop over the levels.
+ */
+typedef struct sc_ireduce_state
+{
+  char               *data;
+  int                 count;
+  MPI_Datatype        datatype;
+  size_t              datasize;
+  sc_reduce_t         reduce_fn;
+  int                 groupsize;
+  int                 target;   /**< The target rank, 0 for allreduce. */
+  int                 doall;
+  int                 maxlevel, level, branch;
+  int                 alltoall_level;   /**< Highest all-to-all level. */
+  int                 num_peers;
+  int                *peers;    /**< Peers awaiting the allreduce result. */
+  char               *peerdata; /**< Receive buffer for one peer. */
+  char               *alldata;  /**< Receive buffer of the all-to-all. */
+  sc_ireduce_stage_t  stage;
+}
+sc_ireduce_state_t;
 
 static void
-sc_reduce_max (void *sendbuf, void *recvbuf,
-               int sendcount, MPI_Datatype sendtype)
+sc_ireduce_alltoall_post (sc_coll_request_t * req, sc_ireduce_state_t * rs)
 {
+  const int           allcount = 1 << rs->level;
+  const size_t        datasize = rs->datasize;
   int                 i;
+  int                 mpiret;
+  int                 myrank, peer;
+
+  myrank = sc_search_bias (rs->maxlevel, rs->level, rs->branch, rs->target);
 
-  if (sendtype == MPI_CHAR || sendtype == MPI_BYTE) {
-    const char         *s = (char *) sendbuf;
-    char               *r = (char *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+  if (rs->doall || rs->target == myrank) {
+    rs->alldata = SC_ALLOC (char, allcount * datasize);
+    for (i = 0; i < allcount; ++i) {
+      peer = sc_search_bias (rs->maxlevel, rs->level, i, rs->target);
+
+      /* communicate with existing peers */
+      if (peer == myrank) {
+        memcpy (rs->alldata + i * datasize, rs->data, datasize);
+      }
+      else if (peer < rs->groupsize) {
+        mpiret = MPI_Irecv (rs->alldata + i * datasize, datasize, MPI_BYTE,
+                            peer, req->tag, req->mpicomm,
+                            req->requests + req->num_requests++);
+        SC_CHECK_MPI (mpiret);
+        if (rs->doall) {
+          mpiret = MPI_Isend (rs->data, datasize, MPI_BYTE,
+                              peer, req->tag, req->mpicomm,
+                              req->requests + req->num_requests++);
+          SC_CHECK_MPI (mpiret);
+        }
+      }
+    }
   }
-  else if (sendtype == MPI_SHORT) {
-    const short        *s = (short *) sendbuf;
-    short              *r = (short *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+  else {
+    mpiret = MPI_Isend (rs->data, datasize, MPI_BYTE,
+                        rs->target, req->tag, req->mpicomm,
+                        req->requests + req->num_requests++);
+    SC_CHECK_MPI (mpiret);
   }
-  else if (sendtype == MPI_UNSIGNED_SHORT) {
-    const unsigned short *s = (unsigned short *) sendbuf;
-    unsigned short     *r = (unsigned short *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+}
+
+static void
+sc_ireduce_alltoall_reduce (sc_ireduce_state_t * rs)
+{
+  const size_t        datasize = rs->datasize;
+  int                 i, l;
+#ifdef SC_DEBUG
+  int                 peer;
+#endif
+  int                 peer2;
+  int                 shift;
+
+  if (rs->alldata == NULL) {
+    return;
   }
-  else if (sendtype == MPI_INT) {
-    const int          *s = (int *) sendbuf;
-    int                *r = (int *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+
+  /* process received data in the same order as sc_reduce_recursive */
+  for (shift = 0, l = rs->level - 1; l >= 0; ++shift, --l) {
+    for (i = 0; i < 1 << l; ++i) {
+#ifdef SC_DEBUG
+      peer = sc_search_bias (rs->maxlevel, l + 1, 2 * i, rs->target);
+#endif
+      peer2 = sc_search_bias (rs->maxlevel, l + 1, 2 * i + 1, rs->target);
+      SC_ASSERT (peer < peer2);
+
+      if (peer2 < rs->groupsize) {
+        rs->reduce_fn (rs->alldata + ((2 * i + 1) << shift) * datasize,
+                       rs->alldata + ((2 * i) << shift) * datasize,
+                       rs->count, rs->datatype);
+      }
+    }
   }
-  else if (sendtype == MPI_UNSIGNED) {
-    const unsigned     *s = (unsigned *) sendbuf;
-    unsigned           *r = (unsigned *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+  memcpy (rs->data, rs->alldata, datasize);
+  SC_FREE (rs->alldata);
+  rs->alldata = NULL;
+}
+
+static int
+sc_ireduce_step (sc_coll_request_t * req)
+{
+  sc_ireduce_state_t *rs = (sc_ireduce_state_t *) req->state;
+  int                 i;
+  int                 mpiret;
+  int                 myrank, peer, higher;
+
+  for (;;) {
+    switch (rs->stage) {
+    case SC_IREDUCE_RECEIVED:
+      rs->reduce_fn (rs->peerdata, rs->data, rs->count, rs->datatype);
+      --rs->level;
+      rs->branch /= 2;
+      rs->stage = SC_IREDUCE_DOWN;
+      break;
+    case SC_IREDUCE_DOWN:
+      if (rs->level == 0) {
+        rs->stage = SC_IREDUCE_UP;
+        break;
+      }
+      if (rs->level <= rs->alltoall_level) {
+        sc_ireduce_alltoall_post (req, rs);
+        rs->stage = SC_IREDUCE_ALLTOALL;
+        return 0;
+      }
+      myrank = sc_search_bias (rs->maxlevel, rs->level, rs->branch,
+                               rs->target);
+      peer = sc_search_bias (rs->maxlevel, rs->level, rs->branch ^ 0x01,
+                             rs->target);
+      higher = sc_search_bias (rs->maxlevel, rs->level - 1, rs->branch / 2,
+                               rs->target);
+      SC_ASSERT (peer != myrank);
+      if (myrank == higher) {
+        if (peer < rs->groupsize) {
+          mpiret = MPI_Irecv (rs->peerdata, rs->datasize, MPI_BYTE,
+                              peer, req->tag, req->mpicomm,
+                              req->requests + req->num_requests++);
+          SC_CHECK_MPI (mpiret);
+          if (rs->doall) {
+            rs->peers[rs->num_peers++] = peer;
+          }
+          rs->stage = SC_IREDUCE_RECEIVED;
+          return 0;
+        }
+        --rs->level;
+        rs->branch /= 2;
+        break;
+      }
+      rs->stage = SC_IREDUCE_UP;
+      if (peer < rs->groupsize) {
+        mpiret = MPI_Isend (rs->data, rs->datasize, MPI_BYTE,
+                            peer, req->tag, req->mpicomm,
+                            req->requests + req->num_requests++);
+        SC_CHECK_MPI (mpiret);
+        if (rs->doall) {
+          /* receive back the result of the reduction */
+          mpiret = MPI_Irecv (rs->peerdata, rs->datasize, MPI_BYTE,
+                              peer, req->tag, req->mpicomm,
+                              req->requests + req->num_requests++);
+          SC_CHECK_MPI (mpiret);
+          rs->stage = SC_IREDUCE_RESULT;
+        }
+        return 0;
+      }
+      break;
+    case SC_IREDUCE_ALLTOALL:
+      sc_ireduce_alltoall_reduce (rs);
+      rs->stage = SC_IREDUCE_UP;
+      break;
+    case SC_IREDUCE_RESULT:
+      memcpy (rs->data, rs->peerdata, rs->datasize);
+      rs->stage = SC_IREDUCE_UP;
+      break;
+    case SC_IREDUCE_UP:
+      /* all lower peers obtain the result at once */
+      for (i = 0; i < rs->num_peers; ++i) {
+        mpiret = MPI_Isend (rs->data, rs->datasize, MPI_BYTE,
+                            rs->peers[i], req->tag, req->mpicomm,
+                            req->requests + req->num_requests++);
+        SC_CHECK_MPI (mpiret);
+      }
+      rs->stage = SC_IREDUCE_DONE;
+      if (rs->num_peers > 0) {
+        return 0;
+      }
+      break;
+    case SC_IREDUCE_DONE:
+      SC_ASSERT (rs->alldata == NULL);
+      SC_FREE (rs->peers);
+      SC_FREE (rs->peerdata);
+      SC_FREE (rs);
+      return 1;
+    default:
+      SC_ABORT_NOT_REACHED ();
+    }
   }
-  else if (sendtype == MPI_LONG) {
-    const long         *s = (long *) sendbuf;
-    long               *r = (long *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+}
+
+/** Post segmented messages to send a range of bytes.
+ * \return          The number of requests posted.
+ */
+static int
+sc_reduce_post_sends (MPI_Comm mpicomm, char *data, size_t bytes,
+                      size_t segbytes, int peer, MPI_Request * request)
+{
+  int                 mpiret;
+  int                 num;
+
+  for (num = 0; bytes > 0; ++num) {
+    mpiret = MPI_Isend (data, (int) SC_MIN (bytes, segbytes), MPI_BYTE,
+                        peer, SC_TAG_REDUCE, mpicomm, request + num);
+    SC_CHECK_MPI (mpiret);
+    data += SC_MIN (bytes, segbytes);
+    bytes -= SC_MIN (bytes, segbytes);
   }
-  else if (sendtype == MPI_UNSIGNED_LONG) {
-    const unsigned long *s = (unsigned long *) sendbuf;
-    unsigned long      *r = (unsigned long *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+  return num;
+}
+
+/** Send one range of elements and reduce another received one.
+ * Both ranges are sent in segments of segcount elements.  Two segments
+ * are received at a time such that the reduction of a segment overlaps
+ * the receipt of the next one.
+ * \param [in] sendbuf      Elements to send to dest, unless dest < 0.
+ * \param [in,out] recvbuf  Reduced with the elements from source,
+ *                          unless source < 0.
+ * \param [in] tmp          Buffer for two segments.
+ */
+static void
+sc_reduce_pipeline (MPI_Comm mpicomm, char *sendbuf, int sendcount,
+                    int dest, char *recvbuf, int recvcount, int source,
+                    char *tmp, int segcount, MPI_Datatype datatype,
+                    sc_reduce_t reduce_fn)
+{
+  const size_t        typesize = sc_mpi_sizeof (datatype);
+  const size_t        segbytes = segcount * typesize;
+  const int           num_segments = (recvcount + segcount - 1) / segcount;
+  int                 mpiret;
+  int                 k, first, count;
+  int                 num_sends;
+  MPI_Request         rrequest[2], *srequest;
+
+  num_sends = 0;
+  srequest = NULL;
+  if (dest >= 0 && sendcount > 0) {
+    srequest = SC_ALLOC (MPI_Request, sendcount / segcount + 1);
+    num_sends = sc_reduce_post_sends (mpicomm, sendbuf,
+                                      sendcount * typesize, segbytes,
+                                      dest, srequest);
+  }
+
+  if (source >= 0) {
+    for (k = 0; k < SC_MIN (2, num_segments); ++k) {
+      count = SC_MIN (segcount, recvcount - k * segcount);
+      mpiret = MPI_Irecv (tmp + k * segbytes, count * typesize, MPI_BYTE,
+                          source, SC_TAG_REDUCE, mpicomm, rrequest + k);
+      SC_CHECK_MPI (mpiret);
+    }
+    for (k = 0; k < num_segments; ++k) {
+      mpiret = MPI_Wait (rrequest + k % 2, MPI_STATUS_IGNORE);
+      SC_CHECK_MPI (mpiret);
+      first = k * segcount;
+      count = SC_MIN (segcount, recvcount - first);
+      reduce_fn (tmp + (k % 2) * segbytes, recvbuf + first * typesize,
+                 count, datatype);
+      if (k + 2 < num_segments) {
+        first = (k + 2) * segcount;
+        count = SC_MIN (segcount, recvcount - first);
+        mpiret = MPI_Irecv (tmp + (k % 2) * segbytes, count * typesize,
+                            MPI_BYTE, source, SC_TAG_REDUCE, mpicomm,
+                            rrequest + k % 2);
+        SC_CHECK_MPI (mpiret);
+      }
+    }
   }
-  else if (sendtype == MPI_LONG_LONG_INT) {
-    const long long    *s = (long long *) sendbuf;
-    long long          *r = (long long *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+
+  if (num_sends > 0) {
+    mpiret = MPI_Waitall (num_sends, srequest, MPI_STATUSES_IGNORE);
+    SC_CHECK_MPI (mpiret);
   }
-  else if (sendtype == MPI_FLOAT) {
-    const float        *s = (float *) sendbuf;
-    float              *r = (float *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+  SC_FREE (srequest);
+}
+
+/** Exchange ranges of elements with one peer without reduction.
+ * \param [in] dest     Send to dest, unless dest < 0.
+ * \param [in] source   Receive from source, unless source < 0.
+ */
+static void
+sc_reduce_exchange (MPI_Comm mpicomm, char *sendbuf, int sendcount,
+                    int dest, char *recvbuf, int recvcount, int source,
+                    int segcount, MPI_Datatype datatype)
+{
+  const size_t        typesize = sc_mpi_sizeof (datatype);
+  const size_t        segbytes = segcount * typesize;
+  int                 mpiret;
+  int                 num, first;
+  MPI_Request        *request;
+
+  request = SC_ALLOC (MPI_Request, (sendcount + recvcount) / segcount + 2);
+  num = 0;
+  if (dest >= 0) {
+    num = sc_reduce_post_sends (mpicomm, sendbuf, sendcount * typesize,
+                                segbytes, dest, request);
   }
-  else if (sendtype == MPI_DOUBLE) {
-    const double       *s = (double *) sendbuf;
-    double             *r = (double *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+  if (source >= 0) {
+    for (first = 0; first < recvcount; first += segcount) {
+      mpiret = MPI_Irecv (recvbuf + first * typesize,
+                          SC_MIN (segcount, recvcount - first) * typesize,
+                          MPI_BYTE, source, SC_TAG_REDUCE, mpicomm,
+                          request + num++);
+      SC_CHECK_MPI (mpiret);
+    }
   }
-  else if (sendtype == MPI_LONG_DOUBLE) {
-    const long double  *s = (long double *) sendbuf;
-    long double        *r = (long double *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] > r[i])
-        r[i] = s[i];
+  mpiret = MPI_Waitall (num, request, MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  SC_FREE (request);
+}
+
+/** Allreduce by recursive halving and doubling (Rabenseifner).
+ * With a non-power-of-two number of processes, the first even ranks
+ * pass their data to the next odd rank and take no part otherwise.
+ * The reduction function is assumed to be commutative.
+ */
+static void
+sc_reduce_rabenseifner (MPI_Comm mpicomm, char *data, int count,
+                        MPI_Datatype datatype, sc_reduce_t reduce_fn)
+{
+  const size_t        typesize = sc_mpi_sizeof (datatype);
+  int                 mpiret;
+  int                 mpisize, mpirank;
+  int                 pof2, rem, newrank, newpeer, peer;
+  int                 d, step, num_steps;
+  int                 mid, segcount;
+  int                 lo[32], hi[32];
+  char               *tmp;
+
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  pof2 = 1 << SC_LOG2_32 (mpisize);
+  rem = mpisize - pof2;
+  SC_ASSERT (count >= pof2);
+
+  segcount = (int) SC_MAX (SC_REDUCE_SEGMENT_BYTES / typesize, 1);
+  tmp = SC_ALLOC (char, 2 * segcount * typesize);
+
+  /* fold the surplus processes onto their neighbors */
+  newrank = -1;
+  if (mpirank < 2 * rem) {
+    if (mpirank % 2 == 0) {
+      sc_reduce_pipeline (mpicomm, data, count, mpirank + 1, NULL, 0, -1,
+                          tmp, segcount, datatype, reduce_fn);
+    }
+    else {
+      sc_reduce_pipeline (mpicomm, NULL, 0, -1, data, count, mpirank - 1,
+                          tmp, segcount, datatype, reduce_fn);
+      newrank = mpirank / 2;
+    }
   }
   else {
-    SC_ABORT ("Unsupported MPI datatype in sc_reduce_max");
+    newrank = mpirank - rem;
+  }
+
+  if (newrank >= 0) {
+    /* reduce-scatter by recursive halving */
+    lo[0] = 0;
+    hi[0] = count;
+    num_steps = 0;
+    for (d = pof2 / 2; d >= 1; d /= 2) {
+      step = num_steps++;
+      newpeer = newrank ^ d;
+      peer = newpeer < rem ? 2 * newpeer + 1 : newpeer + rem;
+      mid = lo[step] + (hi[step] - lo[step]) / 2;
+      if (newrank & d) {
+        lo[step + 1] = mid;
+        hi[step + 1] = hi[step];
+        sc_reduce_pipeline (mpicomm, data + lo[step] * typesize,
+                            mid - lo[step], peer, data + mid * typesize,
+                            hi[step] - mid, peer, tmp, segcount,
+                            datatype, reduce_fn);
+      }
+      else {
+        lo[step + 1] = lo[step];
+        hi[step + 1] = mid;
+        sc_reduce_pipeline (mpicomm, data + mid * typesize,
+                            hi[step] - mid, peer, data + lo[step] * typesize,
+                            mid - lo[step], peer, tmp, segcount,
+                            datatype, reduce_fn);
+      }
+    }
+
+    /* allgather by recursive doubling in reverse order */
+    for (step = num_steps - 1, d = 1; step >= 0; --step, d *= 2) {
+      newpeer = newrank ^ d;
+      peer = newpeer < rem ? 2 * newpeer + 1 : newpeer + rem;
+      mid = lo[step] + (hi[step] - lo[step]) / 2;
+      if (newrank & d) {
+        sc_reduce_exchange (mpicomm, data + mid * typesize, hi[step] - mid,
+                            peer, data + lo[step] * typesize,
+                            mid - lo[step], peer, segcount, datatype);
+      }
+      else {
+        sc_reduce_exchange (mpicomm, data + lo[step] * typesize,
+                            mid - lo[step], peer, data + mid * typesize,
+                            hi[step] - mid, peer, segcount, datatype);
+      }
+    }
+  }
+
+  /* return the result to the surplus processes */
+  if (mpirank < 2 * rem) {
+    if (mpirank % 2 == 0) {
+      sc_reduce_exchange (mpicomm, NULL, 0, -1, data, count, mpirank + 1,
+                          segcount, datatype);
+    }
+    else {
+      sc_reduce_exchange (mpicomm, data, count, mpirank - 1, NULL, 0, -1,
+                          segcount, datatype);
+    }
   }
+
+  SC_FREE (tmp);
+}
+
+#endif /* SC_MPI_RANKS */
+
+/* Each kernel combines restrict-qualified arrays with a branch-free
+ * loop body such that the compiler vectorizes it for the target.
+ */
+#define SC_REDUCE_LOOP(T,expr) do {                                     \
+    const T            *restrict s = (const T *) sendbuf;               \
+    T                  *restrict r = (T *) recvbuf;                     \
+    for (i = 0; i < sendcount; ++i)                                     \
+      r[i] = (T) (expr);                                                \
+  } while (0)
+
+#define SC_REDUCE_INTEGER(expr,name)                                    \
+  if (sendtype == MPI_CHAR || sendtype == MPI_BYTE)                     \
+    SC_REDUCE_LOOP (char, expr);                                        \
+  else if (sendtype == MPI_SHORT)                                       \
+    SC_REDUCE_LOOP (short, expr);                                       \
+  else if (sendtype == MPI_UNSIGNED_SHORT)                              \
+    SC_REDUCE_LOOP (unsigned short, expr);                              \
+  else if (sendtype == MPI_INT)                                         \
+    SC_REDUCE_LOOP (int, expr);                                         \
+  else if (sendtype == MPI_UNSIGNED)                                    \
+    SC_REDUCE_LOOP (unsigned, expr);                                    \
+  else if (sendtype == MPI_LONG)                                        \
+    SC_REDUCE_LOOP (long, expr);                                        \
+  else if (sendtype == MPI_UNSIGNED_LONG)                               \
+    SC_REDUCE_LOOP (unsigned long, expr);                               \
+  else if (sendtype == MPI_LONG_LONG_INT)                               \
+    SC_REDUCE_LOOP (long long, expr);                                   \
+  else                                                                  \
+    SC_ABORT ("Unsupported MPI datatype in " name)
+
+#define SC_REDUCE_ARITHMETIC(expr,name)                                 \
+  if (sendtype == MPI_FLOAT)                                            \
+    SC_REDUCE_LOOP (float, expr);                                       \
+  else if (sendtype == MPI_DOUBLE)                                      \
+    SC_REDUCE_LOOP (double, expr);                                      \
+  else if (sendtype == MPI_LONG_DOUBLE)                                 \
+    SC_REDUCE_LOOP (long double, expr);                                 \
+  else                                                                  \
+    SC_REDUCE_INTEGER (expr, name)
+
+static void
+sc_reduce_max (void *sendbuf, void *recvbuf,
+               int sendcount, MPI_Datatype sendtype)
+{
+  int                 i;
+
+  SC_REDUCE_ARITHMETIC (s[i] > r[i] ? s[i] : r[i], "sc_reduce_max");
 }
 
 static void
@@ -316,86 +718,7 @@ sc_reduce_min (void *sendbuf, void *recvbuf,
 {
   int                 i;
 
-  if (sendtype == MPI_CHAR || sendtype == MPI_BYTE) {
-    const char         *s = (char *) sendbuf;
-    char               *r = (char *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else if (sendtype == MPI_SHORT) {
-    const short        *s = (short *) sendbuf;
-    short              *r = (short *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else if (sendtype == MPI_UNSIGNED_SHORT) {
-    const unsigned short *s = (unsigned short *) sendbuf;
-    unsigned short     *r = (unsigned short *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else if (sendtype == MPI_INT) {
-    const int          *s = (int *) sendbuf;
-    int                *r = (int *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else if (sendtype == MPI_UNSIGNED) {
-    const unsigned     *s = (unsigned *) sendbuf;
-    unsigned           *r = (unsigned *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else if (sendtype == MPI_LONG) {
-    const long         *s = (long *) sendbuf;
-    long               *r = (long *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else if (sendtype == MPI_UNSIGNED_LONG) {
-    const unsigned long *s = (unsigned long *) sendbuf;
-    unsigned long      *r = (unsigned long *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else if (sendtype == MPI_LONG_LONG_INT) {
-    const long long    *s = (long long *) sendbuf;
-    long long          *r = (long long *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else if (sendtype == MPI_FLOAT) {
-    const float        *s = (float *) sendbuf;
-    float              *r = (float *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else if (sendtype == MPI_DOUBLE) {
-    const double       *s = (double *) sendbuf;
-    double             *r = (double *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else if (sendtype == MPI_LONG_DOUBLE) {
-    const long double  *s = (long double *) sendbuf;
-    long double        *r = (long double *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      if (s[i] < r[i])
-        r[i] = s[i];
-  }
-  else {
-    SC_ABORT ("Unsupported MPI datatype in sc_reduce_min");
-  }
+  SC_REDUCE_ARITHMETIC (s[i] < r[i] ? s[i] : r[i], "sc_reduce_min");
 }
 
 static void
@@ -404,74 +727,114 @@ sc_reduce_sum (void *sendbuf, void *recvbuf,
 {
   int                 i;
 
-  if (sendtype == MPI_CHAR || sendtype == MPI_BYTE) {
-    const char         *s = (char *) sendbuf;
-    char               *r = (char *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else if (sendtype == MPI_SHORT) {
-    const short        *s = (short *) sendbuf;
-    short              *r = (short *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else if (sendtype == MPI_UNSIGNED_SHORT) {
-    const unsigned short *s = (unsigned short *) sendbuf;
-    unsigned short     *r = (unsigned short *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else if (sendtype == MPI_INT) {
-    const int          *s = (int *) sendbuf;
-    int                *r = (int *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else if (sendtype == MPI_UNSIGNED) {
-    const unsigned     *s = (unsigned *) sendbuf;
-    unsigned           *r = (unsigned *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else if (sendtype == MPI_LONG) {
-    const long         *s = (long *) sendbuf;
-    long               *r = (long *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else if (sendtype == MPI_UNSIGNED_LONG) {
-    const unsigned long *s = (unsigned long *) sendbuf;
-    unsigned long      *r = (unsigned long *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else if (sendtype == MPI_LONG_LONG_INT) {
-    const long long    *s = (long long *) sendbuf;
-    long long          *r = (long long *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else if (sendtype == MPI_FLOAT) {
-    const float        *s = (float *) sendbuf;
-    float              *r = (float *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else if (sendtype == MPI_DOUBLE) {
-    const double       *s = (double *) sendbuf;
-    double             *r = (double *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else if (sendtype == MPI_LONG_DOUBLE) {
-    const long double  *s = (long double *) sendbuf;
-    long double        *r = (long double *) recvbuf;
-    for (i = 0; i < sendcount; ++i)
-      r[i] += s[i];
-  }
-  else {
-    SC_ABORT ("Unsupported MPI datatype in sc_reduce_sum");
+  SC_REDUCE_ARITHMETIC (r[i] + s[i], "sc_reduce_sum");
+}
+
+static void
+sc_reduce_prod (void *sendbuf, void *recvbuf,
+                int sendcount, MPI_Datatype sendtype)
+{
+  int                 i;
+
+  SC_REDUCE_ARITHMETIC (r[i] * s[i], "sc_reduce_prod");
+}
+
+static void
+sc_reduce_band (void *sendbuf, void *recvbuf,
+                int sendcount, MPI_Datatype sendtype)
+{
+  int                 i;
+
+  SC_REDUCE_INTEGER (r[i] & s[i], "sc_reduce_band");
+}
+
+static void
+sc_reduce_bor (void *sendbuf, void *recvbuf,
+               int sendcount, MPI_Datatype sendtype)
+{
+  int                 i;
+
+  SC_REDUCE_INTEGER (r[i] | s[i], "sc_reduce_bor");
+}
+
+static void
+sc_reduce_land (void *sendbuf, void *recvbuf,
+                int sendcount, MPI_Datatype sendtype)
+{
+  int                 i;
+
+  SC_REDUCE_INTEGER (r[i] && s[i], "sc_reduce_land");
+}
+
+static void
+sc_reduce_lor (void *sendbuf, void *recvbuf,
+               int sendcount, MPI_Datatype sendtype)
+{
+  int                 i;
+
+  SC_REDUCE_INTEGER (r[i] || s[i], "sc_reduce_lor");
+}
+
+/* Take the pair of better value and, for equal values, lower index. */
+#define SC_REDUCE_LOCLOOP(T,better) do {                                \
+    const T            *restrict s = (const T *) sendbuf;               \
+    T                  *restrict r = (T *) recvbuf;                     \
+    for (i = 0; i < sendcount; ++i)                                     \
+      if (s[i].value better r[i].value ||                               \
+          (s[i].value == r[i].value && s[i].index < r[i].index))        \
+        r[i] = s[i];                                                    \
+  } while (0)
+
+#define SC_REDUCE_LOCTYPES(better,name)                                 \
+  if (sendtype == MPI_FLOAT_INT)                                        \
+    SC_REDUCE_LOCLOOP (sc_mpi_float_int_t, better);                     \
+  else if (sendtype == MPI_DOUBLE_INT)                                  \
+    SC_REDUCE_LOCLOOP (sc_mpi_double_int_t, better);                    \
+  else if (sendtype == MPI_LONG_INT)                                    \
+    SC_REDUCE_LOCLOOP (sc_mpi_long_int_t, better);                      \
+  else if (sendtype == MPI_2INT)                                        \
+    SC_REDUCE_LOCLOOP (sc_mpi_2int_t, better);                          \
+  else                                                                  \
+    SC_ABORT ("Unsupported MPI datatype in " name)
+
+static void
+sc_reduce_minloc (void *sendbuf, void *recvbuf,
+                  int sendcount, MPI_Datatype sendtype)
+{
+  int                 i;
+
+  SC_REDUCE_LOCTYPES (<, "sc_reduce_minloc");
+}
+
+static void
+sc_reduce_maxloc (void *sendbuf, void *recvbuf,
+                  int sendcount, MPI_Datatype sendtype)
+{
+  int                 i;
+
+  SC_REDUCE_LOCTYPES (>, "sc_reduce_maxloc");
+}
+
+void
+sc_reduce_kahan_sum (void *sendbuf, void *recvbuf,
+                     int sendcount, MPI_Datatype sendtype)
+{
+  int                 i;
+  double              a, b, t;
+  const double       *restrict s = (const double *) sendbuf;
+  double             *restrict r = (double *) recvbuf;
+
+  SC_CHECK_ABORT (sendtype == MPI_DOUBLE && sendcount % 2 == 0,
+                  "sc_reduce_kahan_sum requires pairs of MPI_DOUBLE");
+
+  /* add the sums with Neumaier's error term and the compensations */
+  for (i = 0; i < sendcount; i += 2) {
+    a = r[i];
+    b = s[i];
+    t = a + b;
+    r[i + 1] += s[i + 1] +
+      (fabs (a) >= fabs (b) ? (a - t) + b : (b - t) + a);
+    r[i] = t;
   }
 }
 
@@ -480,7 +843,7 @@ sc_reduce_custom_dispatch (void *sendbuf, void *recvbuf, int sendcount,
                            MPI_Datatype sendtype, sc_reduce_t reduce_fn,
                            int target, MPI_Comm mpicomm)
 {
-#ifdef SC_MPI
+#ifdef SC_MPI_RANKS
   int                 mpiret;
   int                 mpisize;
   int                 mpirank;
@@ -495,7 +858,7 @@ sc_reduce_custom_dispatch (void *sendbuf, void *recvbuf, int sendcount,
   /* *INDENT-ON* */
   memcpy (recvbuf, sendbuf, datasize);
 
-#ifdef SC_MPI
+#ifdef SC_MPI_RANKS
   mpiret = MPI_Comm_size (mpicomm, &mpisize);
   SC_CHECK_MPI (mpiret);
   mpiret = MPI_Comm_rank (mpicomm, &mpirank);
@@ -532,24 +895,60 @@ sc_reduce_custom (void *sendbuf, void *recvbuf, int sendcount,
                                     sendtype, reduce_fn, target, mpicomm);
 }
 
+sc_reduce_t
+sc_reduce_operation_fn (MPI_Op operation)
+{
+  if (operation == MPI_MAX)
+    return sc_reduce_max;
+  else if (operation == MPI_MIN)
+    return sc_reduce_min;
+  else if (operation == MPI_SUM)
+    return sc_reduce_sum;
+  else if (operation == MPI_PROD)
+    return sc_reduce_prod;
+  else if (operation == MPI_BAND)
+    return sc_reduce_band;
+  else if (operation == MPI_BOR)
+    return sc_reduce_bor;
+  else if (operation == MPI_LAND)
+    return sc_reduce_land;
+  else if (operation == MPI_LOR)
+    return sc_reduce_lor;
+  else if (operation == MPI_MINLOC)
+    return sc_reduce_minloc;
+  else if (operation == MPI_MAXLOC)
+    return sc_reduce_maxloc;
+
+  SC_ABORT ("Unsupported operation in sc_allreduce or sc_reduce");
+  return NULL;
+}
+
 static int
 sc_reduce_dispatch (void *sendbuf, void *recvbuf, int sendcount,
                     MPI_Datatype sendtype, MPI_Op operation,
                     int target, MPI_Comm mpicomm)
 {
-  sc_reduce_t         reduce_fn;
+#ifdef SC_MPI_RANKS
+  int                 mpiret;
+  int                 mpisize;
 
-  if (operation == MPI_MAX)
-    reduce_fn = sc_reduce_max;
-  else if (operation == MPI_MIN)
-    reduce_fn = sc_reduce_min;
-  else if (operation == MPI_SUM)
-    reduce_fn = sc_reduce_sum;
-  else
-    SC_ABORT ("Unsupported operation in sc_allreduce or sc_reduce");
+  /* the built-in operations are commutative */
+  if (target == -1 && (size_t) sendcount * sc_mpi_sizeof (sendtype) >=
+      (size_t) SC_REDUCE_LARGE_BYTES) {
+    mpiret = MPI_Comm_size (mpicomm, &mpisize);
+    SC_CHECK_MPI (mpiret);
+    if (mpisize > 1 && sendcount >= mpisize) {
+      memcpy (recvbuf, sendbuf, sendcount * sc_mpi_sizeof (sendtype));
+      sc_reduce_rabenseifner (mpicomm, (char *) recvbuf, sendcount,
+                              sendtype, sc_reduce_operation_fn (operation));
+      return MPI_SUCCESS;
+    }
+  }
+#endif
 
-  return sc_reduce_custom_dispatch (sendbuf, recvbuf, sendcount,
-                                    sendtype, reduce_fn, target, mpicomm);
+  return sc_reduce_custom_dispatch (sendbuf, recvbuf, sendcount, sendtype,
+                                    sc_reduce_operation_fn (operation),
+                                    target, mpicomm);
 }
 
 int
@@ -570,3 +969,109 @@ sc_reduce (void *sendbuf, void *recvbuf, int sendcount,
   return sc_reduce_dispatch (sendbuf, recvbuf, sendcount,
                              sendtype, operation, target, mpicomm);
 }
+
+static int
+sc_ireduce_custom_dispatch (void *sendbuf, void *recvbuf, int sendcount,
+                            MPI_Datatype sendtype, sc_reduce_t reduce_fn,
+                            int target, MPI_Comm mpicomm,
+                            sc_coll_request_t ** request)
+{
+#ifdef SC_MPI_RANKS
+  int                 mpiret;
+  int                 mpisize;
+  int                 mpirank;
+  int                 maxlevel;
+  sc_ireduce_state_t *rs;
+#endif
+  size_t              datasize;
+
+  SC_ASSERT (sendcount >= 0);
+  SC_ASSERT (reduce_fn != NULL);
+
+  /* *INDENT-OFF* HORRIBLE indent bug */
+  datasize = (size_t) sendcount * sc_mpi_sizeof (sendtype);
+  /* *INDENT-ON* */
+  memcpy (recvbuf, sendbuf, datasize);
+
+#ifdef SC_MPI_RANKS
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  SC_ASSERT (-1 <= target && target < mpisize);
+
+  maxlevel = SC_LOG2_32 (mpisize - 1) + 1;
+
+  rs = SC_ALLOC (sc_ireduce_state_t, 1);
+  rs->data = (char *) recvbuf;
+  rs->count = sendcount;
+  rs->datatype = sendtype;
+  rs->datasize = datasize;
+  rs->reduce_fn = reduce_fn;
+  rs->groupsize = mpisize;
+  rs->doall = (target == -1);
+  rs->target = rs->doall ? 0 : target;
+  rs->maxlevel = rs->level = maxlevel;
+  rs->branch = mpirank;
+  rs->alltoall_level = sc_tune_reduce_alltoall_level (datasize);
+  rs->num_peers = 0;
+  rs->peers = SC_ALLOC (int, maxlevel + 1);
+  rs->peerdata = SC_ALLOC (char, datasize);
+  rs->alldata = NULL;
+  rs->stage = SC_IREDUCE_DOWN;
+
+  *request = sc_coll_request_new (mpicomm,
+                                  SC_MAX (2 << rs->alltoall_level,
+                                          maxlevel + 1),
+                                  sc_ireduce_step, rs);
+#else
+  *request = sc_coll_request_new (mpicomm, 0, NULL, NULL);
+#endif
+
+  return MPI_SUCCESS;
+}
+
+int
+sc_iallreduce_custom (void *sendbuf, void *recvbuf, int sendcount,
+                      MPI_Datatype sendtype, sc_reduce_t reduce_fn,
+                      MPI_Comm mpicomm, sc_coll_request_t ** request)
+{
+  return sc_ireduce_custom_dispatch (sendbuf, recvbuf, sendcount, sendtype,
+                                     reduce_fn, -1, mpicomm, request);
+}
+
+int
+sc_ireduce_custom (void *sendbuf, void *recvbuf, int sendcount,
+                   MPI_Datatype sendtype, sc_reduce_t reduce_fn,
+                   int target, MPI_Comm mpicomm,
+                   sc_coll_request_t ** request)
+{
+  SC_CHECK_ABORT (target >= 0,
+                  "sc_ireduce_custom requires non-negative target");
+
+  return sc_ireduce_custom_dispatch (sendbuf, recvbuf, sendcount, sendtype,
+                                     reduce_fn, target, mpicomm, request);
+}
+
+int
+sc_iallreduce (void *sendbuf, void *recvbuf, int sendcount,
+               MPI_Datatype sendtype, MPI_Op operation, MPI_Comm mpicomm,
+               sc_coll_request_t ** request)
+{
+  return sc_ireduce_custom_dispatch (sendbuf, recvbuf, sendcount, sendtype,
+                                     sc_reduce_operation_fn (operation),
+                                     -1, mpicomm, request);
+}
+
+int
+sc_ireduce (void *sendbuf, void *recvbuf, int sendcount,
+            MPI_Datatype sendtype, MPI_Op operation, int target,
+            MPI_Comm mpicomm, sc_coll_request_t ** request)
+{
+  SC_CHECK_ABORT (target >= 0, "sc_ireduce requires non-negative target");
+
+  return sc_ireduce_custom_dispatch (sendbuf, recvbuf, sendcount, sendtype,
+                                     sc_reduce_operation_fn (operation),
+                                     target, mpicomm, request);
+}
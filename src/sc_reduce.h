@@ -23,13 +23,24 @@
 #ifndef SC_REDUCE_H
 #define SC_REDUCE_H
 
-#include <sc.h>
+#include <sc_coll.h>
 
-/* highest level that uses all-to-all instead of recursion */
+/* highest level that uses all-to-all instead of recursion,
+   default of sc_tune_reduce_alltoall_level */
 #ifndef SC_REDUCE_ALLTOALL_LEVEL
 #define SC_REDUCE_ALLTOALL_LEVEL        3
 #endif
 
+/* sc_allreduce switches to reduce-scatter and allgather from this size */
+#ifndef SC_REDUCE_LARGE_BYTES
+#define SC_REDUCE_LARGE_BYTES           (1 << 16)
+#endif
+
+/* the large allreduce pipelines its messages in segments of this size */
+#ifndef SC_REDUCE_SEGMENT_BYTES
+#define SC_REDUCE_SEGMENT_BYTES         (1 << 15)
+#endif
+
 typedef void        (*sc_reduce_t) (void *sendbuf, void *recvbuf,
                                     int sendcount, MPI_Datatype sendtype);
 
@@ -51,6 +62,10 @@ int                 sc_reduce_custom (void *sendbuf, void *recvbuf,
                                       int target, MPI_Comm mpicomm);
 
 /** Drop-in MPI_Allreduce replacement.
+ * Messages of at least SC_REDUCE_LARGE_BYTES are reduced by recursive
+ * halving and gathered by recursive doubling (Rabenseifner's algorithm),
+ * where the reduction of one segment overlaps the receipt of the next.
+ * The order of the reduction then differs from sc_allreduce_custom.
  */
 int                 sc_allreduce (void *sendbuf, void *recvbuf, int sendcount,
                                   MPI_Datatype sendtype, MPI_Op operation,
@@ -63,6 +78,64 @@ int                 sc_reduce (void *sendbuf, void *recvbuf, int sendcount,
                                MPI_Datatype sendtype, MPI_Op operation,
                                int target, MPI_Comm mpicomm);
 
+/** Return the reduction function of an MPI operation.
+ * MPI_MAX, MPI_MIN, MPI_SUM and MPI_PROD accept the integer and floating
+ * point types, MPI_BAND, MPI_BOR, MPI_LAND and MPI_LOR the integer types,
+ * and MPI_MINLOC and MPI_MAXLOC the types MPI_FLOAT_INT, MPI_DOUBLE_INT,
+ * MPI_LONG_INT and MPI_2INT.
+ * \param [in] operation   One of the operations above.  Aborts otherwise.
+ */
+sc_reduce_t         sc_reduce_operation_fn (MPI_Op operation);
+
+/** Compensated summation for sc_allreduce_custom and sc_reduce_custom.
+ * Each value is passed as a pair of MPI_DOUBLE, the value and a
+ * compensation initialized to zero.  The sum of the values is
+ * approximated much more accurately by the sum of the resulting pair
+ * than by a plain MPI_SUM, independent of the number of processes.
+ * \param [in] sendcount  Twice the number of values.
+ */
+void                sc_reduce_kahan_sum (void *sendbuf, void *recvbuf,
+                                         int sendcount,
+                                         MPI_Datatype sendtype);
+
+/** Nonblocking custom allreduce with the schedule of sc_allreduce_custom.
+ * The buffers must not be accessed before the request is complete.
+ * \param [out] request    Completed by sc_coll_test or sc_coll_wait.
+ */
+int                 sc_iallreduce_custom (void *sendbuf, void *recvbuf,
+                                          int sendcount,
+                                          MPI_Datatype sendtype,
+                                          sc_reduce_t reduce_fn,
+                                          MPI_Comm mpicomm,
+                                          sc_coll_request_t ** request);
+
+/** Nonblocking custom reduce with the schedule of sc_reduce_custom.
+ * \param [in] target      The MPI rank that obtains the result.
+ * \param [out] request    Completed by sc_coll_test or sc_coll_wait.
+ */
+int                 sc_ireduce_custom (void *sendbuf, void *recvbuf,
+                                       int sendcount, MPI_Datatype sendtype,
+                                       sc_reduce_t reduce_fn, int target,
+                                       MPI_Comm mpicomm,
+                                       sc_coll_request_t ** request);
+
+/** Nonblocking replacement of MPI_Allreduce.
+ * \param [out] request    Completed by sc_coll_test or sc_coll_wait.
+ */
+int                 sc_iallreduce (void *sendbuf, void *recvbuf,
+                                   int sendcount, MPI_Datatype sendtype,
+                                   MPI_Op operation, MPI_Comm mpicomm,
+                                   sc_coll_request_t ** request);
+
+/** Nonblocking replacement of MPI_Reduce.
+ * \param [in] target      The MPI rank that obtains the result.
+ * \param [out] request    Completed by sc_coll_test or sc_coll_wait.
+ */
+int                 sc_ireduce (void *sendbuf, void *recvbuf, int sendcount,
+                                MPI_Datatype sendtype, MPI_Op operation,
+                                int target, MPI_Comm mpicomm,
+                                sc_coll_request_t ** request);
+
 SC_EXTERN_C_END;
 
 #endif /* !SC_REDUCE_H */
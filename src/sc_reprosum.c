@@ -0,0 +1,224 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_reduce.h>
+#include <sc_reprosum.h>
+
+/* normalize well before the limbs may overflow */
+#define SC_REPROSUM_MAX_PENDING (1LL << (62 - SC_REPROSUM_BITS))
+#define SC_REPROSUM_MASK        ((1ULL << SC_REPROSUM_BITS) - 1)
+
+/* the exponent of the least significant bit of limb 0 */
+#define SC_REPROSUM_EMIN        1074
+
+/** Round down x / 2^SC_REPROSUM_BITS without relying on signed shifts. */
+static long long
+sc_reprosum_carry (long long x)
+{
+  return x >= 0 ? x >> SC_REPROSUM_BITS :
+    -((-(x + 1)) >> SC_REPROSUM_BITS) - 1;
+}
+
+/** Propagate the carries such that all limbs but the highest are in
+ * [0, 2^SC_REPROSUM_BITS) and the highest carries the sign.
+ */
+static void
+sc_reprosum_normalize (sc_reprosum_t * sum)
+{
+  int                 i;
+  long long           carry;
+
+  for (i = 0; i < SC_REPROSUM_LIMBS - 1; ++i) {
+    carry = sc_reprosum_carry (sum->limb[i]);
+    sum->limb[i] -= carry * (1LL << SC_REPROSUM_BITS);
+    sum->limb[i + 1] += carry;
+  }
+  sum->pending = 0;
+}
+
+void
+sc_reprosum_init (sc_reprosum_t * sum)
+{
+  memset (sum, 0, sizeof (*sum));
+}
+
+void
+sc_reprosum_add (sc_reprosum_t * sum, double value)
+{
+  int                 e, s, k, r;
+  long long           m;
+  unsigned long long  mag, rest, chunk[3];
+
+  if (value != value) {         /* ignore the comparison warning */
+    ++sum->num_nan;
+    return;
+  }
+  if (value == HUGE_VAL || value == -HUGE_VAL) {
+    ++*(value > 0. ? &sum->num_pinf : &sum->num_ninf);
+    return;
+  }
+  if (value == 0.) {            /* ignore the comparison warning */
+    return;
+  }
+
+  /* value = m * 2^(s - SC_REPROSUM_EMIN) with an integer m */
+  m = (long long) ldexp (frexp (value, &e), 53);
+  s = e - 53 + SC_REPROSUM_EMIN;
+  if (s < 0) {
+    /* the low bits of subnormal numbers are zero */
+    m /= 1LL << -s;
+    s = 0;
+  }
+  mag = (unsigned long long) (m < 0 ? -m : m);
+
+  /* split the shifted mantissa into three limbs */
+  k = s / SC_REPROSUM_BITS;
+  r = s % SC_REPROSUM_BITS;
+  SC_ASSERT (k + 2 < SC_REPROSUM_LIMBS);
+  chunk[0] = (mag << r) & SC_REPROSUM_MASK;
+  rest = mag >> (SC_REPROSUM_BITS - r);
+  chunk[1] = rest & SC_REPROSUM_MASK;
+  chunk[2] = rest >> SC_REPROSUM_BITS;
+  if (m > 0) {
+    sum->limb[k] += (long long) chunk[0];
+    sum->limb[k + 1] += (long long) chunk[1];
+    sum->limb[k + 2] += (long long) chunk[2];
+  }
+  else {
+    sum->limb[k] -= (long long) chunk[0];
+    sum->limb[k + 1] -= (long long) chunk[1];
+    sum->limb[k + 2] -= (long long) chunk[2];
+  }
+
+  if (++sum->pending >= SC_REPROSUM_MAX_PENDING) {
+    sc_reprosum_normalize (sum);
+  }
+}
+
+double
+sc_reprosum_value (const sc_reprosum_t * sum)
+{
+  int                 i, sign, lsb, free_bits;
+  unsigned long long  acc, x, sticky;
+  sc_reprosum_t       s;
+
+  if (sum->num_nan > 0 || (sum->num_pinf > 0 && sum->num_ninf > 0)) {
+    return NAN;
+  }
+  if (sum->num_pinf > 0 || sum->num_ninf > 0) {
+    return sum->num_pinf > 0 ? HUGE_VAL : -HUGE_VAL;
+  }
+
+  s = *sum;
+  sc_reprosum_normalize (&s);
+  sign = 1;
+  if (s.limb[SC_REPROSUM_LIMBS - 1] < 0) {
+    for (i = 0; i < SC_REPROSUM_LIMBS; ++i) {
+      s.limb[i] = -s.limb[i];
+    }
+    sc_reprosum_normalize (&s);
+    sign = -1;
+  }
+
+  /* find the leading limb */
+  for (i = SC_REPROSUM_LIMBS - 1; i >= 0 && s.limb[i] == 0; --i);
+  if (i < 0) {
+    return 0.;
+  }
+
+  /* collect 63 leading bits and a sticky bit for the correct rounding */
+  acc = (unsigned long long) s.limb[i];
+  lsb = i * SC_REPROSUM_BITS;
+  sticky = 0;
+  for (--i; i >= 0; --i) {
+    x = (unsigned long long) s.limb[i];
+    free_bits = 62 - SC_LOG2_64 (acc);
+    if (free_bits >= SC_REPROSUM_BITS) {
+      acc = acc << SC_REPROSUM_BITS | x;
+      lsb -= SC_REPROSUM_BITS;
+    }
+    else {
+      acc = acc << free_bits | x >> (SC_REPROSUM_BITS - free_bits);
+      lsb -= free_bits;
+      sticky = (x & ((1ULL << (SC_REPROSUM_BITS - free_bits)) - 1)) != 0;
+      break;
+    }
+  }
+  for (--i; i >= 0 && !sticky; --i) {
+    sticky = s.limb[i] != 0;
+  }
+
+  return sign * ldexp ((double) (long long) (acc | sticky),
+                       lsb - SC_REPROSUM_EMIN);
+}
+
+void
+sc_reprosum_allreduce (sc_reprosum_t * sums, int num_sums, MPI_Comm mpicomm)
+{
+  int                 mpiret;
+  int                 mpisize;
+  int                 i;
+  sc_reprosum_t      *local;
+
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (mpisize < SC_REPROSUM_MAX_PENDING,
+                  "Too many processes for sc_reprosum_allreduce");
+
+  local = SC_ALLOC (sc_reprosum_t, num_sums);
+  for (i = 0; i < num_sums; ++i) {
+    sc_reprosum_normalize (sums + i);
+  }
+  memcpy (local, sums, num_sums * sizeof (sc_reprosum_t));
+
+  /* the normalized limbs are added without overflow */
+  mpiret = sc_allreduce (local, sums, num_sums * (int)
+                         (sizeof (sc_reprosum_t) / sizeof (long long)),
+                         MPI_LONG_LONG_INT, MPI_SUM, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (i = 0; i < num_sums; ++i) {
+    sums[i].pending = mpisize;
+  }
+
+  SC_FREE (local);
+}
+
+int
+sc_allreduce_reproducible (double *sendbuf, double *recvbuf,
+                           int sendcount, MPI_Comm mpicomm)
+{
+  int                 i;
+  sc_reprosum_t      *sums;
+
+  sums = SC_ALLOC (sc_reprosum_t, sendcount);
+  for (i = 0; i < sendcount; ++i) {
+    sc_reprosum_init (sums + i);
+    sc_reprosum_add (sums + i, sendbuf[i]);
+  }
+  sc_reprosum_allreduce (sums, sendcount, mpicomm);
+  for (i = 0; i < sendcount; ++i) {
+    recvbuf[i] = sc_reprosum_value (sums + i);
+  }
+  SC_FREE (sums);
+
+  return MPI_SUCCESS;
+}
@@ -0,0 +1,87 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+/* Reproducible summation of floating point numbers.
+ *
+ * A sc_reprosum_t holds a sum of doubles exactly as a fixed point number
+ * spanning the whole range of double precision, split into limbs of
+ * SC_REPROSUM_BITS bits.  Since integer addition is associative, the
+ * sum does not depend on the order of the additions, and the rounded
+ * result is bitwise identical for any number of processes and any
+ * reduction tree.  The rounding happens once in sc_reprosum_value.
+ *
+ * Adding a value costs a few integer operations.  The reduction over
+ * processes communicates SC_REPROSUM_LIMBS + 4 integers per sum with
+ * a single sc_allreduce.
+ */
+
+#ifndef SC_REPROSUM_H
+#define SC_REPROSUM_H
+
+#include <sc.h>
+
+/* payload bits of each limb; the rest absorbs carries */
+#define SC_REPROSUM_BITS        40
+
+/* the limbs cover the bits 2^-1074 to 2^1023 with room for a carry */
+#define SC_REPROSUM_LIMBS       54
+
+SC_EXTERN_C_BEGIN;
+
+/** An exact sum of doubles.  All members are private. */
+typedef struct sc_reprosum
+{
+  long long           limb[SC_REPROSUM_LIMBS];
+  long long           num_nan, num_pinf, num_ninf;
+  long long           pending;  /**< Additions since the last carry. */
+}
+sc_reprosum_t;
+
+/** Set a sum to zero. */
+void                sc_reprosum_init (sc_reprosum_t * sum);
+
+/** Add a value to a sum exactly. */
+void                sc_reprosum_add (sc_reprosum_t * sum, double value);
+
+/** Return the sum rounded to the nearest double.
+ * Infinite and NaN summands propagate as in floating point arithmetic.
+ */
+double              sc_reprosum_value (const sc_reprosum_t * sum);
+
+/** Collectively add the sums of all processes in place.
+ * \param [in,out] sums     Array of num_sums sums on every process.
+ */
+void                sc_reprosum_allreduce (sc_reprosum_t * sums,
+                                           int num_sums, MPI_Comm mpicomm);
+
+/** Reproducible replacement of sc_allreduce with MPI_SUM on MPI_DOUBLE.
+ * The result is bitwise identical for any number of processes and
+ * equal to the exact sum rounded once to the nearest double.
+ */
+int                 sc_allreduce_reproducible (double *sendbuf,
+                                               double *recvbuf,
+                                               int sendcount,
+                                               MPI_Comm mpicomm);
+
+SC_EXTERN_C_END;
+
+#endif /* !SC_REPROSUM_H */
@@ -20,52 +20,205 @@
   02110-1301, USA.
 */
 
+#include <sc_reduce.h>
+#include <sc_reprosum.h>
 #include <sc_statistics.h>
 
-#ifdef SC_MPI
+/* each variable is reduced as a record of doubles: count, sum of values,
+ * sum of squares, minimum, maximum, their ranks, mean and deviations */
+#define SC_STATS_RECORD 9
+
+/* the quantile sketch has logarithmic bins of relative accuracy 1%,
+ * that is bin k holds magnitudes in (MIN gamma^(k-1), MIN gamma^k], for
+ * each sign, and one bin in the middle for magnitudes smaller than MIN */
+#define SC_STATS_SKETCH_GAMMA (1.01 / .99)
+#define SC_STATS_SKETCH_MIN 1.e-9
+#define SC_STATS_SKETCH_KEYS 2074
+#define SC_STATS_SKETCH_SIZE (2 * SC_STATS_SKETCH_KEYS + 1)
 
+/** Merge the record of one variable into another. */
 static void
-sc_stats_mpifunc (void *invec, void *inoutvec, int *len,
-                  MPI_Datatype * datatype)
+sc_stats_merge_record (const double *in, double *inout)
 {
-  int                 i;
-  double             *in = (double *) invec;
-  double             *inout = (double *) inoutvec;
-
-  for (i = 0; i < *len; ++i) {
-    /* sum count, values and their squares */
-    inout[0] += in[0];
-    if (in[0]) {                /* ignore statistics when no count */
-      inout[1] += in[1];
-      inout[2] += in[2];
-
-      /* compute minimum and its rank */
-      if (in[3] < inout[3]) {
-        inout[3] = in[3];
-        inout[5] = in[5];
-      }
-      else if (in[3] == inout[3]) {     /* ignore the comparison warning */
-        inout[5] = SC_MIN (in[5], inout[5]);
-      }
+  double              na, nb, delta;
 
-      /* compute maximum and its rank */
-      if (in[4] > inout[4]) {
-        inout[4] = in[4];
-        inout[6] = in[6];
-      }
-      else if (in[4] == inout[4]) {     /* ignore the comparison warning */
-        inout[6] = SC_MIN (in[6], inout[6]);
-      }
+  if (in[0] && !inout[0]) {
+    /* take over statistics into an empty record */
+    memcpy (inout, in, SC_STATS_RECORD * sizeof (double));
+  }
+  else if (in[0]) {             /* ignore statistics when no count */
+    /* merge mean and deviations by the method of Chan et al. */
+    na = inout[0];
+    nb = in[0];
+    delta = in[7] - inout[7];
+    inout[0] = na + nb;
+    inout[7] += delta * (nb / inout[0]);
+    inout[8] += in[8] + delta * delta * (na * nb / inout[0]);
+
+    /* sum values and their squares */
+    inout[1] += in[1];
+    inout[2] += in[2];
+
+    /* compute minimum and its rank */
+    if (in[3] < inout[3]) {
+      inout[3] = in[3];
+      inout[5] = in[5];
+    }
+    else if (in[3] == inout[3]) {       /* ignore the comparison warning */
+      inout[5] = SC_MIN (in[5], inout[5]);
+    }
+
+    /* compute maximum and its rank */
+    if (in[4] > inout[4]) {
+      inout[4] = in[4];
+      inout[6] = in[6];
+    }
+    else if (in[4] == inout[4]) {       /* ignore the comparison warning */
+      inout[6] = SC_MIN (in[6], inout[6]);
     }
+  }
+}
+
+/** Write the record of a variable, which is zero if it has no values.
+ * If the moments are not valid, the mean and deviations are derived
+ * from the sums of values and squares.
+ */
+static void
+sc_stats_pack (const sc_statinfo_t * si, int rank, double *rec)
+{
+  if (!si->dirty || !si->count) {
+    memset (rec, 0, SC_STATS_RECORD * sizeof (*rec));
+    return;
+  }
+  rec[0] = (double) si->count;
+  rec[1] = si->sum_values;
+  rec[2] = si->sum_squares;
+  rec[3] = si->min;
+  rec[4] = si->max;
+  rec[5] = (double) rank;       /* rank that attains minimum */
+  rec[6] = (double) rank;       /* rank that attains maximum */
+  if (si->moments) {
+    rec[7] = si->mean;
+    rec[8] = si->deviations;
+  }
+  else {
+    rec[7] = si->sum_values / (double) si->count;
+    rec[8] = SC_MAX (si->sum_squares - si->sum_values * rec[7], 0.);
+  }
+}
+
+/** Read the record of a variable with a positive count. */
+static void
+sc_stats_unpack (const double *rec, sc_statinfo_t * si)
+{
+  SC_ASSERT (rec[0] > 0.);
+  si->count = (long) rec[0];
+  si->sum_values = rec[1];
+  si->sum_squares = rec[2];
+  si->min = rec[3];
+  si->max = rec[4];
+  si->min_at_rank = (int) rec[5];
+  si->max_at_rank = (int) rec[6];
+  si->mean = rec[7];
+  si->deviations = rec[8];
+}
+
+/** Combine the data of all variables as prepared by sc_stats_compute.
+ * The data begins with the number of variables and of sketches,
+ * followed by one record per variable and then the sketches.
+ */
+static void
+sc_stats_combine (const double *in, double *inout)
+{
+  int                 i, nvars;
+  size_t              zz, nbins;
+
+  SC_ASSERT (in[0] == inout[0] && in[1] == inout[1]);
+  nvars = (int) in[0];
+  nbins = (size_t) in[1] * SC_STATS_SKETCH_SIZE;
+  in += 2;
+  inout += 2;
+
+  for (i = 0; i < nvars; ++i) {
+    sc_stats_merge_record (in, inout);
 
     /* advance to next data set */
-    in += 7;
-    inout += 7;
+    in += SC_STATS_RECORD;
+    inout += SC_STATS_RECORD;
+  }
+
+  /* the sketches are merged exactly by adding the bins */
+  for (zz = 0; zz < nbins; ++zz) {
+    inout[zz] += in[zz];
+  }
+}
+
+#ifdef SC_MPI
+
+static void
+sc_stats_mpifunc (void *invec, void *inoutvec, int *len,
+                  MPI_Datatype * datatype)
+{
+  /* the datatype spans all variables, nonblocking reductions may call
+     the operation without data */
+  SC_ASSERT (*len == 0 || *len == 1);
+  if (*len == 1) {
+    sc_stats_combine ((const double *) invec, (double *) inoutvec);
   }
 }
 
+#else
+
+/* without MPI the data is reduced as plain doubles */
+static void
+sc_stats_reduce (void *sendbuf, void *recvbuf, int sendcount,
+                 MPI_Datatype sendtype)
+{
+  SC_ASSERT (sendtype == MPI_DOUBLE && sendcount >= 2);
+  sc_stats_combine ((const double *) sendbuf, (double *) recvbuf);
+}
+
 #endif /* SC_MPI */
 
+/** Return the bin of the quantile sketch for a value. */
+static int
+sc_stats_sketch_bin (double value)
+{
+  int                 key;
+  double              magnitude;
+
+  magnitude = fabs (value);
+  if (!(magnitude >= SC_STATS_SKETCH_MIN)) {
+    return SC_STATS_SKETCH_KEYS;
+  }
+  key = (int) ceil (log (magnitude / SC_STATS_SKETCH_MIN) /
+                    log (SC_STATS_SKETCH_GAMMA));
+  key = SC_MIN (key, SC_STATS_SKETCH_KEYS - 1);
+
+  return value > 0. ? SC_STATS_SKETCH_KEYS + 1 + key :
+    SC_STATS_SKETCH_KEYS - 1 - key;
+}
+
+/** Return the value that represents a bin of the quantile sketch.
+ * This is the midpoint in relative terms of the bin's magnitudes.
+ */
+static double
+sc_stats_sketch_value (int bin)
+{
+  int                 key;
+  double              magnitude;
+
+  if (bin == SC_STATS_SKETCH_KEYS) {
+    return 0.;
+  }
+  key = bin > SC_STATS_SKETCH_KEYS ? bin - SC_STATS_SKETCH_KEYS - 1 :
+    SC_STATS_SKETCH_KEYS - 1 - bin;
+  magnitude = SC_STATS_SKETCH_MIN * 2. *
+    pow (SC_STATS_SKETCH_GAMMA, (double) key) / (SC_STATS_SKETCH_GAMMA + 1.);
+
+  return bin > SC_STATS_SKETCH_KEYS ? magnitude : -magnitude;
+}
+
 void
 sc_stats_set1 (sc_statinfo_t * stats, double value, const char *variable)
 {
@@ -75,6 +228,10 @@ sc_stats_set1 (sc_statinfo_t * stats, double value, const char *variable)
   stats->sum_squares = value * value;
   stats->min = value;
   stats->max = value;
+  stats->mean = value;
+  stats->deviations = 0.;
+  stats->moments = 1;
+  stats->sketch = NULL;
   stats->variable = variable;
 }
 
@@ -83,19 +240,59 @@ sc_stats_init (sc_statinfo_t * stats, const char *variable)
 {
   stats->dirty = 1;
   stats->count = 0;
+  stats->moments = 0;
+  stats->sketch = NULL;
   stats->variable = variable;
 }
 
+void
+sc_stats_init_quantiles (sc_statinfo_t * stats, const char *variable)
+{
+  sc_stats_init (stats, variable);
+  stats->sketch = SC_ALLOC_ZERO (double, SC_STATS_SKETCH_SIZE);
+}
+
+void
+sc_stats_free_quantiles (sc_statinfo_t * stats)
+{
+  if (stats->sketch != NULL) {
+    SC_FREE (stats->sketch);
+    stats->sketch = NULL;
+  }
+}
+
+/** Begin to maintain the mean and deviations of a variable.
+ * If they are not valid, they are derived from the sums.
+ */
+static void
+sc_stats_track (sc_statinfo_t * si)
+{
+  if (!si->moments && si->count) {
+    si->mean = si->sum_values / (double) si->count;
+    si->deviations = SC_MAX (si->sum_squares - si->sum_values * si->mean,
+                             0.);
+  }
+  si->moments = 1;
+}
+
 void
 sc_stats_accumulate (sc_statinfo_t * stats, double value)
 {
+  double              delta;
+
   SC_ASSERT (stats->dirty);
+  sc_stats_track (stats);
   if (stats->count) {
     stats->count++;
     stats->sum_values += value;
     stats->sum_squares += value * value;
     stats->min = SC_MIN (stats->min, value);
     stats->max = SC_MAX (stats->max, value);
+
+    /* Welford's update of the mean and squared deviations */
+    delta = value - stats->mean;
+    stats->mean += delta / (double) stats->count;
+    stats->deviations += delta * (value - stats->mean);
   }
   else {
     stats->count = 1;
@@ -103,92 +300,303 @@ sc_stats_accumulate (sc_statinfo_t * stats, double value)
     stats->sum_squares = value * value;
     stats->min = value;
     stats->max = value;
+    stats->mean = value;
+    stats->deviations = 0.;
+  }
+  if (stats->sketch != NULL) {
+    stats->sketch[sc_stats_sketch_bin (value)] += 1.;
   }
 }
 
 void
-sc_stats_compute (MPI_Comm mpicomm, int nvars, sc_statinfo_t * stats)
+sc_stats_merge (sc_statinfo_t * stats, const sc_statinfo_t * other)
 {
-  int                 i;
+  int                 bin;
+  double              rec[SC_STATS_RECORD], orec[SC_STATS_RECORD];
+  const double       *osketch = other->sketch;
+
+  SC_ASSERT (stats->dirty && other->dirty);
+  sc_stats_track (stats);
+  SC_ASSERT ((stats->sketch == NULL) == (osketch == NULL));
+  if (!other->count) {
+    return;
+  }
+
+  sc_stats_pack (stats, 0, rec);
+  sc_stats_pack (other, 0, orec);
+  sc_stats_merge_record (orec, rec);
+  sc_stats_unpack (rec, stats);
+  if (stats->sketch != NULL && osketch != NULL) {
+    for (bin = 0; bin < SC_STATS_SKETCH_SIZE; ++bin) {
+      stats->sketch[bin] += osketch[bin];
+    }
+  }
+}
+
+double
+sc_stats_quantile (const sc_statinfo_t * stats, double q)
+{
+  int                 bin;
+  double              rank, cumulative;
+  const double       *sketch = stats->sketch;
+
+  SC_ASSERT (sketch != NULL && stats->count > 0);
+
+  /* the extreme quantiles are known exactly */
+  if (q <= 0.) {
+    return stats->min;
+  }
+  if (q >= 1.) {
+    return stats->max;
+  }
+
+  /* find the bin that contains the value of this rank */
+  rank = floor (q * (double) (stats->count - 1));
+  cumulative = 0.;
+  for (bin = 0; bin < SC_STATS_SKETCH_SIZE - 1; ++bin) {
+    cumulative += sketch[bin];
+    if (cumulative > rank) {
+      break;
+    }
+  }
+
+  return SC_MAX (stats->min, SC_MIN (stats->max,
+                                     sc_stats_sketch_value (bin)));
+}
+
+/** Compute the statistical measures from the global data. */
+static void
+sc_stats_derive (sc_statinfo_t * si)
+{
+  double              cnt;
+
+  cnt = (double) si->count;
+  si->average = si->mean;
+  si->variance = SC_MAX (si->deviations / cnt, 0.);
+  si->variance_mean = si->variance / cnt;
+  si->standev = sqrt (si->variance);
+  si->standev_mean = sqrt (si->variance_mean);
+}
+
+/* variables of one or more sets under reduction */
+struct sc_stats_pending
+{
+  MPI_Comm            mpicomm;
+  int                 nvars;
+  sc_statinfo_t     **vars;
+  size_t              total;
+  double             *flat;
+#if defined SC_MPI && MPI_VERSION >= 3
+  MPI_Request         request;
+#endif
+};
+
+#ifdef SC_MPI
+
+/* the operation and the datatype of the last size are cached */
+static MPI_Op       sc_stats_op = MPI_OP_NULL;
+static MPI_Datatype sc_stats_type = MPI_DATATYPE_NULL;
+static int          sc_stats_type_count = 0;
+static int          sc_stats_keyval = MPI_KEYVAL_INVALID;
+
+/** Release the cached objects, called when MPI_Finalize frees MPI_COMM_SELF.
+ */
+static int
+sc_stats_delete_fn (MPI_Comm comm, int keyval, void *attr, void *extra)
+{
+  int                 mpiret;
+
+  if (sc_stats_type != MPI_DATATYPE_NULL) {
+    mpiret = MPI_Type_free (&sc_stats_type);
+    SC_CHECK_MPI (mpiret);
+    sc_stats_type = MPI_DATATYPE_NULL;
+    sc_stats_type_count = 0;
+  }
+  if (sc_stats_op != MPI_OP_NULL) {
+    mpiret = MPI_Op_free (&sc_stats_op);
+    SC_CHECK_MPI (mpiret);
+    sc_stats_op = MPI_OP_NULL;
+  }
+
+  return MPI_SUCCESS;
+}
+
+/** Return the cached datatype that spans count doubles.
+ * A pending reduction is not affected when the datatype is replaced,
+ * since MPI defers freeing it until all communication has completed.
+ */
+static MPI_Datatype
+sc_stats_datatype (int count)
+{
+  int                 mpiret;
+
+  if (sc_stats_op == MPI_OP_NULL) {
+    mpiret = MPI_Op_create ((MPI_User_function *) sc_stats_mpifunc, 1,
+                            &sc_stats_op);
+    SC_CHECK_MPI (mpiret);
+
+    if (sc_stats_keyval == MPI_KEYVAL_INVALID) {
+      mpiret = MPI_Comm_create_keyval (MPI_COMM_NULL_COPY_FN,
+                                       sc_stats_delete_fn,
+                                       &sc_stats_keyval, NULL);
+      SC_CHECK_MPI (mpiret);
+    }
+    mpiret = MPI_Comm_set_attr (MPI_COMM_SELF, sc_stats_keyval, NULL);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  if (count != sc_stats_type_count) {
+    if (sc_stats_type != MPI_DATATYPE_NULL) {
+      mpiret = MPI_Type_free (&sc_stats_type);
+      SC_CHECK_MPI (mpiret);
+    }
+    mpiret = MPI_Type_contiguous (count, MPI_DOUBLE, &sc_stats_type);
+    SC_CHECK_MPI (mpiret);
+
+    mpiret = MPI_Type_commit (&sc_stats_type);
+    SC_CHECK_MPI (mpiret);
+    sc_stats_type_count = count;
+  }
+
+  return sc_stats_type;
+}
+
+#endif /* SC_MPI */
+
+sc_stats_pending_t *
+sc_stats_compute_begin (MPI_Comm mpicomm, int nsets, const int *nvars,
+                        sc_statinfo_t ** stats)
+{
+  int                 i, j, k;
   int                 mpiret;
   int                 rank;
-  double              cnt, avg;
-  double             *flat;
-  double             *flatin;
-  double             *flatout;
+  int                 nsketches;
+  double             *flatin, *recin, *sketchin;
+  sc_statinfo_t      *si;
+  sc_stats_pending_t *pending;
 #ifdef SC_MPI
-  MPI_Op              op;
   MPI_Datatype        ctype;
 #endif
 
   mpiret = MPI_Comm_rank (mpicomm, &rank);
   SC_CHECK_MPI (mpiret);
 
-  flat = SC_ALLOC (double, 2 * 7 * nvars);
-  flatin = flat;
-  flatout = flat + 7 * nvars;
-
-  for (i = 0; i < nvars; ++i) {
-    if (!stats[i].dirty) {
-      memset (flatin + 7 * i, 0, 7 * sizeof (*flatin));
-      continue;
+  pending = SC_ALLOC (sc_stats_pending_t, 1);
+  pending->mpicomm = mpicomm;
+  pending->nvars = 0;
+  for (k = 0; k < nsets; ++k) {
+    pending->nvars += nvars[k];
+  }
+  pending->vars = SC_ALLOC (sc_statinfo_t *, pending->nvars);
+
+  /* sketches are present on all processes or none */
+  nsketches = 0;
+  for (k = i = 0; k < nsets; ++k) {
+    for (j = 0; j < nvars[k]; ++j, ++i) {
+      pending->vars[i] = si = stats[k] + j;
+      nsketches += (si->sketch != NULL);
+    }
+  }
+  pending->total = 2 + (size_t) pending->nvars * SC_STATS_RECORD +
+    (size_t) nsketches * SC_STATS_SKETCH_SIZE;
+
+  pending->flat = SC_ALLOC (double, 2 * pending->total);
+  flatin = pending->flat;
+  flatin[0] = (double) pending->nvars;
+  flatin[1] = (double) nsketches;
+
+  recin = flatin + 2;
+  sketchin = recin + pending->nvars * SC_STATS_RECORD;
+  for (i = 0; i < pending->nvars; ++i, recin += SC_STATS_RECORD) {
+    si = pending->vars[i];
+    sc_stats_pack (si, rank, recin);
+    if (si->sketch != NULL) {
+      if (recin[0]) {
+        memcpy (sketchin, si->sketch,
+                SC_STATS_SKETCH_SIZE * sizeof (*sketchin));
+      }
+      else {
+        memset (sketchin, 0, SC_STATS_SKETCH_SIZE * sizeof (*sketchin));
+      }
+      sketchin += SC_STATS_SKETCH_SIZE;
     }
-    flatin[7 * i + 0] = (double) stats[i].count;
-    flatin[7 * i + 1] = stats[i].sum_values;
-    flatin[7 * i + 2] = stats[i].sum_squares;
-    flatin[7 * i + 3] = stats[i].min;
-    flatin[7 * i + 4] = stats[i].max;
-    flatin[7 * i + 5] = (double) rank;  /* rank that attains minimum */
-    flatin[7 * i + 6] = (double) rank;  /* rank that attains maximum */
   }
 
 #ifndef SC_MPI
-  memcpy (flatout, flatin, 7 * nvars * sizeof (*flatout));
-#else
-  mpiret = MPI_Type_contiguous (7, MPI_DOUBLE, &ctype);
+  mpiret = sc_allreduce_custom (flatin, flatin + pending->total,
+                                (int) pending->total, MPI_DOUBLE,
+                                sc_stats_reduce, mpicomm);
   SC_CHECK_MPI (mpiret);
-
-  mpiret = MPI_Type_commit (&ctype);
-  SC_CHECK_MPI (mpiret);
-
-  mpiret = MPI_Op_create ((MPI_User_function *) sc_stats_mpifunc, 1, &op);
+#else
+  ctype = sc_stats_datatype ((int) pending->total);
+#if MPI_VERSION >= 3
+  mpiret = MPI_Iallreduce (flatin, flatin + pending->total, 1, ctype,
+                           sc_stats_op, mpicomm, &pending->request);
+#else
+  mpiret = MPI_Allreduce (flatin, flatin + pending->total, 1, ctype,
+                          sc_stats_op, mpicomm);
+#endif
   SC_CHECK_MPI (mpiret);
+#endif /* SC_MPI */
 
-  mpiret = MPI_Allreduce (flatin, flatout, nvars, ctype, op, mpicomm);
-  SC_CHECK_MPI (mpiret);
+  return pending;
+}
 
-  mpiret = MPI_Op_free (&op);
-  SC_CHECK_MPI (mpiret);
+void
+sc_stats_compute_end (sc_stats_pending_t * pending)
+{
+  int                 i, j;
+#ifdef SC_DEBUG
+  int                 nsketches;
+#endif
+  double             *flatout, *recout, *sketchout;
+  sc_statinfo_t      *si;
+#if defined SC_MPI && MPI_VERSION >= 3
+  int                 mpiret;
 
-  mpiret = MPI_Type_free (&ctype);
+  mpiret = MPI_Wait (&pending->request, MPI_STATUS_IGNORE);
   SC_CHECK_MPI (mpiret);
-#endif /* SC_MPI */
+#endif
 
-  for (i = 0; i < nvars; ++i) {
-    if (!stats[i].dirty) {
+  flatout = pending->flat + pending->total;
+#ifdef SC_DEBUG
+  nsketches = (int) flatout[1];
+#endif
+  recout = flatout + 2;
+  sketchout = recout + pending->nvars * SC_STATS_RECORD;
+  for (i = j = 0; i < pending->nvars; ++i, recout += SC_STATS_RECORD) {
+    si = pending->vars[i];
+    if (si->sketch != NULL) {
+      if (si->dirty) {
+        memcpy (si->sketch, sketchout + j * SC_STATS_SKETCH_SIZE,
+                SC_STATS_SKETCH_SIZE * sizeof (*sketchout));
+      }
+      ++j;
+    }
+    if (!si->dirty) {
       continue;
     }
-    cnt = flatout[7 * i + 0];
-    stats[i].count = (long) cnt;
-    if (!cnt) {
+    if (!recout[0]) {
+      si->count = 0;
       continue;
     }
-    stats[i].sum_values = flatout[7 * i + 1];
-    stats[i].sum_squares = flatout[7 * i + 2];
-    stats[i].min = flatout[7 * i + 3];
-    stats[i].max = flatout[7 * i + 4];
-    stats[i].min_at_rank = (int) flatout[7 * i + 5];
-    stats[i].max_at_rank = (int) flatout[7 * i + 6];
-    stats[i].average = avg = stats[i].sum_values / cnt;
-    stats[i].variance = stats[i].sum_squares / cnt - avg * avg;
-    stats[i].variance = SC_MAX (stats[i].variance, 0.);
-    stats[i].variance_mean = stats[i].variance / cnt;
-    stats[i].standev = sqrt (stats[i].variance);
-    stats[i].standev_mean = sqrt (stats[i].variance_mean);
-    stats[i].dirty = 0;
+    sc_stats_unpack (recout, si);
+    sc_stats_derive (si);
+    si->moments = 0;
+    si->dirty = 0;
   }
+  SC_ASSERT (j == nsketches);
+
+  SC_FREE (pending->flat);
+  SC_FREE (pending->vars);
+  SC_FREE (pending);
+}
 
-  SC_FREE (flat);
+void
+sc_stats_compute (MPI_Comm mpicomm, int nvars, sc_statinfo_t * stats)
+{
+  sc_stats_compute_end (sc_stats_compute_begin (mpicomm, 1, &nvars,
+                                                &stats));
 }
 
 void
@@ -196,19 +604,66 @@ sc_stats_compute1 (MPI_Comm mpicomm, int nvars, sc_statinfo_t * stats)
 {
   int                 i;
   double              value;
+  double             *sketch;
 
   for (i = 0; i < nvars; ++i) {
     value = stats[i].sum_values;
+    sketch = stats[i].sketch;
 
     stats[i].count = 1;
     stats[i].sum_squares = value * value;
     stats[i].min = value;
     stats[i].max = value;
+    stats[i].mean = value;
+    stats[i].deviations = 0.;
+    stats[i].moments = 1;
+    if (sketch != NULL) {
+      memset (sketch, 0, SC_STATS_SKETCH_SIZE * sizeof (double));
+      sketch[sc_stats_sketch_bin (value)] = 1.;
+    }
   }
 
   sc_stats_compute (mpicomm, nvars, stats);
 }
 
+void
+sc_stats_compute_reproducible (MPI_Comm mpicomm, int nvars,
+                               sc_statinfo_t * stats)
+{
+  int                 i;
+  int                *dirty;
+  sc_reprosum_t      *sums;
+
+  dirty = SC_ALLOC (int, nvars);
+  sums = SC_ALLOC (sc_reprosum_t, 2 * nvars);
+  for (i = 0; i < nvars; ++i) {
+    dirty[i] = stats[i].dirty;
+    sc_reprosum_init (sums + 2 * i);
+    sc_reprosum_init (sums + 2 * i + 1);
+    if (stats[i].dirty && stats[i].count > 0) {
+      sc_reprosum_add (sums + 2 * i, stats[i].sum_values);
+      sc_reprosum_add (sums + 2 * i + 1, stats[i].sum_squares);
+    }
+  }
+  sc_reprosum_allreduce (sums, 2 * nvars, mpicomm);
+
+  /* counts, minima and maxima do not depend on the order anyway */
+  sc_stats_compute (mpicomm, nvars, stats);
+  for (i = 0; i < nvars; ++i) {
+    if (dirty[i] && stats[i].count > 0) {
+      stats[i].sum_values = sc_reprosum_value (sums + 2 * i);
+      stats[i].sum_squares = sc_reprosum_value (sums + 2 * i + 1);
+      stats[i].mean = stats[i].sum_values / (double) stats[i].count;
+      stats[i].deviations =
+        stats[i].sum_squares - stats[i].sum_values * stats[i].mean;
+      sc_stats_derive (stats + i);
+    }
+  }
+
+  SC_FREE (sums);
+  SC_FREE (dirty);
+}
+
 void
 sc_stats_print (int package_id, int log_priority,
                 int nvars, sc_statinfo_t * stats, int full, int summary)
@@ -250,6 +705,12 @@ sc_stats_print (int package_id, int log_priority,
       SC_GEN_LOGF (package_id, SC_LC_GLOBAL, log_priority,
                    "   Maximum attained at rank %5d: %g\n",
                    si->max_at_rank, si->max);
+      if (si->sketch != NULL) {
+        SC_GEN_LOGF (package_id, SC_LC_GLOBAL, log_priority,
+                     "   Quantiles p50 p90 p99:          %g %g %g\n",
+                     sc_stats_quantile (si, .5), sc_stats_quantile (si, .9),
+                     sc_stats_quantile (si, .99));
+      }
     }
   }
   else {
@@ -272,6 +733,12 @@ sc_stats_print (int package_id, int log_priority,
                      "Mean (sigma) %-28s %g (%.3g)\n", buffer,
                      si->average, si->standev);
       }
+      if (si->sketch != NULL && si->count) {
+        SC_GEN_LOGF (package_id, SC_LC_GLOBAL, log_priority,
+                     "p50 p90 p99  %-28s %g %g %g\n", buffer,
+                     sc_stats_quantile (si, .5), sc_stats_quantile (si, .9),
+                     sc_stats_quantile (si, .99));
+      }
     }
   }
 
@@ -309,13 +776,19 @@ sc_statistics_new (MPI_Comm mpicomm)
 void
 sc_statistics_destroy (sc_statistics_t * stats)
 {
+  size_t              zz;
+
+  for (zz = 0; zz < stats->sarray->elem_count; ++zz) {
+    sc_stats_free_quantiles ((sc_statinfo_t *)
+                             sc_array_index (stats->sarray, zz));
+  }
   sc_keyvalue_destroy (stats->kv);
   sc_array_destroy (stats->sarray);
 
   SC_FREE (stats);
 }
 
-void
+int
 sc_statistics_add (sc_statistics_t * stats, const char *name)
 {
   int                 i;
@@ -330,12 +803,15 @@ sc_statistics_add (sc_statistics_t * stats, const char *name)
   sc_stats_set1 (si, 0, name);
 
   sc_keyvalue_set_int (stats->kv, name, i);
+
+  return i;
 }
 
 void
 sc_statistics_set (sc_statistics_t * stats, const char *name, double value)
 {
   int                 i;
+  double             *sketch;
   sc_statinfo_t      *si;
 
   i = sc_keyvalue_get_int (stats->kv, name, -1);
@@ -345,10 +821,20 @@ sc_statistics_set (sc_statistics_t * stats, const char *name, double value)
 
   si = (sc_statinfo_t *) sc_array_index_int (stats->sarray, i);
 
-  sc_stats_set1 (si, value, name);
+  sketch = si->sketch;
+  if (sketch != NULL) {
+    /* keep the sketch and let it contain only this value */
+    memset (sketch, 0, SC_STATS_SKETCH_SIZE * sizeof (double));
+    sc_stats_init (si, name);
+    si->sketch = sketch;
+    sc_stats_accumulate (si, value);
+  }
+  else {
+    sc_stats_set1 (si, value, name);
+  }
 }
 
-void
+int
 sc_statistics_add_empty (sc_statistics_t * stats, const char *name)
 {
   int                 i;
@@ -363,6 +849,40 @@ sc_statistics_add_empty (sc_statistics_t * stats, const char *name)
   sc_stats_init (si, name);
 
   sc_keyvalue_set_int (stats->kv, name, i);
+
+  return i;
+}
+
+int
+sc_statistics_add_quantiles (sc_statistics_t * stats, const char *name)
+{
+  int                 i;
+  sc_statinfo_t      *si;
+
+  /* always check for wrong usage and output adequate error message */
+  SC_CHECK_ABORTF (!sc_keyvalue_exists (stats->kv, name),
+                   "Statistics variable \"%s\" exists already", name);
+
+  i = (int) stats->sarray->elem_count;
+  si = (sc_statinfo_t *) sc_array_push (stats->sarray);
+  sc_stats_init_quantiles (si, name);
+
+  sc_keyvalue_set_int (stats->kv, name, i);
+
+  return i;
+}
+
+int
+sc_statistics_id (sc_statistics_t * stats, const char *name)
+{
+  int                 i;
+
+  i = sc_keyvalue_get_int (stats->kv, name, -1);
+
+  /* always check for wrong usage and output adequate error message */
+  SC_CHECK_ABORTF (i >= 0, "Statistics variable \"%s\" does not exist", name);
+
+  return i;
 }
 
 void
@@ -389,6 +909,89 @@ sc_statistics_compute (sc_statistics_t * stats)
                     (sc_statinfo_t *) stats->sarray->array);
 }
 
+sc_statistics_local_t *
+sc_statistics_local_new (sc_statistics_t * stats)
+{
+  size_t              zz;
+  sc_statinfo_t      *si, *li;
+  sc_statistics_local_t *local;
+
+  local = SC_ALLOC (sc_statistics_local_t, 1);
+  local->stats = stats;
+  local->sarray = sc_array_new_size (sizeof (sc_statinfo_t),
+                                     stats->sarray->elem_count);
+  for (zz = 0; zz < stats->sarray->elem_count; ++zz) {
+    si = (sc_statinfo_t *) sc_array_index (stats->sarray, zz);
+    li = (sc_statinfo_t *) sc_array_index (local->sarray, zz);
+    if (si->sketch != NULL) {
+      sc_stats_init_quantiles (li, si->variable);
+    }
+    else {
+      sc_stats_init (li, si->variable);
+    }
+  }
+
+  return local;
+}
+
+void
+sc_statistics_local_merge (sc_statistics_local_t * local)
+{
+  size_t              zz;
+  sc_statinfo_t      *li;
+
+  SC_ASSERT (local->sarray->elem_count <= local->stats->sarray->elem_count);
+  for (zz = 0; zz < local->sarray->elem_count; ++zz) {
+    li = (sc_statinfo_t *) sc_array_index (local->sarray, zz);
+    sc_stats_merge ((sc_statinfo_t *)
+                    sc_array_index (local->stats->sarray, zz), li);
+
+    /* empty the variable of the buffer */
+    li->count = 0;
+    if (li->sketch != NULL) {
+      memset (li->sketch, 0, SC_STATS_SKETCH_SIZE * sizeof (double));
+    }
+  }
+}
+
+void
+sc_statistics_local_destroy (sc_statistics_local_t * local)
+{
+  size_t              zz;
+
+  for (zz = 0; zz < local->sarray->elem_count; ++zz) {
+    sc_stats_free_quantiles ((sc_statinfo_t *)
+                             sc_array_index (local->sarray, zz));
+  }
+  sc_array_destroy (local->sarray);
+
+  SC_FREE (local);
+}
+
+sc_stats_pending_t *
+sc_statistics_compute_begin (int nsets, sc_statistics_t ** stats)
+{
+  int                 k;
+  int                *nvars;
+  sc_statinfo_t     **sets;
+  sc_stats_pending_t *pending;
+
+  SC_ASSERT (nsets >= 1);
+
+  nvars = SC_ALLOC (int, nsets);
+  sets = SC_ALLOC (sc_statinfo_t *, nsets);
+  for (k = 0; k < nsets; ++k) {
+    SC_ASSERT (stats[k]->mpicomm == stats[0]->mpicomm);
+    nvars[k] = (int) stats[k]->sarray->elem_count;
+    sets[k] = (sc_statinfo_t *) stats[k]->sarray->array;
+  }
+  pending = sc_stats_compute_begin (stats[0]->mpicomm, nsets, nvars, sets);
+  SC_FREE (sets);
+  SC_FREE (nvars);
+
+  return pending;
+}
+
 void
 sc_statistics_print (sc_statistics_t * stats,
                      int package_id, int log_priority, int full, int summary)
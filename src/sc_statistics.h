@@ -28,12 +28,19 @@
 
 SC_EXTERN_C_BEGIN;
 
-/* sc_statinfo_t stores information for one random variable */
+/* sc_statinfo_t stores information for one random variable.
+ * It may also be filled by hand with dirty, count, sum_values,
+ * sum_squares, min and max, after sc_stats_init or in zeroed memory.
+ * Then moments is false, the mean and deviations are derived from the
+ * sums and the variable has no quantile sketch. */
 typedef struct sc_statinfo
 {
   int                 dirty;    /* only update stats if this is true */
   long                count;    /* inout, global count is 52bit accurate */
   double              sum_values, sum_squares, min, max;        /* inout */
+  double              mean, deviations;  /* inout, see sc_stats_accumulate */
+  int                 moments;  /* inout, true if mean, deviations valid */
+  double             *sketch;   /* inout, NULL or a quantile sketch */
   int                 min_at_rank, max_at_rank; /* out */
   double              average, variance, standev;       /* out */
   double              variance_mean, standev_mean;      /* out */
@@ -41,6 +48,9 @@ typedef struct sc_statinfo
 }
 sc_statinfo_t;
 
+/* sc_stats_pending_t holds statistics under computation */
+typedef struct sc_stats_pending sc_stats_pending_t;
+
 /* sc_statistics_t allows dynamically adding random variables */
 typedef struct sc_stats
 {
@@ -50,8 +60,17 @@ typedef struct sc_stats
 }
 sc_statistics_t;
 
+/* sc_statistics_local_t collects the values of one thread */
+typedef struct sc_statistics_local
+{
+  sc_statistics_t    *stats;
+  sc_array_t         *sarray;
+}
+sc_statistics_local_t;
+
 /**
  * Populate a sc_statinfo_t structure assuming count=1 and mark it dirty.
+ * The sketch field is overwritten with NULL, see sc_stats_init.
  */
 void                sc_stats_set1 (sc_statinfo_t * stats,
                                    double value, const char *variable);
@@ -60,15 +79,60 @@ void                sc_stats_set1 (sc_statinfo_t * stats,
  * Initialize a sc_statinfo_t structure assuming count=0 and mark it dirty.
  * This is useful if \a stats will be used to accumulate instances locally
  * before global statistics are computed.
+ * The sketch field is overwritten with NULL and the moments are marked as
+ * not valid.  A sketch held on input is not freed: it belongs to the
+ * caller, who releases it before with sc_stats_free_quantiles.
  */
 void                sc_stats_init (sc_statinfo_t * stats,
                                    const char *variable);
 
+/**
+ * Initialize like sc_stats_init and allocate a quantile sketch.
+ * The sketch is a histogram with logarithmically spaced bins that
+ * answers quantile queries with a relative error of at most 1% for
+ * magnitudes between 1e-9 and 1e9, which takes 33 kB of memory.
+ * Smaller magnitudes are treated as zero and larger ones are clamped.
+ * Sketches are merged exactly by sc_stats_compute, which requires that
+ * all processes have a sketch for the same variables.
+ * The sketch must be released with sc_stats_free_quantiles.
+ */
+void                sc_stats_init_quantiles (sc_statinfo_t * stats,
+                                             const char *variable);
+
+/**
+ * Release the quantile sketch of a variable if it has one.
+ */
+void                sc_stats_free_quantiles (sc_statinfo_t * stats);
+
 /**
  * Add an instance of the random variable.
+ * Besides the sums of values and squares this updates the running mean
+ * and the sum of squared deviations from it by Welford's method, which
+ * does not suffer from cancellation for large means.  If the variable
+ * has a quantile sketch, the value is added to it.  If the moments are
+ * not valid, the running mean is begun from the sums.
  */
 void                sc_stats_accumulate (sc_statinfo_t * stats, double value);
 
+/**
+ * Merge the values of one variable into another.
+ * Both must be dirty and have a quantile sketch or not.
+ * \param [in,out] stats    The values of other are added.
+ * \param [in] other        Variable that is not changed.
+ */
+void                sc_stats_merge (sc_statinfo_t * stats,
+                                    const sc_statinfo_t * other);
+
+/**
+ * Estimate a quantile from the sketch of a variable.
+ * After sc_stats_compute the estimate is for the global values.
+ * \param [in] stats    Variable with a sketch and positive count.
+ * \param [in] q        Number between 0 and 1, such as .5 for the median.
+ * \return              Quantile with relative error of at most 1%,
+ *                      clamped to the minimum and maximum values.
+ */
+double              sc_stats_quantile (const sc_statinfo_t * stats, double q);
+
 /**
  * Compute global average and standard deviation.
  * Only updates dirty variables. Then removes the dirty flag.
@@ -80,12 +144,23 @@ void                sc_stats_accumulate (sc_statinfo_t * stats, double value);
  *    sum_values    Sum of values for each process.
  *    sum_squares   Sum of squares for each process.
  *    min, max      Minimum and maximum of values for each process.
+ *    mean          Mean of values for each process.
+ *    deviations    Sum of squared deviations from the mean.
+ *    moments       True if mean and deviations are valid, otherwise
+ *                  they are derived from the sums.
+ *    sketch        Quantile sketch for each process, or NULL.
  *    variable      String describing the variable, or NULL.
+ * These are set by sc_stats_set1, sc_stats_init and sc_stats_accumulate.
+ * The means and deviations are merged by the method of Chan et al.
+ * and all data is combined in a single reduction.
  * On output, the fields have the following meaning.
  *    count                        Global number of values.
  *    sum_values                   Global sum of values.
  *    sum_squares                  Global sum of squares.
  *    min, max                     Global minimum and maximum values.
+ *    mean, deviations             Global mean and squared deviations.
+ *    moments                      False, since the values are global.
+ *    sketch                       Global quantile sketch, or NULL.
  *    min_at_rank, max_at_rank     The ranks that attain min and max.
  *    average, variance, standev   Global statistical measures.
  *    variance_mean, standev_mean  Statistical measures of the mean.
@@ -93,11 +168,50 @@ void                sc_stats_accumulate (sc_statinfo_t * stats, double value);
 void                sc_stats_compute (MPI_Comm mpicomm, int nvars,
                                       sc_statinfo_t * stats);
 
+/**
+ * Begin to compute the statistics of several sets of variables.
+ * All variables of all sets are reduced in a single collective call,
+ * for example those of several sc_statistics_t or of several steps.
+ * With MPI 3 the reduction is nonblocking to overlap it with computation,
+ * otherwise it completes before this function returns.
+ * The MPI operation and datatype are cached between calls.
+ * The variables must not be accessed until sc_stats_compute_end.
+ * \param [in]     mpicomm   MPI communicator to use.
+ * \param [in]     nsets     Number of sets of variables.
+ * \param [in]     nvars     Number of variables for each set.
+ * \param [in,out] stats     Array of variables for each set,
+ *                           see sc_stats_compute.
+ * \return                   Handle to pass to sc_stats_compute_end.
+ */
+sc_stats_pending_t *sc_stats_compute_begin (MPI_Comm mpicomm, int nsets,
+                                            const int *nvars,
+                                            sc_statinfo_t ** stats);
+
+/**
+ * Complete the computation begun with sc_stats_compute_begin.
+ * \param [in] pending   This handle is freed.
+ */
+void                sc_stats_compute_end (sc_stats_pending_t * pending);
+
+/**
+ * Version of sc_stats_compute with reproducible global sums.
+ * The sums of values and squares are added exactly with sc_reprosum_t
+ * and rounded once, such that the results are bitwise identical for
+ * any reduction order.  They are independent of the number of processes
+ * if the values of each process are, such as with count=1 per process.
+ * The variance is derived from these sums and not by Welford's method.
+ * This costs one more collective call than sc_stats_compute.
+ */
+void                sc_stats_compute_reproducible (MPI_Comm mpicomm,
+                                                   int nvars,
+                                                   sc_statinfo_t * stats);
+
 /**
  * Version of sc_statistics_statistics that assumes count=1.
  * On input, the field sum_values needs to be set to the value
  * and the field variable must contain a valid string or NULL.
  * Only updates dirty variables. Then removes the dirty flag.
+ * A quantile sketch of a variable is reset to contain only the value.
  */
 void                sc_stats_compute1 (MPI_Comm mpicomm, int nvars,
                                        sc_statinfo_t * stats);
@@ -110,6 +224,7 @@ void                sc_stats_compute1 (MPI_Comm mpicomm, int nvars,
  * \param [in] package_id       Registered package id or -1.
  * \param [in] log_priority     Log priority for output according to sc.h.
  * \param [in] full             Print full information for every variable.
+ *                              Variables with a sketch also show quantiles.
  * \param [in] summary          Print summary information all on 1 line.
  */
 void                sc_stats_print (int package_id, int log_priority,
@@ -123,19 +238,36 @@ void                sc_statistics_destroy (sc_statistics_t * stats);
 
 /** Register a statistics variable by name and set its value to 0.
  * This variable must not exist already.
+ * \return                 The id of the variable, see sc_statistics_id.
  */
-void                sc_statistics_add (sc_statistics_t * stats,
+int                 sc_statistics_add (sc_statistics_t * stats,
                                        const char *name);
 
 /** Register a statistics variable by name and set its count to 0.
  * This variable must not exist already.
+ * \return                 The id of the variable, see sc_statistics_id.
  */
-void                sc_statistics_add_empty (sc_statistics_t * stats,
+int                 sc_statistics_add_empty (sc_statistics_t * stats,
                                              const char *name);
 
+/** Register a statistics variable with a quantile sketch and count 0.
+ * See sc_stats_init_quantiles.  This variable must not exist already.
+ * \return                 The id of the variable, see sc_statistics_id.
+ */
+int                 sc_statistics_add_quantiles (sc_statistics_t * stats,
+                                                 const char *name);
+
+/** Return the id of a statistics variable for access without lookup.
+ * The ids are assigned in the order the variables are added.
+ * The variable must previously be added.
+ */
+int                 sc_statistics_id (sc_statistics_t * stats,
+                                      const char *name);
+
 /** Set the value of a statistics variable, see sc_stats_set1.
  * The variable must previously be added with sc_statistics_add.
  * This assumes count=1 as in the sc_stats_set1 function above.
+ * A quantile sketch of the variable is reset to contain only the value.
  */
 void                sc_statistics_set (sc_statistics_t * stats,
                                        const char *name, double value);
@@ -146,10 +278,55 @@ void                sc_statistics_set (sc_statistics_t * stats,
 void                sc_statistics_accumulate (sc_statistics_t * stats,
                                               const char *name, double value);
 
+/** Add an instance of a statistics variable by id, see sc_statistics_id.
+ * This is sc_statistics_accumulate without the lookup by name.
+ */
+static inline void
+sc_statistics_accumulate_id (sc_statistics_t * stats, int id, double value)
+{
+  sc_stats_accumulate ((sc_statinfo_t *)
+                       sc_array_index_int (stats->sarray, id), value);
+}
+
+/** Create an empty buffer for one thread to accumulate values.
+ * The buffer has the variables of the statistics at this time,
+ * such that the same ids apply.  Accumulating into separate buffers
+ * is thread safe and their contents can then be merged one by one.
+ */
+sc_statistics_local_t *sc_statistics_local_new (sc_statistics_t * stats);
+
+/** Add an instance of a variable to a thread buffer by id. */
+static inline void
+sc_statistics_local_accumulate (sc_statistics_local_t * local, int id,
+                                double value)
+{
+  sc_stats_accumulate ((sc_statinfo_t *)
+                       sc_array_index_int (local->sarray, id), value);
+}
+
+/** Merge the values of a thread buffer into its statistics and empty it.
+ * Call this for every buffer before sc_statistics_compute, one buffer
+ * at a time, such as in a critical section after a parallel loop.
+ * The variables must not have been computed since the last set or add.
+ */
+void                sc_statistics_local_merge (sc_statistics_local_t *
+                                               local);
+
+/** Destroy a thread buffer.  Its values are not merged. */
+void                sc_statistics_local_destroy (sc_statistics_local_t *
+                                                 local);
+
 /** Compute statistics for all variables, see sc_stats_compute.
  */
 void                sc_statistics_compute (sc_statistics_t * stats);
 
+/** Begin to compute the variables of several statistics in one reduction.
+ * The statistics must have the same communicator.
+ * See sc_stats_compute_begin.  Complete it with sc_stats_compute_end.
+ */
+sc_stats_pending_t *sc_statistics_compute_begin (int nsets,
+                                                 sc_statistics_t ** stats);
+
 /** Print all statistics variables, see sc_stats_print.
  */
 void                sc_statistics_print (sc_statistics_t * stats,
@@ -0,0 +1,207 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_containers.h>
+#include <sc_trace.h>
+
+typedef struct sc_trace_event
+{
+  int                 input;
+  size_t              sequence;
+  sc_trace_record_t   record;
+}
+sc_trace_event_t;
+
+static const char  *sc_trace_priorities[SC_LP_SILENT + 1] = {
+  "ALWAYS", "TRACE", "DEBUG", "VERBOSE", "INFO",
+  "STATISTICS", "PRODUCTION", "ESSENTIAL", "ERROR", "SILENT"
+};
+
+static int
+sc_trace_event_compare (const void *v1, const void *v2)
+{
+  const sc_trace_event_t *e1 = (const sc_trace_event_t *) v1;
+  const sc_trace_event_t *e2 = (const sc_trace_event_t *) v2;
+
+  if (e1->record.time != e2->record.time) {
+    return e1->record.time < e2->record.time ? -1 : 1;
+  }
+  if (e1->input != e2->input) {
+    return e1->input < e2->input ? -1 : 1;
+  }
+  return e1->sequence == e2->sequence ? 0 :
+    e1->sequence < e2->sequence ? -1 : 1;
+}
+
+/** Read the header and the valid records of one trace file.
+ * \return          The header or NULL if the file cannot be read.
+ */
+static sc_trace_header_t *
+sc_trace_read (const char *filename, int input, sc_array_t * events)
+{
+  size_t              i, num_records, first;
+  FILE               *file;
+  sc_trace_header_t  *header;
+  sc_trace_record_t  *records;
+  sc_trace_event_t   *event;
+
+  file = fopen (filename, "rb");
+  if (file == NULL) {
+    SC_LERRORF ("Cannot open %s\n", filename);
+    return NULL;
+  }
+  header = SC_ALLOC (sc_trace_header_t, 1);
+  if (fread (header, sizeof (*header), 1, file) != 1 ||
+      memcmp (header->magic, SC_TRACE_MAGIC, sizeof (header->magic)) ||
+      header->capacity == 0) {
+    SC_LERRORF ("Invalid trace header in %s\n", filename);
+    SC_FREE (header);
+    fclose (file);
+    return NULL;
+  }
+
+  num_records = (size_t) SC_MIN (header->count, header->capacity);
+  records = SC_ALLOC (sc_trace_record_t, header->capacity);
+  if (fread (records, sizeof (*records), (size_t) header->capacity, file)
+      != (size_t) header->capacity) {
+    SC_LERRORF ("Truncated trace records in %s\n", filename);
+    num_records = 0;
+  }
+  fclose (file);
+
+  first = (size_t) SC_TRACE_FIRST (header);
+  for (i = 0; i < num_records; ++i) {
+    event = (sc_trace_event_t *) sc_array_push (events);
+    event->input = input;
+    event->sequence = i;
+    event->record = records[(first + i) % header->capacity];
+  }
+  SC_FREE (records);
+
+  return header;
+}
+
+static void
+sc_trace_print_json_string (FILE * out, const char *s)
+{
+  fputc ('"', out);
+  for (; *s != '\0'; ++s) {
+    if (*s == '"' || *s == '\\') {
+      fputc ('\\', out);
+    }
+    fputc (*s, out);
+  }
+  fputc ('"', out);
+}
+
+static void
+sc_trace_print (FILE * out, int json, sc_array_t * events,
+                sc_trace_header_t ** headers)
+{
+  int                 pid;
+  unsigned            file_id, line;
+  size_t              zi;
+  double              seconds;
+  uint64_t            start;
+  const char         *package, *filename, *category, *priority;
+  char                name[BUFSIZ];
+  sc_trace_event_t   *event;
+  sc_trace_header_t  *h;
+
+  start = 0;
+  if (events->elem_count > 0) {
+    start = ((sc_trace_event_t *) sc_array_index (events, 0))->record.time;
+  }
+
+  if (json) {
+    fputs ("{\"traceEvents\":[\n", out);
+  }
+  for (zi = 0; zi < events->elem_count; ++zi) {
+    event = (sc_trace_event_t *) sc_array_index (events, zi);
+    h = headers[event->input];
+    seconds = (event->record.time - start) * 1.e-9;
+    file_id = event->record.location >> SC_TRACE_LINE_BITS;
+    line = event->record.location & SC_TRACE_LINE_MASK;
+    filename = file_id < SC_TRACE_MAX_FILES ?
+      h->files[file_id] : "<invalid>";
+    package = event->record.package >= -1 &&
+      event->record.package < SC_MAX_PACKAGES ?
+      h->packages[event->record.package + 1] : "<invalid>";
+    category = event->record.category == SC_LC_GLOBAL ? "GLOBAL" : "NORMAL";
+    priority = event->record.priority >= 0 &&
+      event->record.priority <= SC_LP_SILENT ?
+      sc_trace_priorities[event->record.priority] : "<invalid>";
+    pid = h->rank >= 0 ? h->rank : event->input;
+
+    if (json) {
+      snprintf (name, BUFSIZ, "%s:%u", filename, line);
+      fputs ("{\"name\":", out);
+      sc_trace_print_json_string (out, name);
+      fputs (",\"cat\":", out);
+      sc_trace_print_json_string (out, package);
+      fprintf (out, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+               "\"pid\":%d,\"tid\":0,\"args\":{\"category\":\"%s\","
+               "\"priority\":\"%s\"}}%s\n", seconds * 1.e6, pid,
+               category, priority,
+               zi + 1 < events->elem_count ? "," : "");
+    }
+    else {
+      fprintf (out, "%.9f %d %s %s:%u %s %s\n", seconds, pid,
+               package, filename, line, category, priority);
+    }
+  }
+  if (json) {
+    fputs ("],\"displayTimeUnit\":\"ns\"}\n", out);
+  }
+}
+
+int
+sc_trace_merge (int num_inputs, char **filenames, int json, FILE * out)
+{
+  int                 i, retval;
+  sc_array_t         *events;
+  sc_trace_header_t **headers;
+
+  retval = 0;
+  headers = SC_ALLOC (sc_trace_header_t *, num_inputs);
+  events = sc_array_new (sizeof (sc_trace_event_t));
+  for (i = 0; i < num_inputs; ++i) {
+    headers[i] = sc_trace_read (filenames[i], i, events);
+    if (headers[i] == NULL) {
+      retval = -1;
+    }
+  }
+  if (!retval) {
+    sc_array_sort (events, sc_trace_event_compare);
+    sc_trace_print (out, json, events, headers);
+  }
+
+  for (i = 0; i < num_inputs; ++i) {
+    if (headers[i] != NULL) {
+      SC_FREE (headers[i]);
+    }
+  }
+  SC_FREE (headers);
+  sc_array_destroy (events);
+
+  return retval;
+}
@@ -0,0 +1,99 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+/* File format of the binary log trace.
+ *
+ * If the environment variable SC_TRACE_BINARY is set, sc_init opens
+ * the file $SC_TRACE_BINARY.<rank>.bin (or $SC_TRACE_BINARY.bin without
+ * MPI) and every log call that passes the trace priority SC_TRACE_LP
+ * appends one fixed-size record without formatting the message.
+ * The file consists of one sc_trace_header_t followed by a ring of
+ * capacity records, where capacity is taken from SC_TRACE_BINARY_SIZE.
+ * When more than capacity records are logged the oldest are overwritten.
+ * The files of all ranks can be merged by sc_trace_merge, which is
+ * run by the program example/trace/sc_trace_merge.
+ */
+
+#ifndef SC_TRACE_H
+#define SC_TRACE_H
+
+#include <sc.h>
+
+SC_EXTERN_C_BEGIN;
+
+#define SC_TRACE_MAGIC          "SCTRACE1"
+#define SC_TRACE_NAME_LENGTH    64
+#define SC_TRACE_MAX_FILES      1024
+#define SC_TRACE_LINE_BITS      20
+#define SC_TRACE_LINE_MASK      ((1U << SC_TRACE_LINE_BITS) - 1)
+#define SC_TRACE_CAPACITY       (1 << 20)
+
+/** One log event of 16 bytes. */
+typedef struct sc_trace_record
+{
+  uint64_t            time;     /**< Nanoseconds since the epoch. */
+  uint32_t            location; /**< File id << SC_TRACE_LINE_BITS | line. */
+  int16_t             package;  /**< Package id or -1. */
+  int8_t              category; /**< SC_LC_NORMAL or SC_LC_GLOBAL. */
+  int8_t              priority; /**< Log priority of the message. */
+}
+sc_trace_record_t;
+
+/** The header of a trace file.
+ * Packages are indexed by package id + 1 and file ids by the record's
+ * location >> SC_TRACE_LINE_BITS.  File names are stored without path.
+ */
+typedef struct sc_trace_header
+{
+  char                magic[8];         /**< Contains SC_TRACE_MAGIC. */
+  int32_t             rank;             /**< MPI rank or -1. */
+  int32_t             num_files;        /**< Valid entries in files. */
+  uint64_t            capacity;         /**< Number of record slots. */
+  uint64_t            count;            /**< Records logged in total. */
+  char                packages[SC_MAX_PACKAGES + 1][SC_TRACE_NAME_LENGTH];
+  char                files[SC_TRACE_MAX_FILES][SC_TRACE_NAME_LENGTH];
+}
+sc_trace_header_t;
+
+/** Return the oldest valid record index of a trace file.
+ * The valid records are found at (first + i) % capacity
+ * for i < SC_MIN (count, capacity).
+ */
+#define SC_TRACE_FIRST(h) \
+  ((h)->count > (h)->capacity ? (h)->count % (h)->capacity : 0)
+
+/** Merge binary trace files into one list of records sorted by time.
+ * Each record is written as one line of text with the seconds since the
+ * first record, the rank, package, file:line, category and priority,
+ * or as one instant event of the Chrome trace JSON format.
+ * \param [in] num_inputs  Number of trace files.
+ * \param [in] filenames   Names of the trace files.
+ * \param [in] json        If true, write Chrome trace JSON.
+ * \param [in,out] out     Stream to write to.
+ * \return                 0 on success, -1 if an input cannot be read.
+ */
+int                 sc_trace_merge (int num_inputs, char **filenames,
+                                    int json, FILE * out);
+
+SC_EXTERN_C_END;
+
+#endif /* !SC_TRACE_H */
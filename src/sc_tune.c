@@ -0,0 +1,355 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_allgather.h>
+#include <sc_reduce.h>
+#include <sc_tune.h>
+
+/* the message sizes benchmarked are 2^0, 2^4, ... bytes per process */
+#define SC_TUNE_SIZE_STEP       4
+
+/* larger gather buffers are not benchmarked */
+#define SC_TUNE_MAX_BYTES       (1 << 26)
+
+/* repetitions of every measurement */
+#define SC_TUNE_REPETITIONS     5
+
+/* the highest reduce level benchmarked */
+#define SC_TUNE_MAX_LEVEL       6
+
+static int          sc_tune_initialized = 0;
+static int          sc_tune_ag_max[SC_TUNE_NUM_SIZES];
+static int          sc_tune_reduce_level[SC_TUNE_NUM_SIZES];
+static int          sc_tune_chunk_max;
+
+static const int    sc_tune_ag_candidates[] =
+  { 1, 2, 3, 4, 5, 6, 8, 12, 16, 24, 32, 48, 64, -1 };
+
+static int
+sc_tune_class (size_t datasize)
+{
+  int                 c;
+
+  c = datasize > 0 ? SC_LOG2_64 (datasize) : 0;
+  return SC_MIN (c, SC_TUNE_NUM_SIZES - 1);
+}
+
+void
+sc_tune_reset (void)
+{
+  int                 c;
+
+  for (c = 0; c < SC_TUNE_NUM_SIZES; ++c) {
+    sc_tune_ag_max[c] = SC_AG_ALLTOALL_MAX;
+    sc_tune_reduce_level[c] = SC_REDUCE_ALLTOALL_LEVEL;
+  }
+  sc_tune_chunk_max = SC_AG_CHUNK_MAX;
+  sc_tune_initialized = 1;
+}
+
+int
+sc_tune_ag_alltoall_max (size_t datasize)
+{
+  if (!sc_tune_initialized) {
+    sc_tune_reset ();
+  }
+  return sc_tune_ag_max[sc_tune_class (datasize)];
+}
+
+int
+sc_tune_reduce_alltoall_level (size_t datasize)
+{
+  if (!sc_tune_initialized) {
+    sc_tune_reset ();
+  }
+  return sc_tune_reduce_level[sc_tune_class (datasize)];
+}
+
+int
+sc_tune_ag_chunk_max (void)
+{
+  if (!sc_tune_initialized) {
+    sc_tune_reset ();
+  }
+  return sc_tune_chunk_max;
+}
+
+void
+sc_tune_set_ag_chunk_max (int chunk_max)
+{
+  SC_ASSERT (chunk_max > 0);
+  if (!sc_tune_initialized) {
+    sc_tune_reset ();
+  }
+  sc_tune_chunk_max = chunk_max;
+}
+
+void
+sc_tune_set (int ag_alltoall_max, int reduce_alltoall_level)
+{
+  int                 c;
+
+  if (!sc_tune_initialized) {
+    sc_tune_reset ();
+  }
+  for (c = 0; c < SC_TUNE_NUM_SIZES; ++c) {
+    if (ag_alltoall_max > 0) {
+      sc_tune_ag_max[c] = ag_alltoall_max;
+    }
+    if (reduce_alltoall_level >= 0) {
+      sc_tune_reduce_level[c] = reduce_alltoall_level;
+    }
+  }
+}
+
+/** Return the maximum time over all processes of a few collectives. */
+static double
+sc_tune_time (MPI_Comm mpicomm, int reduce, char *sendbuf, char *recvbuf,
+              int datasize)
+{
+  int                 mpiret;
+  int                 r;
+  double              elapsed, maxelapsed;
+
+  /* the first call is not timed */
+  mpiret = MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  elapsed = 0.;
+  for (r = 0; r <= SC_TUNE_REPETITIONS; ++r) {
+    if (r == 1) {
+      elapsed = -MPI_Wtime ();
+    }
+    if (reduce) {
+      mpiret = sc_allreduce (sendbuf, recvbuf, datasize, MPI_BYTE,
+                             MPI_MAX, mpicomm);
+    }
+    else {
+      mpiret = sc_allgather (sendbuf, datasize, MPI_BYTE,
+                             recvbuf, datasize, MPI_BYTE, mpicomm);
+    }
+    SC_CHECK_MPI (mpiret);
+  }
+  elapsed += MPI_Wtime ();
+
+  mpiret = MPI_Allreduce (&elapsed, &maxelapsed, 1, MPI_DOUBLE, MPI_MAX,
+                          mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  return maxelapsed;
+}
+
+void
+sc_tune_run (MPI_Comm mpicomm)
+{
+  int                 mpiret;
+  int                 mpisize;
+  int                 c, d, i;
+  int                 datasize, maxlevel;
+  int                 best_ag, best_level;
+  double              elapsed, best;
+  char               *sendbuf, *recvbuf;
+
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  if (mpisize <= 1) {
+    return;
+  }
+  maxlevel = SC_MIN (SC_LOG2_32 (mpisize - 1) + 1, SC_TUNE_MAX_LEVEL);
+
+  sendbuf = SC_ALLOC_ZERO (char, SC_TUNE_MAX_BYTES / mpisize);
+  recvbuf = SC_ALLOC (char, SC_TUNE_MAX_BYTES);
+
+  for (c = 0; c < SC_TUNE_NUM_SIZES; c += SC_TUNE_SIZE_STEP) {
+    datasize = 1 << c;
+    if ((size_t) mpisize * datasize > (size_t) SC_TUNE_MAX_BYTES) {
+      break;
+    }
+
+    /* the candidates are the same on all processes */
+    best = -1.;
+    best_ag = sc_tune_ag_max[c];
+    for (i = 0; sc_tune_ag_candidates[i] > 0; ++i) {
+      sc_tune_ag_max[c] = sc_tune_ag_candidates[i];
+      elapsed = sc_tune_time (mpicomm, 0, sendbuf, recvbuf, datasize);
+      if (best < 0. || elapsed < best) {
+        best = elapsed;
+        best_ag = sc_tune_ag_candidates[i];
+      }
+      if (sc_tune_ag_candidates[i] >= mpisize) {
+        break;
+      }
+    }
+
+    /* larger allreduce messages use Rabenseifner's algorithm */
+    best = -1.;
+    best_level = sc_tune_reduce_level[c];
+    for (i = 0; datasize < SC_REDUCE_LARGE_BYTES && i <= maxlevel; ++i) {
+      sc_tune_reduce_level[c] = i;
+      elapsed = sc_tune_time (mpicomm, 1, sendbuf, recvbuf, datasize);
+      if (best < 0. || elapsed < best) {
+        best = elapsed;
+        best_level = i;
+      }
+    }
+
+    /* larger sizes use the result of the largest size measured */
+    for (d = c; d < SC_TUNE_NUM_SIZES; ++d) {
+      sc_tune_ag_max[d] = best_ag;
+      sc_tune_reduce_level[d] = best_level;
+    }
+    SC_GLOBAL_INFOF ("Tuned %d bytes: allgather alltoall max %d,"
+                     " reduce alltoall level %d\n",
+                     datasize, best_ag, best_level);
+  }
+
+  SC_FREE (sendbuf);
+  SC_FREE (recvbuf);
+}
+
+int
+sc_tune_load (const char *filename, MPI_Comm mpicomm)
+{
+  int                 mpiret;
+  int                 mpirank;
+  int                 c, ag_max, level;
+  int                 values[2 * SC_TUNE_NUM_SIZES + 1];
+  char                line[BUFSIZ];
+  FILE               *file;
+
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  if (!sc_tune_initialized) {
+    sc_tune_reset ();
+  }
+  for (c = 0; c < SC_TUNE_NUM_SIZES; ++c) {
+    values[1 + c] = sc_tune_ag_max[c];
+    values[1 + SC_TUNE_NUM_SIZES + c] = sc_tune_reduce_level[c];
+  }
+
+  if (mpirank == 0) {
+    file = fopen (filename, "r");
+    values[0] = file != NULL ? 0 : -1;
+    while (file != NULL && fgets (line, BUFSIZ, file) != NULL) {
+      if (line[0] == '#') {
+        continue;
+      }
+      if (sscanf (line, "%d %d %d", &c, &ag_max, &level) != 3 ||
+          c < 0 || c >= SC_TUNE_NUM_SIZES || ag_max < 1 || level < 0) {
+        SC_LERRORF ("Invalid line in %s: %s", filename, line);
+        values[0] = -1;
+        break;
+      }
+      values[1 + c] = ag_max;
+      values[1 + SC_TUNE_NUM_SIZES + c] = level;
+    }
+    if (file != NULL) {
+      fclose (file);
+    }
+  }
+
+  mpiret = MPI_Bcast (values, 2 * SC_TUNE_NUM_SIZES + 1, MPI_INT, 0,
+                      mpicomm);
+  SC_CHECK_MPI (mpiret);
+  if (values[0] == 0) {
+    for (c = 0; c < SC_TUNE_NUM_SIZES; ++c) {
+      sc_tune_ag_max[c] = values[1 + c];
+      sc_tune_reduce_level[c] = values[1 + SC_TUNE_NUM_SIZES + c];
+    }
+  }
+
+  return values[0];
+}
+
+int
+sc_tune_save (const char *filename, MPI_Comm mpicomm)
+{
+  int                 mpiret;
+  int                 mpirank;
+  int                 c;
+  FILE               *file;
+
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+  if (mpirank != 0) {
+    return 0;
+  }
+
+  file = fopen (filename, "w");
+  if (file == NULL) {
+    return -1;
+  }
+  fprintf (file, "# log2 of bytes, allgather alltoall max,"
+           " reduce alltoall level\n");
+  for (c = 0; c < SC_TUNE_NUM_SIZES; ++c) {
+    fprintf (file, "%d %d %d\n", c, sc_tune_ag_alltoall_max ((size_t) 1 << c),
+             sc_tune_reduce_alltoall_level ((size_t) 1 << c));
+  }
+
+  return fclose (file) ? -1 : 0;
+}
+
+void
+sc_tune_init (MPI_Comm mpicomm)
+{
+  int                 mpiret;
+  int                 mpisize;
+  int                 value;
+  const char         *env;
+  char                filename[BUFSIZ];
+
+  sc_tune_reset ();
+
+  env = getenv ("SC_TUNE_FILE");
+  if (env != NULL && mpicomm != MPI_COMM_NULL) {
+    mpiret = MPI_Comm_size (mpicomm, &mpisize);
+    SC_CHECK_MPI (mpiret);
+    snprintf (filename, BUFSIZ, "%s.%d", env, mpisize);
+    if (sc_tune_load (filename, mpicomm)) {
+      SC_GLOBAL_PRODUCTIONF ("Tuning collectives into %s\n", filename);
+      sc_tune_run (mpicomm);
+      if (sc_tune_save (filename, mpicomm)) {
+        SC_LERRORF ("Cannot write %s\n", filename);
+      }
+    }
+  }
+
+  env = getenv ("SC_AG_ALLTOALL_MAX");
+  if (env != NULL) {
+    value = atoi (env);
+    SC_CHECK_ABORT (value >= 1, "SC_AG_ALLTOALL_MAX must be positive");
+    sc_tune_set (value, -1);
+  }
+  env = getenv ("SC_REDUCE_ALLTOALL_LEVEL");
+  if (env != NULL) {
+    value = atoi (env);
+    SC_CHECK_ABORT (value >= 0,
+                    "SC_REDUCE_ALLTOALL_LEVEL must be non-negative");
+    sc_tune_set (-1, value);
+  }
+  env = getenv ("SC_AG_CHUNK_MAX");
+  if (env != NULL) {
+    value = atoi (env);
+    SC_CHECK_ABORT (value >= 1, "SC_AG_CHUNK_MAX must be positive");
+    sc_tune_set_ag_chunk_max (value);
+  }
+}
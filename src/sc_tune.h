@@ -0,0 +1,110 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+/* Run-time selection of the collective algorithms.
+ *
+ * sc_allgather switches from recursive bisection to sc_ag_alltoall for
+ * groups of at most sc_tune_ag_alltoall_max processes, and sc_reduce
+ * switches from recursion to all-to-all communication at the level
+ * sc_tune_reduce_alltoall_level.  Both thresholds depend on the size
+ * of the message of one process.  They default to SC_AG_ALLTOALL_MAX
+ * and SC_REDUCE_ALLTOALL_LEVEL and may be measured by sc_tune_run.
+ * Messages of sc_allgather and sc_allgatherv larger than
+ * sc_tune_ag_chunk_max bytes are split, which defaults to SC_AG_CHUNK_MAX.
+ *
+ * sc_init calls sc_tune_init, which reads these environment variables:
+ * SC_TUNE_FILE               Load the thresholds from the cache file
+ *                            $SC_TUNE_FILE.<size of the communicator>.
+ *                            If it does not exist, run sc_tune_run and
+ *                            write the file.
+ * SC_AG_ALLTOALL_MAX         Override the allgather threshold.
+ * SC_REDUCE_ALLTOALL_LEVEL   Override the reduce threshold.
+ * SC_AG_CHUNK_MAX            Override the allgather chunk size.
+ * The thresholds must be the same on all processes.
+ */
+
+#ifndef SC_TUNE_H
+#define SC_TUNE_H
+
+#include <sc.h>
+
+/* message sizes are classified by their binary logarithm */
+#define SC_TUNE_NUM_SIZES       32
+
+SC_EXTERN_C_BEGIN;
+
+/** Return the largest group size that sc_allgather gathers all-to-all.
+ * \param [in] datasize     Bytes contributed by each process.
+ */
+int                 sc_tune_ag_alltoall_max (size_t datasize);
+
+/** Return the highest level at which sc_reduce communicates all-to-all.
+ * \param [in] datasize     Bytes contributed by each process.
+ */
+int                 sc_tune_reduce_alltoall_level (size_t datasize);
+
+/** Set the thresholds for all message sizes.
+ * \param [in] ag_alltoall_max          Positive, or negative to keep.
+ * \param [in] reduce_alltoall_level    Non-negative, or negative to keep.
+ */
+void                sc_tune_set (int ag_alltoall_max,
+                                 int reduce_alltoall_level);
+
+/** Return the largest message in bytes that sc_allgather sends whole. */
+int                 sc_tune_ag_chunk_max (void);
+
+/** Set the largest message that sc_allgather sends whole.
+ * \param [in] chunk_max        Positive number of bytes.
+ */
+void                sc_tune_set_ag_chunk_max (int chunk_max);
+
+/** Restore the compiled-in thresholds. */
+void                sc_tune_reset (void);
+
+/** Measure the fastest thresholds for a range of message sizes.
+ * The reduce level is measured below SC_REDUCE_LARGE_BYTES, from where
+ * sc_allreduce does not use it, and larger sizes keep the last level.
+ * This function is collective and takes a few seconds.
+ * \param [in] mpicomm      Communicator to benchmark.  The thresholds
+ *                          are best used on communicators of its size.
+ */
+void                sc_tune_run (MPI_Comm mpicomm);
+
+/** Load the thresholds from a file.  This function is collective.
+ * The root process reads the file and broadcasts its contents.
+ * \return                  0 on success, -1 if the file cannot be read.
+ */
+int                 sc_tune_load (const char *filename, MPI_Comm mpicomm);
+
+/** Write the thresholds to a file on the root process.
+ * \return                  0 on success, -1 on error.
+ */
+int                 sc_tune_save (const char *filename, MPI_Comm mpicomm);
+
+/** Set up the thresholds from the environment.  Called by sc_init.
+ * \param [in] mpicomm      The communicator of sc_init or MPI_COMM_NULL.
+ */
+void                sc_tune_init (MPI_Comm mpicomm);
+
+SC_EXTERN_C_END;
+
+#endif /* !SC_TUNE_H */
@@ -0,0 +1,172 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc.h>
+#include <sys/wait.h>
+#ifdef SC_MPITHREAD
+#include <time.h>
+#endif
+
+/* the number of ranks emulated in the child process */
+#define TEST_ABORT_RANKS 6
+
+/* ranks other than 2 fail with one of two messages */
+static int
+test_collective (int argc, char **argv)
+{
+  int                 mpirank;
+#ifdef SC_MPI
+  /* the child process runs without MPI */
+  mpirank = 0;
+#else
+  int                 mpiret;
+
+  mpiret = MPI_Comm_rank (MPI_COMM_WORLD, &mpirank);
+  SC_CHECK_MPI (mpiret);
+#endif
+  SC_CHECK_ABORT_COLLECTIVE (mpirank == 2, mpirank < 3 ? "Low" : "High");
+  return 0;
+}
+
+#ifdef SC_MPITHREAD
+
+/* the last rank fails alone while the others wait */
+static int
+test_quiet (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpisize, mpirank;
+
+  mpiret = MPI_Comm_size (MPI_COMM_WORLD, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (MPI_COMM_WORLD, &mpirank);
+  SC_CHECK_MPI (mpiret);
+  if (mpirank == mpisize - 1) {
+    SC_ABORT ("Quiet rank");
+  }
+  mpiret = MPI_Barrier (MPI_COMM_WORLD);
+  SC_CHECK_MPI (mpiret);
+  return 0;
+}
+
+#endif
+
+/* run a function in a child process that must abort
+ * \return          The output of the child. */
+static FILE        *
+test_child (sc_mpi_main_t fn, int num_ranks, int argc, char **argv)
+{
+  int                 status;
+  pid_t               pid;
+  FILE               *output;
+
+  output = tmpfile ();
+  SC_CHECK_ABORT (output != NULL, "Temporary file");
+  fflush (stdout);
+  pid = fork ();
+  SC_CHECK_ABORT (pid >= 0, "Fork");
+  if (pid == 0) {
+    dup2 (fileno (output), STDOUT_FILENO);
+    dup2 (fileno (output), STDERR_FILENO);
+#ifdef SC_MPI
+    /* a child of an MPI process must not initialize MPI */
+    sc_init (MPI_COMM_NULL, 0, 0, NULL, SC_LP_DEFAULT);
+    fn (argc, argv);
+#else
+    MPI_Init (&argc, &argv);
+    sc_init (MPI_COMM_WORLD, 0, 0, NULL, SC_LP_DEFAULT);
+    sc_mpi_run (num_ranks, fn, argc, argv);
+#endif
+    _exit (0);
+  }
+  SC_CHECK_ABORT (waitpid (pid, &status, 0) == pid, "Wait");
+  SC_CHECK_ABORT (WIFSIGNALED (status) && WTERMSIG (status) == SIGABRT,
+                  "Child not aborted");
+  return output;
+}
+
+/* count the lines of a file that contain a string */
+static int
+test_count_lines (FILE * file, const char *s)
+{
+  int                 count = 0;
+  char                line[BUFSIZ];
+
+  rewind (file);
+  while (fgets (line, BUFSIZ, file) != NULL) {
+    count += strstr (line, s) != NULL;
+  }
+  return count;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 num_procs;
+  char                expected[BUFSIZ];
+  FILE               *output;
+#ifdef SC_MPITHREAD
+  time_t              start;
+#endif
+
+  /* the root prints each distinct message once */
+#ifdef SC_MPITHREAD
+  num_procs = TEST_ABORT_RANKS;
+#else
+  num_procs = 1;
+#endif
+  output = test_child (test_collective, num_procs, argc, argv);
+  snprintf (expected, BUFSIZ, "Abort: Low (%d process%s, first rank 0)",
+            SC_MIN (num_procs, 2), num_procs > 1 ? "es" : "");
+  SC_CHECK_ABORT (test_count_lines (output, expected) == 1, "Low message");
+  snprintf (expected, BUFSIZ, "Abort: High (%d processes, first rank 3)",
+            num_procs - 3);
+  SC_CHECK_ABORT (test_count_lines (output, "Abort: High") ==
+                  (num_procs > 3) &&
+                  test_count_lines (output, expected) == (num_procs > 3),
+                  "High message");
+  SC_CHECK_ABORT (test_count_lines (output, "Abort: ") == 1 + (num_procs > 3),
+                  "Messages not merged");
+  fclose (output);
+
+#ifdef SC_MPITHREAD
+  /* a quiet process other than the root prints one line and waits briefly */
+  setenv ("SC_ABORT_QUIET", "1", 1);
+  start = time (NULL);
+  output = test_child (test_quiet, TEST_ABORT_RANKS, argc, argv);
+  SC_CHECK_ABORT (time (NULL) - start <= 3, "Quiet abort too slow");
+  SC_CHECK_ABORT (test_count_lines (output, "Abort: Quiet rank at ") == 1 &&
+                  test_count_lines (output, "Abort") == 1, "Quiet abort");
+  fclose (output);
+  unsetenv ("SC_ABORT_QUIET");
+#endif
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+  sc_finalize ();
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -21,6 +21,77 @@
 */
 
 #include <sc_allgather.h>
+#include <sc_tune.h>
+
+/* the number of ints sent by a process in the test of chunks */
+#define TEST_AG_COUNT 25
+
+/* the chunk size in bytes, smaller than the messages */
+#define TEST_AG_CHUNK_MAX 40
+
+/* compare sc_allgather and sc_allgatherv with MPI when split into chunks */
+static void
+test_chunks (MPI_Comm mpicomm, int mpisize, int mpirank)
+{
+  int                 mpiret;
+  int                 i, j, k, total;
+  int                *send, *data1, *data2;
+  int                *counts, *displs;
+
+  /* ragged counts stored in reverse rank order for allgatherv */
+  counts = SC_ALLOC (int, mpisize);
+  displs = SC_ALLOC (int, mpisize);
+  total = 0;
+  for (i = mpisize - 1; i >= 0; --i) {
+    counts[i] = TEST_AG_COUNT + 7 * (i % 3);
+    displs[i] = total;
+    total += counts[i];
+  }
+  total = SC_MAX (total, TEST_AG_COUNT * mpisize);
+  send = SC_ALLOC (int, counts[mpirank]);
+  data1 = SC_ALLOC (int, total);
+  data2 = SC_ALLOC (int, total);
+  for (j = 0; j < counts[mpirank]; ++j) {
+    send[j] = 1000 * mpirank + j;
+  }
+
+  /* cover both the all-to-all and the recursive schedule */
+  sc_tune_set_ag_chunk_max (TEST_AG_CHUNK_MAX);
+  for (k = 1; k <= 3; ++k) {
+    sc_tune_set (k, -1);
+
+    mpiret = MPI_Allgather (send, TEST_AG_COUNT, MPI_INT,
+                            data1, TEST_AG_COUNT, MPI_INT, mpicomm);
+    SC_CHECK_MPI (mpiret);
+    memset (data2, -1, total * sizeof (int));
+    mpiret = sc_allgather (send, TEST_AG_COUNT, MPI_INT,
+                           data2, TEST_AG_COUNT, MPI_INT, mpicomm);
+    SC_CHECK_MPI (mpiret);
+    SC_CHECK_ABORT (!memcmp (data1, data2,
+                             TEST_AG_COUNT * mpisize * sizeof (int)),
+                    "Chunked allgather mismatch");
+
+    mpiret = MPI_Allgatherv (send, counts[mpirank], MPI_INT,
+                             data1, counts, displs, MPI_INT, mpicomm);
+    SC_CHECK_MPI (mpiret);
+    memset (data2, -1, total * sizeof (int));
+    mpiret = sc_allgatherv (send, counts[mpirank], MPI_INT,
+                            data2, counts, displs, MPI_INT, mpicomm);
+    SC_CHECK_MPI (mpiret);
+    for (i = 0; i < mpisize; ++i) {
+      SC_CHECK_ABORT (!memcmp (data1 + displs[i], data2 + displs[i],
+                               counts[i] * sizeof (int)),
+                      "Chunked allgatherv mismatch");
+    }
+  }
+  sc_tune_init (mpicomm);      /* restore the settings of sc_init */
+
+  SC_FREE (send);
+  SC_FREE (data1);
+  SC_FREE (data2);
+  SC_FREE (counts);
+  SC_FREE (displs);
+}
 
 int
 main (int argc, char **argv)
@@ -40,6 +111,12 @@ main (int argc, char **argv)
   double             *ddata2;
   double              elapsed_allgather;
   double              elapsed_replacement;
+  double              elapsed_nonblocking;
+  double             *ddata3;
+  int                 flag;
+  int                 j, k, total;
+  int                *counts, *displs, *vsend, *vdata;
+  sc_coll_request_t  *request;
 
   mpiret = MPI_Init (&argc, &argv);
   SC_CHECK_MPI (mpiret);
@@ -117,17 +194,101 @@ main (int argc, char **argv)
   }
   SC_ASSERT (ddata1[mpirank] == dsend); /* exact match wanted */
 
+  SC_GLOBAL_INFO ("Testing nonblocking allgather\n");
+
+  ddata3 = SC_ALLOC (double, mpisize);
+  dsend = M_PI + mpirank;
+
+  mpiret = MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  elapsed_nonblocking = -MPI_Wtime ();
+  mpiret = sc_iallgather (&dsend, 1, MPI_DOUBLE, ddata3, 1, MPI_DOUBLE,
+                          mpicomm, &request);
+  SC_CHECK_MPI (mpiret);
+  do {
+    sc_coll_test (&request, &flag);
+  }
+  while (!flag);
+  SC_CHECK_ABORT (request == NULL, "Completed request");
+  mpiret = MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  elapsed_nonblocking += MPI_Wtime ();
+
+  for (i = 0; i < mpisize; ++i) {
+    SC_CHECK_ABORT (ddata3[i] == M_PI + i,      /* exact match wanted */
+                    "Nonblocking allgather mismatch");
+  }
+
+  /* test the nonblocking allgather with various all-to-all sizes */
+  for (k = 1; k <= 6; ++k) {
+    sc_tune_set (k, -1);
+    mpiret = sc_iallgather (&dsend, 1, MPI_DOUBLE, ddata3, 1, MPI_DOUBLE,
+                            mpicomm, &request);
+    SC_CHECK_MPI (mpiret);
+    sc_coll_wait (&request);
+    for (i = 0; i < mpisize; ++i) {
+      SC_CHECK_ABORT (ddata3[i] == M_PI + i,    /* exact match wanted */
+                      "Nonblocking allgather mismatch");
+    }
+  }
+  sc_tune_init (mpicomm);      /* restore the settings of sc_init */
+
   SC_FREE (ddata1);
   SC_FREE (ddata2);
+  SC_FREE (ddata3);
+
+  SC_GLOBAL_INFO ("Testing allgatherv\n");
+
+  /* ragged counts with the data stored in reverse rank order */
+  counts = SC_ALLOC (int, mpisize);
+  displs = SC_ALLOC (int, mpisize);
+  total = 0;
+  for (i = mpisize - 1; i >= 0; --i) {
+    counts[i] = i % 4;
+    displs[i] = total;
+    total += counts[i];
+  }
+  vsend = SC_ALLOC (int, counts[mpirank] + 1);
+  vdata = SC_ALLOC (int, total + 1);
+  for (k = 0; k < 2; ++k) {
+    for (j = 0; j < counts[mpirank]; ++j) {
+      vsend[j] = 1000 * mpirank + j;
+    }
+    mpiret = sc_allgatherv (vsend, counts[mpirank], MPI_INT,
+                            vdata, counts, displs, MPI_INT, mpicomm);
+    SC_CHECK_MPI (mpiret);
+    for (i = 0; i < mpisize; ++i) {
+      for (j = 0; j < counts[i]; ++j) {
+        SC_CHECK_ABORT (vdata[displs[i] + j] == 1000 * i + j,
+                        "Allgatherv mismatch");
+      }
+    }
+
+    /* repeat with the data stored contiguously in rank order */
+    total = 0;
+    for (i = 0; i < mpisize; ++i) {
+      displs[i] = total;
+      total += counts[i];
+    }
+  }
+  SC_FREE (counts);
+  SC_FREE (displs);
+  SC_FREE (vsend);
+  SC_FREE (vdata);
+
+  SC_GLOBAL_INFO ("Testing allgather in chunks\n");
+  test_chunks (mpicomm, mpisize, mpirank);
 
   SC_GLOBAL_STATISTICSF ("Timings with threshold %d on %d cores\n",
-                         SC_AG_ALLTOALL_MAX, mpisize);
+                         sc_tune_ag_alltoall_max (sizeof (double)),
+                         mpisize);
 #ifdef SC_MPI
   SC_GLOBAL_STATISTICSF ("   alltoall %g\n", elapsed_alltoall);
   SC_GLOBAL_STATISTICSF ("   recursive %g\n", elapsed_recursive);
 #endif
   SC_GLOBAL_STATISTICSF ("   allgather %g\n", elapsed_allgather);
   SC_GLOBAL_STATISTICSF ("   replacement %g\n", elapsed_replacement);
+  SC_GLOBAL_STATISTICSF ("   nonblocking %g\n", elapsed_nonblocking);
 
   sc_finalize ();
 
@@ -0,0 +1,186 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_amr.h>
+
+/* the number of ranks emulated unless SC_MPI_THREADS is set */
+#define TEST_AMR_RANKS 4
+#define TEST_AMR_ELEMENTS 4000
+#define TEST_AMR_STEPS 40
+
+typedef struct test_amr
+{
+  int                 num_calls;
+}
+test_amr_t;
+
+/* families of four elements are coarsened if all errors are below */
+static long
+test_amr_coarsen (sc_amr_control_t * amr, void *user_data)
+{
+  test_amr_t         *ta = (test_amr_t *) user_data;
+  long                i, count;
+
+  ++ta->num_calls;
+  count = 0;
+  for (i = 0; i + 3 < amr->num_local_elements; i += 4) {
+    count += 3 * (amr->errors[i] < amr->coarsen_threshold &&
+                  amr->errors[i + 1] < amr->coarsen_threshold &&
+                  amr->errors[i + 2] < amr->coarsen_threshold &&
+                  amr->errors[i + 3] < amr->coarsen_threshold);
+  }
+  return count;
+}
+
+/* elements are refined into four if their error is above */
+static long
+test_amr_refine (sc_amr_control_t * amr, void *user_data)
+{
+  test_amr_t         *ta = (test_amr_t *) user_data;
+  long                i, count;
+
+  ++ta->num_calls;
+  count = 0;
+  for (i = 0; i < amr->num_local_elements; ++i) {
+    count += 3 * (amr->errors[i] > amr->refine_threshold);
+  }
+  return count;
+}
+
+static int
+test_amr (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpisize, mpirank;
+  int                 i, histogram;
+  long                ideal, num_total;
+  unsigned            seed;
+  double             *errors;
+  sc_amr_control_t    amr;
+  test_amr_t          ta;
+  MPI_Comm            mpicomm;
+
+  mpicomm = MPI_COMM_WORLD;
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  /* errors spread over several orders of magnitude, smooth in families */
+  errors = SC_ALLOC (double, TEST_AMR_ELEMENTS);
+  seed = 1 + 7919 * (unsigned) mpirank;
+  for (i = 0; i < TEST_AMR_ELEMENTS; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    errors[i] = exp (-12. * ((seed >> 8) & 0xffff) / 65536.);
+    if (i % 4) {
+      errors[i] = errors[i - 1] * (1. + .1 * (i % 4));
+    }
+  }
+  num_total = (long) mpisize * TEST_AMR_ELEMENTS;
+
+  for (histogram = 0; histogram < 2; ++histogram) {
+    /* coarsen to reach a smaller number of elements */
+    ideal = (long) (.7 * num_total);
+    sc_amr_error_stats (mpicomm, TEST_AMR_ELEMENTS, errors, &amr);
+    ta.num_calls = 0;
+    if (histogram) {
+      sc_amr_coarsen_search_histogram (sc_package_id, &amr, ideal,
+                                       amr.estats.max, .97, TEST_AMR_STEPS,
+                                       test_amr_coarsen, &ta);
+    }
+    else {
+      sc_amr_coarsen_search (sc_package_id, &amr, ideal, amr.estats.max,
+                             .97, TEST_AMR_STEPS, test_amr_coarsen, &ta);
+    }
+    SC_GLOBAL_INFOF ("Coarsen search %d took %d steps\n", histogram,
+                     ta.num_calls);
+    SC_CHECK_ABORT (amr.num_total_estimated >= ideal &&
+                    amr.num_total_estimated <= ideal / .97,
+                    "Coarsen search window");
+    SC_CHECK_ABORT (!histogram || ta.num_calls <= 4, "Coarsen histogram");
+
+    /* refine to reach a larger number of elements */
+    ideal = (long) (1.5 * num_total);
+    sc_amr_error_stats (mpicomm, TEST_AMR_ELEMENTS, errors, &amr);
+    ta.num_calls = 0;
+    if (histogram) {
+      sc_amr_refine_search_histogram (sc_package_id, &amr, ideal,
+                                      amr.estats.min, .97, TEST_AMR_STEPS,
+                                      test_amr_refine, &ta);
+    }
+    else {
+      sc_amr_refine_search (sc_package_id, &amr, ideal, amr.estats.min,
+                            .97, TEST_AMR_STEPS, test_amr_refine, &ta);
+    }
+    SC_GLOBAL_INFOF ("Refine search %d took %d steps\n", histogram,
+                     ta.num_calls);
+    SC_CHECK_ABORT (amr.num_total_estimated <= ideal &&
+                    amr.num_total_estimated >= .97 * ideal,
+                    "Refine search window");
+    SC_CHECK_ABORT (!histogram || ta.num_calls <= 4, "Refine histogram");
+  }
+
+  /* search both thresholds for fewer, about as many and more elements */
+  for (i = 0; i < 3; ++i) {
+    ideal = (long) ((.8 + .3 * i) * num_total);
+    sc_amr_error_stats (mpicomm, TEST_AMR_ELEMENTS, errors, &amr);
+    ta.num_calls = 0;
+    sc_amr_joint_search (sc_package_id, &amr, ideal, 100., .97,
+                         TEST_AMR_STEPS, test_amr_coarsen, test_amr_refine,
+                         &ta);
+    SC_GLOBAL_INFOF ("Joint search for %ld took %d steps\n", ideal,
+                     ta.num_calls / 2);
+    SC_CHECK_ABORT (amr.num_total_estimated >= sqrt (.97) * ideal - 1. &&
+                    amr.num_total_estimated <= ideal / sqrt (.97),
+                    "Joint search window");
+    SC_CHECK_ABORT (amr.refine_threshold == 100. * amr.coarsen_threshold &&
+                    amr.num_total_estimated == num_total +
+                    amr.num_total_refine - amr.num_total_coarsen &&
+                    ta.num_calls <= 2 * 4, "Joint search");
+  }
+
+  SC_FREE (errors);
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 retval;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+
+  retval = sc_mpi_run (getenv ("SC_MPI_THREADS") != NULL ? 0 :
+                       TEST_AMR_RANKS, test_amr, argc, argv);
+
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return retval;
+}
@@ -0,0 +1,104 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_flops.h>
+
+#define TEST_FLOPS_N 100000
+
+/* return the lowest unused file descriptor */
+static int
+test_lowest_fd (void)
+{
+  int                 fd;
+
+  fd = dup (0);
+  SC_CHECK_ABORT (fd >= 0, "Duplicate descriptor");
+  close (fd);
+  return fd;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 i, fd, num_events, reopened;
+  long long           counts[SC_FLOPS_PERF_NUM];
+  long long           later[SC_FLOPS_PERF_NUM];
+  volatile double     sum;
+  sc_flopinfo_t       fi, snapshot;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+
+  /* counters that cannot be opened read as zero */
+  fd = test_lowest_fd ();
+  num_events = sc_flops_perf (counts);
+  SC_GLOBAL_INFOF ("Counting %d hardware events\n", num_events);
+  SC_CHECK_ABORT (0 <= num_events && num_events <= SC_FLOPS_PERF_NUM,
+                  "Number of events");
+  if (getenv ("SC_FLOPS_PERF_FP") == NULL) {
+    SC_CHECK_ABORT (counts[SC_FLOPS_PERF_FP_OPS] == 0, "No flop event");
+  }
+  if (num_events == 0) {
+    for (i = 0; i < SC_FLOPS_PERF_NUM; ++i) {
+      SC_CHECK_ABORT (counts[i] == 0, "Fallback counts");
+    }
+  }
+
+  /* the counts grow with the work done */
+  sc_flops_start (&fi);
+  sc_flops_snap (&fi, &snapshot);
+  for (sum = 0., i = 0; i < TEST_FLOPS_N; ++i) {
+    sum += 1. / (i + 1.);
+  }
+  sc_flops_shot (&fi, &snapshot);
+  SC_CHECK_ABORT (sc_flops_perf (later) == num_events, "Events changed");
+  for (i = 0; i < SC_FLOPS_PERF_NUM; ++i) {
+    SC_CHECK_ABORT (later[i] >= counts[i], "Decreasing count");
+  }
+  SC_CHECK_ABORT (snapshot.iwtime >= 0. && snapshot.icycles >= 0 &&
+                  snapshot.iinstrs >= 0, "Interval counts");
+  if (later[SC_FLOPS_PERF_INSTRUCTIONS] > 0) {
+    SC_CHECK_ABORT (snapshot.iinstrs >= TEST_FLOPS_N, "Instructions");
+  }
+  else {
+    SC_CHECK_ABORT (snapshot.iinstrs == 0 && fi.cinstrs == 0,
+                    "Fallback instructions");
+  }
+
+  /* closing releases the descriptors, and the counters can be reopened */
+  sc_flops_perf_close ();
+  SC_CHECK_ABORT (test_lowest_fd () == fd, "Descriptors not closed");
+  reopened = sc_flops_perf (counts);
+  SC_CHECK_ABORT (reopened == num_events, "Reopened events");
+
+  /* sc_finalize closes the counters again */
+  sc_finalize ();
+  SC_CHECK_ABORT (test_lowest_fd () == fd, "Descriptors left open");
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
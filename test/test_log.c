@@ -0,0 +1,114 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc.h>
+
+/* the number of evaluated log arguments and of messages handled */
+static int          test_num_evaluated = 0;
+static int          test_num_logged = 0;
+
+static int
+test_evaluate (void)
+{
+  return ++test_num_evaluated;
+}
+
+static void
+test_log_handler (FILE * log_stream, const char *filename, int lineno,
+                  int package, int category, int priority, const char *msg)
+{
+  ++test_num_logged;
+}
+
+/* log one message and check whether its argument was evaluated */
+static void
+test_filter (int package, int category, int priority, int logged)
+{
+  int                 num_evaluated = test_num_evaluated;
+  int                 num_logged = test_num_logged;
+
+  SC_GEN_LOGF (package, category, priority, "Message %d\n",
+               test_evaluate ());
+  SC_CHECK_ABORT (test_num_evaluated - num_evaluated == logged,
+                  "Argument evaluation");
+  SC_CHECK_ABORT (test_num_logged - num_logged == logged, "Cutoff");
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 root;
+  int                 quiet, loud, plain;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+  root = sc_is_root ();
+
+  /* priorities below SC_LP_INFO may be stripped at compile time */
+  quiet = sc_package_register (test_log_handler, SC_LP_PRODUCTION,
+                               "quiet", "Test package with high threshold");
+  loud = sc_package_register (test_log_handler, SC_LP_INFO,
+                              "loud", "Test package with low threshold");
+  plain = sc_package_register (test_log_handler, SC_LP_DEFAULT,
+                               "plain", "Test package with default threshold");
+
+  /* each package honors its own threshold */
+  test_filter (quiet, SC_LC_NORMAL, SC_LP_STATISTICS, 0);
+  test_filter (quiet, SC_LC_NORMAL, SC_LP_PRODUCTION, 1);
+  test_filter (loud, SC_LC_NORMAL, SC_LP_INFO, 1);
+  test_filter (plain, SC_LC_NORMAL, SC_LP_ESSENTIAL, 1);
+
+  /* global messages are only evaluated on the root */
+  test_filter (quiet, SC_LC_GLOBAL, SC_LP_STATISTICS, 0);
+  test_filter (quiet, SC_LC_GLOBAL, SC_LP_ESSENTIAL, root);
+  test_filter (loud, SC_LC_GLOBAL, SC_LP_INFO, root);
+
+  /* a new default threshold affects only packages that use it */
+  sc_set_log_defaults (NULL, NULL, SC_LP_ERROR);
+  test_filter (plain, SC_LC_NORMAL, SC_LP_ESSENTIAL, 0);
+  test_filter (plain, SC_LC_NORMAL, SC_LP_ERROR, 1);
+  test_filter (quiet, SC_LC_NORMAL, SC_LP_PRODUCTION, 1);
+
+  /* invalid package ids are filtered by the default threshold */
+  test_filter (SC_MAX_PACKAGES + 7, SC_LC_NORMAL, SC_LP_ESSENTIAL, 0);
+  test_filter (-100, SC_LC_GLOBAL, SC_LP_ESSENTIAL, 0);
+  sc_set_log_defaults (NULL, NULL, SC_LP_DEFAULT);
+  test_filter (plain, SC_LC_NORMAL, SC_LP_ESSENTIAL, 1);
+
+  /* a package registered again gets a fresh cutoff */
+  sc_package_unregister (quiet);
+  quiet = sc_package_register (test_log_handler, SC_LP_SILENT,
+                               "quiet", "Test package that never logs");
+  test_filter (quiet, SC_LC_NORMAL, SC_LP_ERROR, 0);
+
+  sc_package_unregister (quiet);
+  sc_package_unregister (loud);
+  sc_package_unregister (plain);
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
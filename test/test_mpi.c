@@ -0,0 +1,296 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_allgather.h>
+#include <sc_neighbor.h>
+#include <sc_notify.h>
+#include <sc_reduce.h>
+#include <sc_statistics.h>
+
+/* the number of ranks emulated unless SC_MPI_THREADS is set */
+#define TEST_MPI_RANKS 6
+
+#ifdef SC_MPI_RANKS
+
+/* point-to-point messages of varying size around the ring */
+static void
+test_ring (MPI_Comm mpicomm, int mpisize, int mpirank)
+{
+  int                 mpiret;
+  int                 i, count, next, prev;
+  int                 sendbuf[16], recvbuf[2][16];
+  MPI_Request         requests[3];
+  MPI_Status          status;
+
+  next = (mpirank + 1) % mpisize;
+  prev = (mpirank + mpisize - 1) % mpisize;
+  for (i = 0; i < 16; ++i) {
+    sendbuf[i] = 100 * mpirank + i;
+  }
+
+  /* the receive from any source is posted before the specific one */
+  mpiret = MPI_Irecv (recvbuf[0], 16, MPI_INT, MPI_ANY_SOURCE, 7, mpicomm,
+                      requests);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Irecv (recvbuf[1], 16, MPI_INT, prev, 7, mpicomm,
+                      requests + 1);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Isend (sendbuf, 1 + mpirank % 16, MPI_INT, next, 7, mpicomm,
+                      requests + 2);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Send (sendbuf + 1, 3, MPI_INT, next, 7, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Wait (requests, &status);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (status.MPI_SOURCE == prev && status.MPI_TAG == 7,
+                  "Ring status");
+  mpiret = MPI_Get_count (&status, MPI_INT, &count);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (count == 1 + prev % 16, "Ring count");
+  mpiret = MPI_Waitall (2, requests + 1, MPI_STATUSES_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  for (i = 0; i < count; ++i) {
+    SC_CHECK_ABORT (recvbuf[0][i] == 100 * prev + i, "Ring first");
+  }
+  for (i = 0; i < 3; ++i) {
+    SC_CHECK_ABORT (recvbuf[1][i] == 100 * prev + i + 1, "Ring second");
+  }
+
+  /* probe for the size before receiving */
+  mpiret = MPI_Send (sendbuf, mpirank % 16, MPI_INT, prev, 8, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Probe (next, 8, mpicomm, &status);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Get_count (&status, MPI_INT, &count);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (count == next % 16, "Probe count");
+  mpiret = MPI_Recv (recvbuf[0], count, MPI_INT, next, 8, mpicomm,
+                     MPI_STATUS_IGNORE);
+  SC_CHECK_MPI (mpiret);
+  for (i = 0; i < count; ++i) {
+    SC_CHECK_ABORT (recvbuf[0][i] == 100 * next + i, "Probe receive");
+  }
+}
+
+#endif /* SC_MPI_RANKS */
+
+/* the collectives of MPI and of libsc */
+static void
+test_collectives (MPI_Comm mpicomm, int mpisize, int mpirank)
+{
+  int                 mpiret;
+  int                 i, value, sum, root;
+  int                *all, *counts, *displs;
+  double              large[1 << 14], large_sum[1 << 14];
+  sc_statinfo_t       stats;
+
+  root = mpisize - 1;
+  value = mpirank == root ? 42 : -1;
+  mpiret = MPI_Bcast (&value, 1, MPI_INT, root, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (value == 42, "Bcast");
+
+  value = mpirank + 1;
+  mpiret = MPI_Allreduce (&value, &sum, 1, MPI_INT, MPI_SUM, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (sum == mpisize * (mpisize + 1) / 2, "Allreduce");
+  sum = -1;
+  mpiret = MPI_Reduce (&value, &sum, 1, MPI_INT, MPI_MAX, root, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (mpirank != root || sum == mpisize, "Reduce");
+
+  all = SC_ALLOC (int, mpisize * (mpisize + 1) / 2);
+  mpiret = MPI_Allgather (&value, 1, MPI_INT, all, 1, MPI_INT, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (i = 0; i < mpisize; ++i) {
+    SC_CHECK_ABORT (all[i] == i + 1, "Allgather");
+  }
+  mpiret = sc_allgather (&value, 1, MPI_INT, all, 1, MPI_INT, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (i = 0; i < mpisize; ++i) {
+    SC_CHECK_ABORT (all[i] == i + 1, "sc_allgather");
+  }
+
+  /* rank i contributes i + 1 copies of its value */
+  counts = SC_ALLOC (int, mpisize);
+  displs = SC_ALLOC (int, mpisize);
+  for (i = 0; i < mpisize; ++i) {
+    counts[i] = i + 1;
+    displs[i] = i * (i + 1) / 2;
+  }
+  for (i = 0; i < 16; ++i) {
+    large[i] = mpirank;
+  }
+  SC_ASSERT (mpisize <= 16);
+  mpiret = MPI_Allgatherv (large, mpirank + 1, MPI_DOUBLE, large_sum,
+                           counts, displs, MPI_DOUBLE, mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (i = 0; i < mpisize * (mpisize + 1) / 2; ++i) {
+    all[i] = (int) large_sum[i];
+  }
+  for (i = 0; i < mpisize; ++i) {
+    SC_CHECK_ABORT (all[displs[i]] == i && all[displs[i] + i] == i,
+                    "Allgatherv");
+  }
+  SC_FREE (all);
+  SC_FREE (counts);
+  SC_FREE (displs);
+
+  /* large enough for the segmented allreduce */
+  for (i = 0; i < 1 << 14; ++i) {
+    large[i] = (double) (mpirank + i);
+  }
+  mpiret = sc_allreduce (large, large_sum, 1 << 14, MPI_DOUBLE, MPI_SUM,
+                         mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (i = 0; i < 1 << 14; ++i) {
+    SC_CHECK_ABORT (large_sum[i] == (double) mpisize * i +
+                    .5 * mpisize * (mpisize - 1), "sc_allreduce");
+  }
+
+  sc_stats_set1 (&stats, (double) mpirank, "rank");
+  sc_stats_compute (mpicomm, 1, &stats);
+  SC_CHECK_ABORT (stats.count == mpisize && stats.min == 0. &&
+                  stats.max == mpisize - 1 && stats.max_at_rank == root,
+                  "sc_stats_compute");
+}
+
+/* sc_notify and the persistent requests of sc_neighbor */
+static void
+test_neighbors (MPI_Comm mpicomm, int mpisize, int mpirank)
+{
+  int                 mpiret;
+  int                 i, j, num_receivers, num_senders;
+  int                 receivers[2], *senders;
+  size_t              bytes[2];
+  sc_neighbor_t      *nb;
+
+  /* send to the next two ranks in ascending order */
+  num_receivers = mpisize > 2 ? 2 : 1;
+  receivers[0] = (mpirank + 1) % mpisize;
+  receivers[1] = (mpirank + 2) % mpisize;
+  if (num_receivers == 2 && receivers[0] > receivers[1]) {
+    receivers[0] = receivers[1];
+    receivers[1] = (mpirank + 1) % mpisize;
+  }
+  senders = SC_ALLOC (int, mpisize);
+  mpiret = sc_notify (receivers, num_receivers, senders, &num_senders,
+                      mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (num_senders == num_receivers, "Notify count");
+
+  bytes[0] = bytes[1] = sizeof (int);
+  nb = sc_neighbor_new (mpicomm, num_receivers, receivers, bytes,
+                        num_senders, senders, bytes);
+  for (i = 0; i < 3; ++i) {
+    *(int *) sc_neighbor_send_buffer (nb, 0) = mpirank + i;
+    if (num_receivers > 1) {
+      *(int *) sc_neighbor_send_buffer (nb, 1) = mpirank + i;
+    }
+    sc_neighbor_start (nb);
+    sc_neighbor_wait (nb);
+    for (j = 0; j < num_senders; ++j) {
+      SC_CHECK_ABORT (*(int *) sc_neighbor_recv_buffer (nb, j) ==
+                      senders[j] + i, "Neighbor receive");
+    }
+  }
+  sc_neighbor_destroy (nb);
+  SC_FREE (senders);
+}
+
+static int
+test_mpi (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpisize, mpirank;
+  MPI_Comm            mpicomm, selfcomm;
+#ifdef SC_MPITHREAD
+  int                 handles[2], range[2];
+#endif
+
+  /* a duplicate of MPI_COMM_SELF on one rank only is not collective */
+  mpiret = MPI_Comm_rank (MPI_COMM_WORLD, &mpirank);
+  SC_CHECK_MPI (mpiret);
+  if (mpirank == 0) {
+    mpiret = MPI_Comm_dup (MPI_COMM_SELF, &selfcomm);
+    SC_CHECK_MPI (mpiret);
+    mpiret = MPI_Comm_free (&selfcomm);
+    SC_CHECK_MPI (mpiret);
+  }
+
+  mpiret = MPI_Comm_dup (MPI_COMM_WORLD, &mpicomm);
+  SC_CHECK_MPI (mpiret);
+#ifdef SC_MPITHREAD
+  /* the emulated duplicates of MPI_COMM_WORLD agree between ranks */
+  handles[0] = (int) mpicomm;
+  handles[1] = -(int) mpicomm;
+  mpiret = MPI_Allreduce (handles, range, 2, MPI_INT, MPI_MAX,
+                          MPI_COMM_WORLD);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (range[0] == -range[1], "Communicator handles differ");
+#endif
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  if (mpisize > 16) {
+    SC_GLOBAL_PRODUCTION ("Skipping test for more than 16 ranks\n");
+  }
+  else {
+#ifdef SC_MPI_RANKS
+    SC_GLOBAL_INFOF ("Testing point-to-point on %d ranks\n", mpisize);
+    test_ring (mpicomm, mpisize, mpirank);
+#endif
+    SC_GLOBAL_INFO ("Testing collectives\n");
+    test_collectives (mpicomm, mpisize, mpirank);
+    SC_GLOBAL_INFO ("Testing notify and neighbors\n");
+    test_neighbors (mpicomm, mpisize, mpirank);
+  }
+
+  mpiret = MPI_Comm_free (&mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 retval;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+
+  retval = sc_mpi_run (getenv ("SC_MPI_THREADS") != NULL ? 0 :
+                       TEST_MPI_RANKS, test_mpi, argc, argv);
+
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return retval;
+}
@@ -0,0 +1,102 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_neighbor.h>
+
+/* the size of message kind k sent by a rank */
+static size_t
+test_bytes (int sender, int k)
+{
+  return (size_t) ((sender * 13 + k * 7) % 23 + (k == 1 ? 1000 : 0));
+}
+
+static char
+test_byte (int sender, int k, int step, size_t j)
+{
+  return (char) (sender + 3 * k + 5 * step + j);
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpirank, mpisize;
+  int                 k, step, next, prev;
+  int                 receivers[4], senders[4];
+  size_t              j, sendbytes[4], recvbytes[4];
+  char               *buffer;
+  sc_neighbor_t      *nb;
+  MPI_Comm            mpicomm;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+
+  mpicomm = MPI_COMM_WORLD;
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+
+  /* two messages to the next rank, one to the previous and one to self */
+  next = (mpirank + 1) % mpisize;
+  prev = (mpirank + mpisize - 1) % mpisize;
+  receivers[0] = receivers[1] = next;
+  receivers[2] = prev;
+  receivers[3] = mpirank;
+  senders[0] = senders[1] = prev;
+  senders[2] = next;
+  senders[3] = mpirank;
+  for (k = 0; k < 4; ++k) {
+    sendbytes[k] = test_bytes (mpirank, k);
+    recvbytes[k] = test_bytes (senders[k], k);
+  }
+  nb = sc_neighbor_new (mpicomm, 4, receivers, sendbytes,
+                        4, senders, recvbytes);
+
+  for (step = 0; step < 3; ++step) {
+    for (k = 0; k < 4; ++k) {
+      buffer = (char *) sc_neighbor_send_buffer (nb, k);
+      for (j = 0; j < sendbytes[k]; ++j) {
+        buffer[j] = test_byte (mpirank, k, step, j);
+      }
+    }
+    sc_neighbor_start (nb);
+    sc_neighbor_wait (nb);
+    for (k = 0; k < 4; ++k) {
+      buffer = (char *) sc_neighbor_recv_buffer (nb, k);
+      for (j = 0; j < recvbytes[k]; ++j) {
+        SC_CHECK_ABORTF (buffer[j] == test_byte (senders[k], k, step, j),
+                         "Neighbor message %d mismatch", k);
+      }
+    }
+  }
+  sc_neighbor_destroy (nb);
+
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -0,0 +1,123 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_node.h>
+#include <sc_notify.h>
+
+static void
+test_node (sc_node_comm_t * node)
+{
+  int                 i;
+  int                 mpiret;
+  int                 mpisize = node->mpisize;
+  int                 mpirank = node->mpirank;
+  int                 isend[2], *idata;
+  int                *senders, num_senders;
+  int                *senders2, num_senders2;
+  int                *receivers, num_receivers;
+  long                lvalue[3], lresult[3];
+
+  SC_GLOBAL_INFOF ("Testing %d nodes\n", node->num_nodes);
+
+  /* allgather */
+  isend[0] = mpirank;
+  isend[1] = -3 * mpirank;
+  idata = SC_ALLOC (int, 2 * mpisize);
+  mpiret = sc_node_allgather (node, isend, 2, MPI_INT, idata, 2, MPI_INT);
+  SC_CHECK_MPI (mpiret);
+  for (i = 0; i < mpisize; ++i) {
+    SC_CHECK_ABORT (idata[2 * i] == i && idata[2 * i + 1] == -3 * i,
+                    "Node allgather mismatch");
+  }
+  SC_FREE (idata);
+
+  /* allreduce */
+  lvalue[0] = mpirank;
+  lvalue[1] = 1;
+  lvalue[2] = -mpirank;
+  mpiret = sc_node_allreduce (node, lvalue, lresult, 3, MPI_LONG, MPI_SUM);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (lresult[0] == ((long) (mpisize - 1)) * mpisize / 2 &&
+                  lresult[1] == mpisize && lresult[2] == -lresult[0],
+                  "Node allreduce mismatch");
+  mpiret = sc_node_allreduce (node, lvalue, lresult, 3, MPI_LONG, MPI_MAX);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (lresult[0] == mpisize - 1 && lresult[1] == 1 &&
+                  lresult[2] == 0, "Node allreduce mismatch");
+
+  /* notify */
+  num_receivers = (mpirank * (mpirank % 100)) % 7;
+  num_receivers = SC_MIN (num_receivers, mpisize);
+  receivers = SC_ALLOC (int, num_receivers);
+  for (i = 0; i < num_receivers; ++i) {
+    receivers[i] = (3 * mpirank + i) % mpisize;
+  }
+  qsort (receivers, num_receivers, sizeof (int), sc_int_compare);
+
+  senders = SC_ALLOC (int, mpisize);
+  mpiret = sc_notify_allgather (receivers, num_receivers,
+                                senders, &num_senders, node->mpicomm);
+  SC_CHECK_MPI (mpiret);
+  senders2 = SC_ALLOC (int, mpisize);
+  mpiret = sc_node_notify (node, receivers, num_receivers,
+                           senders2, &num_senders2);
+  SC_CHECK_MPI (mpiret);
+
+  SC_CHECK_ABORT (num_senders == num_senders2, "Mismatched sender numbers");
+  for (i = 0; i < num_senders; ++i) {
+    SC_CHECK_ABORTF (senders[i] == senders2[i], "Mismatched sender %d", i);
+  }
+
+  SC_FREE (receivers);
+  SC_FREE (senders);
+  SC_FREE (senders2);
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 processes_per_node;
+  MPI_Comm            mpicomm;
+  sc_node_comm_t     *node;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = MPI_COMM_WORLD;
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+
+  /* the real nodes and then artificially smaller ones */
+  for (processes_per_node = 0; processes_per_node <= 3;
+       ++processes_per_node) {
+    node = sc_node_comm_new (mpicomm, processes_per_node);
+    test_node (node);
+    sc_node_comm_destroy (node);
+  }
+
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -22,8 +22,191 @@
 
 #include <sc_notify.h>
 
-int
-main (int argc, char **argv)
+#define TEST_NOTIFY_REPETITIONS 5
+
+static const int    test_distances[4] = { 0, 1, 3, 7 };
+
+/* the size of the message from sender to receiver */
+static size_t
+test_bytes (int sender, int receiver)
+{
+  return (sender * 31 + receiver * 17) % 5 == 0 ?
+    (size_t) (3 * SC_NOTIFY_EAGER_BYTES + sender) :
+    (size_t) ((sender + receiver) % 50);
+}
+
+static char
+test_byte (int sender, int receiver, size_t j)
+{
+  return (char) (sender * 7 + receiver * 3 + j);
+}
+
+/* send messages of various sizes to a few ranks and check the receipt */
+static void
+test_exchange (MPI_Comm mpicomm, int mpisize, int mpirank)
+{
+  int                 mpiret;
+  int                 i, num_receivers, sender, expected;
+  int                 receivers[4];
+  size_t              j, sendbytes[4];
+  char               *sendbufs[4];
+  sc_array_t         *senders, *offsets, *payload;
+
+  num_receivers = 0;
+  for (i = 0; i < 4 && test_distances[i] < mpisize; ++i) {
+    receivers[i] = (mpirank + test_distances[i]) % mpisize;
+    sendbytes[i] = test_bytes (mpirank, receivers[i]);
+    sendbufs[i] = SC_ALLOC (char, sendbytes[i]);
+    for (j = 0; j < sendbytes[i]; ++j) {
+      sendbufs[i][j] = test_byte (mpirank, receivers[i], j);
+    }
+    ++num_receivers;
+  }
+
+  senders = sc_array_new (sizeof (int));
+  offsets = sc_array_new (sizeof (size_t));
+  payload = sc_array_new (1);
+  mpiret = sc_notify_exchange (receivers, num_receivers, (void **) sendbufs,
+                               sendbytes, senders, offsets, payload,
+                               mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  SC_CHECK_ABORT (senders->elem_count == (size_t) num_receivers,
+                  "Mismatched exchange sender number");
+  expected = -1;
+  for (i = 0; i < num_receivers; ++i) {
+    sender = *(int *) sc_array_index_int (senders, i);
+    SC_CHECK_ABORT (sender > expected, "Unsorted exchange senders");
+    expected = sender;
+    SC_CHECK_ABORT (*(size_t *) sc_array_index_int (offsets, i + 1) -
+                    *(size_t *) sc_array_index_int (offsets, i) ==
+                    test_bytes (sender, mpirank), "Exchange size");
+    for (j = 0; j < test_bytes (sender, mpirank); ++j) {
+      SC_CHECK_ABORT (*(char *) sc_array_index
+                      (payload, *(size_t *) sc_array_index_int (offsets, i)
+                       + j) == test_byte (sender, mpirank, j),
+                      "Exchange payload");
+    }
+  }
+
+  for (i = 0; i < num_receivers; ++i) {
+    SC_FREE (sendbufs[i]);
+  }
+  sc_array_destroy (senders);
+  sc_array_destroy (offsets);
+  sc_array_destroy (payload);
+}
+
+/* compare the notify variants for increasing numbers of receivers */
+static void
+test_scaling (MPI_Comm mpicomm, int mpisize, int mpirank)
+{
+  int                 mpiret;
+  int                 i, k, m, rep, fanout;
+  int                 num_receivers, num_senders[4];
+  int                *receivers, *senders[4];
+  double              elapsed[4];
+  const char         *names[4] = {
+    "notify_allgather", "notify", "notify_radix 4", "notify_radix 8"
+  };
+
+  receivers = SC_ALLOC (int, mpisize);
+  for (m = 0; m < 4; ++m) {
+    senders[m] = SC_ALLOC (int, mpisize);
+  }
+  for (fanout = 1; fanout <= 64; fanout *= 8) {
+    /* a scattered set of receivers of about the given size */
+    num_receivers = 0;
+    for (k = 0; k < SC_MIN (fanout, mpisize); ++k) {
+      receivers[num_receivers++] =
+        (int) ((mpirank + 1 + (long) k * (2 * k + 13)) % mpisize);
+    }
+    qsort (receivers, num_receivers, sizeof (int), sc_int_compare);
+    for (i = k = 0; i < num_receivers; ++i) {
+      if (k == 0 || receivers[k - 1] != receivers[i]) {
+        receivers[k++] = receivers[i];
+      }
+    }
+    num_receivers = k;
+
+    for (m = 0; m < 4; ++m) {
+      mpiret = MPI_Barrier (mpicomm);
+      SC_CHECK_MPI (mpiret);
+      elapsed[m] = -MPI_Wtime ();
+      for (rep = 0; rep < TEST_NOTIFY_REPETITIONS; ++rep) {
+        if (m == 0) {
+          mpiret = sc_notify_allgather (receivers, num_receivers,
+                                        senders[m], num_senders + m,
+                                        mpicomm);
+        }
+        else if (m == 1) {
+          mpiret = sc_notify (receivers, num_receivers,
+                              senders[m], num_senders + m, mpicomm);
+        }
+        else {
+          mpiret = sc_notify_radix (receivers, num_receivers, senders[m],
+                                    num_senders + m, 2 << m, mpicomm);
+        }
+        SC_CHECK_MPI (mpiret);
+      }
+      elapsed[m] += MPI_Wtime ();
+      SC_CHECK_ABORT (num_senders[m] == num_senders[0] &&
+                      !memcmp (senders[m], senders[0],
+                               num_senders[0] * sizeof (int)),
+                      "Mismatched senders");
+    }
+    for (m = 0; m < 4; ++m) {
+      SC_GLOBAL_STATISTICSF ("   fanout %2d %-16s %g\n", fanout, names[m],
+                             elapsed[m] / TEST_NOTIFY_REPETITIONS);
+    }
+  }
+  for (m = 0; m < 4; ++m) {
+    SC_FREE (senders[m]);
+  }
+  SC_FREE (receivers);
+}
+
+/* change the receivers of one process in one of several steps */
+static void
+test_pattern (MPI_Comm mpicomm, int mpisize, int mpirank)
+{
+  int                 mpiret;
+  int                 step, num_receivers;
+  int                 receivers[2];
+  int                *senders, num_senders;
+  int                *senders2, num_senders2;
+  sc_notify_pattern_t *pattern;
+
+  senders = SC_ALLOC (int, mpisize);
+  senders2 = SC_ALLOC (int, mpisize);
+  pattern = sc_notify_pattern_new (mpicomm);
+  for (step = 0; step < 4; ++step) {
+    receivers[0] = (mpirank + 1) % mpisize;
+    num_receivers = 1;
+    if (step >= 2 && mpirank == mpisize - 1 && mpisize > 2) {
+      receivers[1] = mpisize - 2;
+      num_receivers = 2;
+    }
+    mpiret = sc_notify_pattern (pattern, receivers, num_receivers,
+                                senders, &num_senders);
+    SC_CHECK_MPI (mpiret);
+    mpiret = sc_notify (receivers, num_receivers, senders2, &num_senders2,
+                        mpicomm);
+    SC_CHECK_MPI (mpiret);
+    SC_CHECK_ABORT (num_senders == num_senders2 &&
+                    !memcmp (senders, senders2, num_senders * sizeof (int)),
+                    "Mismatched pattern senders");
+  }
+  SC_CHECK_ABORT (pattern->num_notify == (mpisize > 2 ? 2 : 1),
+                  "Pattern was not reused");
+  sc_notify_pattern_destroy (pattern);
+  SC_FREE (senders);
+  SC_FREE (senders2);
+}
+
+/* run by every rank, which may be emulated by threads, see sc_mpi_run */
+static int
+test_notify (int argc, char **argv)
 {
   int                 i;
   int                 mpiret;
@@ -35,16 +218,12 @@ main (int argc, char **argv)
   double              elapsed_native;
   MPI_Comm            mpicomm;
 
-  mpiret = MPI_Init (&argc, &argv);
-  SC_CHECK_MPI (mpiret);
   mpicomm = MPI_COMM_WORLD;
   mpiret = MPI_Comm_size (mpicomm, &mpisize);
   SC_CHECK_MPI (mpiret);
   mpiret = MPI_Comm_rank (mpicomm, &mpirank);
   SC_CHECK_MPI (mpiret);
 
-  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
-
   num_receivers = (mpirank * (mpirank % 100)) % 7;
   num_receivers = SC_MIN (num_receivers, mpisize);
   receivers = SC_ALLOC (int, num_receivers);
@@ -78,13 +257,41 @@ main (int argc, char **argv)
   SC_FREE (senders);
   SC_FREE (senders2);
 
+  SC_GLOBAL_INFO ("Testing sc_notify_radix\n");
+  test_scaling (mpicomm, mpisize, mpirank);
+
+  SC_GLOBAL_INFO ("Testing sc_notify_pattern\n");
+  test_pattern (mpicomm, mpisize, mpirank);
+
+  SC_GLOBAL_INFO ("Testing sc_notify_exchange\n");
+  for (i = 0; i < 3; ++i) {
+    test_exchange (mpicomm, mpisize, mpirank);
+  }
+
   SC_GLOBAL_STATISTICSF ("   notify_allgather %g\n", elapsed_allgather);
   SC_GLOBAL_STATISTICSF ("   notify           %g\n", elapsed_native);
 
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 retval;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+
+  /* with --enable-mpithread the ranks are given by SC_MPI_THREADS */
+  retval = sc_mpi_run (0, test_notify, argc, argv);
+
   sc_finalize ();
 
   mpiret = MPI_Finalize ();
   SC_CHECK_MPI (mpiret);
 
-  return 0;
+  return retval;
 }
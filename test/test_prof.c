@@ -0,0 +1,128 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_prof.h>
+
+#define TEST_PROF_LINES 16
+
+/* the report lines logged on the root process */
+static int          test_num_lines = 0;
+static char         test_lines[TEST_PROF_LINES][BUFSIZ];
+
+static void
+test_log_handler (FILE * log_stream, const char *filename, int lineno,
+                  int package, int category, int priority, const char *msg)
+{
+  SC_CHECK_ABORT (test_num_lines < TEST_PROF_LINES, "Too many lines");
+  snprintf (test_lines[test_num_lines++], BUFSIZ, "%s", msg);
+}
+
+/* check one line of the report for a region */
+static void
+test_region (int line, int depth, const char *name, int procs, long calls)
+{
+  int                 indent, lprocs;
+  char                lname[BUFSIZ];
+  double              lcalls, tmin, tavg, tmax, ratio, self;
+
+  SC_CHECK_ABORT (line < test_num_lines, "Missing region");
+  indent = (int) strspn (test_lines[line], " ");
+  SC_CHECK_ABORT (sscanf (test_lines[line], "%s %d %lf %lf %lf %lf %lf %lf",
+                          lname, &lprocs, &lcalls, &tmin, &tavg, &tmax,
+                          &ratio, &self) == 8, "Report line");
+  SC_CHECK_ABORT (indent == 2 * depth && !strcmp (lname, name), "Nesting");
+  SC_CHECK_ABORT (lprocs == procs && lcalls == (double) calls, "Calls");
+  SC_CHECK_ABORT (0. <= tmin && tmin <= tavg && tavg <= tmax &&
+                  ratio >= 1. && 0. <= self && self <= tavg, "Times");
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpisize, mpirank;
+  int                 i, j, package_id;
+  MPI_Comm            mpicomm;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpicomm = MPI_COMM_WORLD;
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+  package_id = sc_package_register (test_log_handler, SC_LP_INFO,
+                                    "test_prof", "Profiler test");
+
+  /* the same name is a different region inside another one */
+  sc_prof_init (mpicomm);
+  for (i = 0; i < 2; ++i) {
+    sc_prof_begin ("outer");
+    for (j = 0; j < 3; ++j) {
+      sc_prof_begin ("inner");
+      sc_prof_end ();
+    }
+    sc_prof_end ();
+  }
+  sc_prof_begin ("inner");
+  sc_prof_end ();
+  if (mpirank == mpisize - 1) {
+    sc_prof_begin ("last");
+    sc_prof_end ();
+  }
+
+  /* a region that is still open is not reported */
+  sc_prof_begin ("open");
+  sc_prof_report (package_id, SC_LP_INFO);
+  sc_prof_end ();
+
+  /* the regions are sorted by path with subregions after their parent */
+  if (mpirank == 0) {
+    SC_CHECK_ABORT (test_num_lines == 6 &&
+                    !strncmp (test_lines[0], "Profile of 4 regions", 20),
+                    "Report header");
+    test_region (2, 0, "inner", mpisize, 1);
+    test_region (3, 0, "last", 1, 1);
+    test_region (4, 0, "outer", mpisize, 2);
+    test_region (5, 1, "inner", mpisize, 6);
+  }
+  else {
+    SC_CHECK_ABORT (test_num_lines == 0, "Report on root only");
+  }
+
+  /* the final report includes the region closed last */
+  test_num_lines = 0;
+  sc_prof_finalize (package_id, SC_LP_INFO);
+  if (mpirank == 0) {
+    SC_CHECK_ABORT (test_num_lines == 7, "Final report");
+    test_region (4, 0, "open", mpisize, 1);
+  }
+
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
@@ -0,0 +1,214 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_ranges.h>
+
+/* the number of ranks emulated unless SC_MPI_THREADS is set */
+#define TEST_RANGES_RANKS 7
+#define TEST_RANGES_MAX 5
+
+/* decide whether a rank talks to a peer */
+static int
+test_is_peer (int rank, int peer, int mpisize)
+{
+  return peer == rank ||
+    (unsigned) (rank * 7919 + peer * 104729) % 5 < 2 ||
+    peer == (rank + 1) % mpisize;
+}
+
+static int
+test_compare_descending (const void *v1, const void *v2)
+{
+  return *(const int *) v2 - *(const int *) v1;
+}
+
+/* the fewest nonpeers that num_ranges ranges can cover, by sorting */
+static int
+test_optimal_nonpeers (int mpisize, const int *procs, int rank,
+                       int num_ranges)
+{
+  int                 j, prev, num_gaps, nonpeers;
+  int                *gaps;
+
+  gaps = SC_ALLOC (int, mpisize);
+  num_gaps = nonpeers = 0;
+  prev = -1;
+  for (j = 0; j < mpisize; ++j) {
+    if (j == rank || !procs[j]) {
+      continue;
+    }
+    if (prev >= 0 && prev < j - 1) {
+      gaps[num_gaps] = j - 1 - prev - (prev < rank && rank < j);
+      nonpeers += gaps[num_gaps++];
+    }
+    prev = j;
+  }
+  qsort (gaps, num_gaps, sizeof (int), test_compare_descending);
+  for (j = 0; j < SC_MIN (num_gaps, num_ranges - 1); ++j) {
+    nonpeers -= gaps[j];
+  }
+  SC_FREE (gaps);
+
+  return nonpeers;
+}
+
+/* the nonpeers covered by the ranges */
+static int
+test_count_nonpeers (const int *procs, int rank, int nwin,
+                     const int *ranges)
+{
+  int                 j, k, nonpeers;
+
+  nonpeers = 0;
+  for (k = 0; k < nwin; ++k) {
+    for (j = ranges[2 * k]; j <= ranges[2 * k + 1]; ++j) {
+      nonpeers += (j != rank && !procs[j]);
+    }
+  }
+
+  return nonpeers;
+}
+
+static int
+test_ranges (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpisize, mpirank;
+  int                 j, k, num_ranges;
+  int                 first_peer, last_peer, num_peers;
+  int                 inout1, inout2, max_peers, max_ranges;
+  int                 nwin, nwin_sparse;
+  int                 ranges[2 * TEST_RANGES_MAX];
+  int                 sparse[2 * TEST_RANGES_MAX];
+  int                *procs, *peers, *global_ranges;
+  int                 num_receivers, num_senders;
+  int                *receiver_ranks, *sender_ranks;
+  sc_array_t         *receivers, *senders;
+  MPI_Comm            mpicomm;
+
+  mpicomm = MPI_COMM_WORLD;
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  /* the same peers in dense and sparse form, the latter with the rank */
+  procs = SC_ALLOC (int, mpisize);
+  peers = SC_ALLOC (int, mpisize);
+  first_peer = mpisize;
+  last_peer = -1;
+  num_peers = 0;
+  for (j = 0; j < mpisize; ++j) {
+    procs[j] = test_is_peer (mpirank, j, mpisize);
+    if (procs[j]) {
+      peers[num_peers++] = j;
+      if (j != mpirank) {
+        first_peer = SC_MIN (first_peer, j);
+        last_peer = j;
+      }
+    }
+  }
+
+  receiver_ranks = SC_ALLOC (int, mpisize);
+  sender_ranks = SC_ALLOC (int, mpisize);
+  receivers = sc_array_new (sizeof (int));
+  senders = sc_array_new (sizeof (int));
+  for (num_ranges = 1; num_ranges <= TEST_RANGES_MAX; ++num_ranges) {
+    nwin = sc_ranges_compute (sc_package_id, mpisize, procs, mpirank,
+                              first_peer, last_peer, num_ranges, ranges);
+    nwin_sparse = sc_ranges_compute_sparse (sc_package_id, num_peers, peers,
+                                            mpirank, num_ranges, sparse);
+    SC_CHECK_ABORT (nwin == nwin_sparse &&
+                    !memcmp (ranges, sparse, 2 * num_ranges * sizeof (int)),
+                    "Sparse ranges");
+    SC_CHECK_ABORT (test_count_nonpeers (procs, mpirank, nwin, ranges) ==
+                    test_optimal_nonpeers (mpisize, procs, mpirank,
+                                           num_ranges), "Optimal ranges");
+    sc_ranges_statistics (sc_package_id, SC_LP_STATISTICS, mpicomm,
+                          mpisize, procs, mpirank, num_ranges, ranges);
+    sc_ranges_statistics_sparse (sc_package_id, SC_LP_STATISTICS, mpicomm,
+                                 num_peers, peers, mpirank, num_ranges,
+                                 sparse);
+
+    /* the sparse decode must agree with the global table */
+    inout1 = first_peer;
+    inout2 = last_peer;
+    nwin = sc_ranges_adaptive (sc_package_id, mpicomm, procs, &inout1,
+                               &inout2, num_ranges, ranges, &global_ranges);
+    sc_ranges_decode (mpisize, mpirank, inout2, global_ranges,
+                      &num_receivers, receiver_ranks,
+                      &num_senders, sender_ranks);
+    SC_FREE (global_ranges);
+
+    nwin_sparse = sc_ranges_adaptive_sparse (sc_package_id, mpicomm,
+                                             num_peers, peers, &max_peers,
+                                             &max_ranges, num_ranges, sparse);
+    SC_CHECK_ABORT (nwin == nwin_sparse && inout1 == max_peers &&
+                    inout2 == max_ranges, "Sparse adaptive");
+    sc_ranges_decode_sparse (nwin_sparse, sparse, mpicomm,
+                             receivers, senders);
+    SC_CHECK_ABORT ((size_t) num_receivers == receivers->elem_count &&
+                    (size_t) num_senders == senders->elem_count,
+                    "Sparse decode counts");
+    for (k = 0; k < num_receivers; ++k) {
+      SC_CHECK_ABORT (receiver_ranks[k] ==
+                      *(int *) sc_array_index_int (receivers, k),
+                      "Sparse decode receivers");
+    }
+    for (k = 0; k < num_senders; ++k) {
+      SC_CHECK_ABORT (sender_ranks[k] ==
+                      *(int *) sc_array_index_int (senders, k),
+                      "Sparse decode senders");
+    }
+  }
+
+  sc_array_destroy (receivers);
+  sc_array_destroy (senders);
+  SC_FREE (receiver_ranks);
+  SC_FREE (sender_ranks);
+  SC_FREE (procs);
+  SC_FREE (peers);
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 retval;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+
+  retval = sc_mpi_run (getenv ("SC_MPI_THREADS") != NULL ? 0 :
+                       TEST_RANGES_RANKS, test_ranges, argc, argv);
+
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return retval;
+}
@@ -21,19 +21,26 @@
 */
 
 #include <sc_reduce.h>
+#include <sc_tune.h>
 
 int
 main (int argc, char **argv)
 {
   int                 mpiret;
   int                 mpirank, mpisize;
-  int                 i, j;
+  int                 i, j, level;
   char                cvalue, cresult;
   int                 ivalue, iresult;
   unsigned short      usvalue, usresult;
   long                lvalue, lresult;
   float               fvalue[3], fresult[3], fexpect[3];
   double              dvalue, dresult;
+  int                 ivalues[2], iresults[2];
+  int                 large_count;
+  double             *dvalues, *dresults;
+  double              kvalue[2], kresult[2];
+  sc_mpi_double_int_t dloc, dlocresult;
+  sc_coll_request_t  *requests[3];
   MPI_Comm            mpicomm;
 
   mpiret = MPI_Init (&argc, &argv);
@@ -100,6 +107,107 @@ main (int argc, char **argv)
     }
   }
 
+  /* test allreduce of the remaining built-in operations */
+  ivalues[0] = (mpirank % 3 == 0) ? -1 : 1;
+  sc_allreduce (ivalues, iresults, 1, MPI_INT, MPI_PROD, mpicomm);
+  SC_CHECK_ABORT (iresults[0] == ((mpisize + 2) / 3 % 2 ? -1 : 1),
+                  "Allreduce prod mismatch");
+  ivalues[0] = 1 << (mpirank % 16);
+  ivalues[1] = ~(1 << (mpirank % 16));
+  sc_allreduce (ivalues, iresults, 1, MPI_INT, MPI_BOR, mpicomm);
+  SC_CHECK_ABORT (iresults[0] == (1 << SC_MIN (mpisize, 16)) - 1,
+                  "Allreduce bor mismatch");
+  sc_allreduce (ivalues + 1, iresults + 1, 1, MPI_INT, MPI_BAND, mpicomm);
+  SC_CHECK_ABORT (iresults[1] == ~((1 << SC_MIN (mpisize, 16)) - 1),
+                  "Allreduce band mismatch");
+  ivalues[0] = mpirank != 0;
+  ivalues[1] = mpirank == mpisize - 1;
+  sc_allreduce (ivalues, iresults, 1, MPI_INT, MPI_LAND, mpicomm);
+  sc_allreduce (ivalues + 1, iresults + 1, 1, MPI_INT, MPI_LOR, mpicomm);
+  SC_CHECK_ABORT (iresults[0] == 0 && iresults[1] == 1,
+                  "Allreduce logical mismatch");
+  dloc.value = (double) (mpirank % 4);
+  dloc.index = mpirank;
+  sc_allreduce (&dloc, &dlocresult, 1, MPI_DOUBLE_INT, MPI_MAXLOC, mpicomm);
+  SC_CHECK_ABORT (dlocresult.index == SC_MIN (mpisize - 1, 3),
+                  "Allreduce maxloc mismatch");
+  sc_allreduce (&dloc, &dlocresult, 1, MPI_DOUBLE_INT, MPI_MINLOC, mpicomm);
+  SC_CHECK_ABORT (dlocresult.index == 0, "Allreduce minloc mismatch");
+
+  /* test compensated summation where plain summation loses digits */
+  kvalue[0] = mpirank == 0 ? 1.e16 : mpirank == 1 ? -1.e16 : 1.;
+  kvalue[1] = 0.;
+  sc_allreduce_custom (kvalue, kresult, 2, MPI_DOUBLE, sc_reduce_kahan_sum,
+                       mpicomm);
+  SC_CHECK_ABORT (kresult[0] + kresult[1] ==   /* ok */
+                  (mpisize == 1 ? 1.e16 : (double) (mpisize - 2)),
+                  "Compensated sum mismatch");
+
+  /* test allreduce and reduce with all-to-all from various levels */
+  for (level = 0; level <= 4; ++level) {
+    sc_tune_set (-1, level);
+    lvalue = (long) mpirank;
+    sc_allreduce (&lvalue, &lresult, 1, MPI_LONG, MPI_SUM, mpicomm);
+    SC_CHECK_ABORT (lresult == ((long) (mpisize - 1)) * mpisize / 2,
+                    "Allreduce mismatch");
+    sc_reduce (&lvalue, &lresult, 1, MPI_LONG, MPI_MAX, mpisize / 2,
+               mpicomm);
+    if (mpirank == mpisize / 2) {
+      SC_CHECK_ABORT (lresult == mpisize - 1, "Reduce mismatch");
+    }
+  }
+  sc_tune_init (mpicomm);      /* restore the settings of sc_init */
+
+  /* test the segmented allreduce of large messages */
+  large_count = (int) (3 * SC_REDUCE_LARGE_BYTES / sizeof (double)) + 7;
+  dvalues = SC_ALLOC (double, large_count);
+  dresults = SC_ALLOC (double, large_count);
+  for (i = 0; i < large_count; ++i) {
+    dvalues[i] = (double) ((mpirank + i) % 13);
+  }
+  sc_allreduce (dvalues, dresults, large_count, MPI_DOUBLE, MPI_MAX,
+                mpicomm);
+  for (i = 0; i < large_count; ++i) {
+    SC_CHECK_ABORTF (dresults[i] ==     /* ok */
+                     (double) (mpisize >= 13 ? 12 :
+                               (i % 13 + mpisize - 1 < 13 ?
+                                i % 13 + mpisize - 1 : 12)),
+                     "Large allreduce max mismatch in %d", i);
+  }
+  for (i = 0; i < large_count; ++i) {
+    dvalues[i] = (double) (mpirank + i % 5);
+  }
+  sc_allreduce (dvalues, dresults, large_count, MPI_DOUBLE, MPI_SUM,
+                mpicomm);
+  for (i = 0; i < large_count; ++i) {
+    SC_CHECK_ABORTF (dresults[i] ==     /* ok */
+                     ((double) (mpisize - 1)) * mpisize / 2. +
+                     (double) (i % 5) * mpisize,
+                     "Large allreduce sum mismatch in %d", i);
+  }
+  SC_FREE (dvalues);
+  SC_FREE (dresults);
+
+  /* test several nonblocking reductions in flight at once */
+  ivalues[0] = mpirank;
+  ivalues[1] = -mpirank;
+  lvalue = (long) mpirank;
+  sc_iallreduce (ivalues, iresults, 2, MPI_INT, MPI_MIN, mpicomm,
+                 requests + 0);
+  sc_ireduce (&lvalue, &lresult, 1, MPI_LONG, MPI_SUM, mpisize - 1,
+              mpicomm, requests + 1);
+  sc_iallreduce (&dvalue, &dresult, 1, MPI_DOUBLE, MPI_MAX, mpicomm,
+                 requests + 2);
+  sc_coll_waitall (3, requests);
+  SC_CHECK_ABORT (iresults[0] == 0 && iresults[1] == 1 - mpisize,
+                  "Nonblocking allreduce mismatch");
+  if (mpirank == mpisize - 1) {
+    SC_CHECK_ABORT (lresult == ((long) (mpisize - 1)) * mpisize / 2,
+                    "Nonblocking reduce mismatch");
+  }
+  SC_CHECK_ABORT (dresult == (double) (mpisize - 1),    /* ok */
+                  "Nonblocking allreduce mismatch");
+
   sc_finalize ();
 
   mpiret = MPI_Finalize ();
@@ -0,0 +1,135 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_reprosum.h>
+#include <sc_statistics.h>
+
+#define TEST_REPROSUM_N 5000
+
+/* a deterministic sequence of values of wildly different magnitudes */
+static double
+test_value (int j)
+{
+  return ldexp ((double) ((j * 7919) % 1001 - 500), (j * 31) % 160 - 80);
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpirank, mpisize;
+  int                 i, j;
+  double              reference, result;
+  double              values[2], results[2], expect[2];
+  sc_reprosum_t       sum, sums[2];
+  sc_statinfo_t       stats;
+  MPI_Comm            mpicomm;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+
+  mpicomm = MPI_COMM_WORLD;
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (mpicomm, 1, 1, NULL, SC_LP_DEFAULT);
+
+  /* test exact rounding of sums that lose digits in plain summation */
+  sc_reprosum_init (&sum);
+  for (i = 0; i < 10; ++i) {
+    sc_reprosum_add (&sum, .1);
+  }
+  SC_CHECK_ABORT (sc_reprosum_value (&sum) == 1.,       /* ok */
+                  "Reproducible sum of tenths");
+  sc_reprosum_init (&sum);
+  sc_reprosum_add (&sum, 1.e16);
+  sc_reprosum_add (&sum, 1.);
+  sc_reprosum_add (&sum, -1.e16);
+  sc_reprosum_add (&sum, -ldexp (1., -1073));
+  sc_reprosum_add (&sum, ldexp (3., -1074));
+  SC_CHECK_ABORT (sc_reprosum_value (&sum) == 1.,        /* ok */
+                  "Reproducible sum of cancellation");
+  sc_reprosum_init (&sum);
+  sc_reprosum_add (&sum, -ldexp (1., -1073));
+  sc_reprosum_add (&sum, ldexp (3., -1074));
+  SC_CHECK_ABORT (sc_reprosum_value (&sum) == ldexp (1., -1074),
+                  "Reproducible sum of subnormals");
+  sc_reprosum_init (&sum);
+  for (i = 0; i < (1 << 23) + 5; ++i) {
+    sc_reprosum_add (&sum, -1.);
+  }
+  SC_CHECK_ABORT (sc_reprosum_value (&sum) == -(double) ((1 << 23) + 5),
+                  "Reproducible sum of many values");
+  sc_reprosum_add (&sum, HUGE_VAL);
+  SC_CHECK_ABORT (sc_reprosum_value (&sum) == HUGE_VAL,
+                  "Reproducible sum of infinity");
+  sc_reprosum_add (&sum, -HUGE_VAL);
+  result = sc_reprosum_value (&sum);
+  SC_CHECK_ABORT (result != result, "Reproducible sum of NaN");
+
+  /* the parallel sum is bitwise identical to the serial one */
+  sc_reprosum_init (&sum);
+  for (j = TEST_REPROSUM_N - 1; j >= 0; --j) {
+    sc_reprosum_add (&sum, test_value (j));
+  }
+  reference = sc_reprosum_value (&sum);
+  sc_reprosum_init (sums + 0);
+  sc_reprosum_init (sums + 1);
+  for (j = mpirank; j < TEST_REPROSUM_N; j += mpisize) {
+    sc_reprosum_add (sums + 0, test_value (j));
+    sc_reprosum_add (sums + 1, -test_value (j));
+  }
+  sc_reprosum_allreduce (sums, 2, mpicomm);
+  SC_CHECK_ABORT (sc_reprosum_value (sums + 0) == reference &&
+                  sc_reprosum_value (sums + 1) == -reference,
+                  "Reproducible allreduce mismatch");
+
+  /* test the replacement of sc_allreduce */
+  values[0] = .1 * (mpirank + 1);
+  values[1] = mpirank == 0 ? 1.e16 : mpirank == 1 ? -1.e16 : 1.;
+  sc_reprosum_init (sums + 0);
+  sc_reprosum_init (sums + 1);
+  for (i = mpisize - 1; i >= 0; --i) {
+    sc_reprosum_add (sums + 0, .1 * (i + 1));
+    sc_reprosum_add (sums + 1, i == 0 ? 1.e16 : i == 1 ? -1.e16 : 1.);
+  }
+  expect[0] = sc_reprosum_value (sums + 0);
+  expect[1] = sc_reprosum_value (sums + 1);
+  sc_allreduce_reproducible (values, results, 2, mpicomm);
+  SC_CHECK_ABORT (results[0] == expect[0] && results[1] == expect[1],
+                  "Reproducible sc_allreduce mismatch");
+
+  /* test the statistics with reproducible sums */
+  sc_stats_set1 (&stats, values[1], "Reproducible");
+  sc_stats_compute_reproducible (mpicomm, 1, &stats);
+  SC_CHECK_ABORT (stats.count == mpisize && stats.sum_values == expect[1],
+                  "Reproducible statistics mismatch");
+
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
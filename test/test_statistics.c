@@ -0,0 +1,240 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_statistics.h>
+
+/* the number of ranks emulated unless SC_MPI_THREADS is set */
+#define TEST_STATISTICS_RANKS 5
+#define TEST_STATISTICS_VALUES 200
+#define TEST_STATISTICS_THREADS 3
+
+static int
+test_statistics (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpisize, mpirank;
+  int                 i, k;
+  long                num_values;
+  double              value, exact, estimate, variance;
+  const double        q[5] = { 0., .25, .5, .9, .99 };
+  int                 nsteps[2];
+  sc_statinfo_t       stats[3], step_stats[2][2];
+  sc_statinfo_t      *steps[2], *si;
+  sc_statistics_t    *dyn, *sets[2];
+  sc_stats_pending_t *pending[2];
+  sc_statistics_local_t *local[TEST_STATISTICS_THREADS];
+  MPI_Comm            mpicomm;
+
+  mpicomm = MPI_COMM_WORLD;
+  mpiret = MPI_Comm_size (mpicomm, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  /* the global values are a shifted and a centered sequence of integers */
+  num_values = (long) mpisize * TEST_STATISTICS_VALUES;
+  sc_stats_init (stats + 0, "Shifted");
+  sc_stats_init_quantiles (stats + 1, "Positive");
+  sc_stats_init_quantiles (stats + 2, "Centered");
+  for (i = 0; i < TEST_STATISTICS_VALUES; ++i) {
+    k = mpirank + mpisize * i;
+    sc_stats_accumulate (stats + 0, 1.e9 + k);
+    sc_stats_accumulate (stats + 1, 1. + k);
+    sc_stats_accumulate (stats + 2, k - .5 * num_values);
+  }
+  sc_stats_compute (mpicomm, 3, stats);
+  sc_stats_print (sc_package_id, SC_LP_STATISTICS, 3, stats, 1, 0);
+  sc_stats_print (sc_package_id, SC_LP_STATISTICS, 3, stats, 0, 1);
+
+  /* the variance does not suffer from cancellation */
+  variance = ((double) num_values * num_values - 1.) / 12.;
+  SC_CHECK_ABORT (stats[0].count == num_values &&
+                  fabs (stats[0].average - (1.e9 + .5 * (num_values - 1)))
+                  <= 1.e-6 &&
+                  fabs (stats[0].variance - variance) <= 1.e-9 * variance,
+                  "Welford variance");
+
+  /* quantiles are accurate to the relative error of the sketch */
+  for (k = 1; k <= 2; ++k) {
+    for (i = 0; i < 5; ++i) {
+      exact = floor (q[i] * (num_values - 1)) + stats[k].min;
+      estimate = sc_stats_quantile (stats + k, q[i]);
+      SC_CHECK_ABORT (fabs (estimate - exact) <= .0101 * fabs (exact),
+                      "Sketch quantile");
+    }
+  }
+  sc_stats_free_quantiles (stats + 1);
+  sc_stats_free_quantiles (stats + 2);
+
+  /* one value per process with quantiles over the processes */
+  dyn = sc_statistics_new (mpicomm);
+  sc_statistics_add_quantiles (dyn, "Rank");
+  sc_statistics_add (dyn, "Value");
+  for (k = 0; k < 2; ++k) {
+    value = (double) (mpirank + k);
+    sc_statistics_set (dyn, "Rank", value);
+    sc_statistics_set (dyn, "Value", value);
+    sc_statistics_compute (dyn);
+    sc_statistics_print (dyn, sc_package_id, SC_LP_STATISTICS, 1, 0);
+  }
+  sc_statistics_destroy (dyn);
+
+  /* several sets and steps in one fused reduction */
+  steps[0] = step_stats[0];
+  steps[1] = step_stats[1];
+  sets[0] = sc_statistics_new (mpicomm);
+  sets[1] = sc_statistics_new (mpicomm);
+  sc_statistics_add_empty (sets[0], "First");
+  sc_statistics_add_quantiles (sets[1], "Second");
+  sc_statistics_accumulate (sets[0], "First", (double) mpirank);
+  sc_statistics_accumulate (sets[1], "Second", 1. + mpirank);
+  for (k = 0; k < 2; ++k) {
+    sc_stats_set1 (steps[k], (double) k, "Step");
+    sc_stats_set1 (steps[k] + 1, (double) (k * mpirank), "Step rank");
+    nsteps[k] = 2;
+  }
+  pending[0] = sc_statistics_compute_begin (2, sets);
+  pending[1] = sc_stats_compute_begin (mpicomm, 2, nsteps, steps);
+  sc_stats_compute_end (pending[1]);
+  sc_stats_compute_end (pending[0]);
+  sc_statistics_print (sets[1], sc_package_id, SC_LP_STATISTICS, 0, 0);
+  si = (sc_statinfo_t *) sc_array_index (sets[0]->sarray, 0);
+  SC_CHECK_ABORT (si->count == mpisize && si->max == mpisize - 1 &&
+                  !si->dirty, "Fused first");
+  si = (sc_statinfo_t *) sc_array_index (sets[1]->sarray, 0);
+  SC_CHECK_ABORT (si->count == mpisize && si->min == 1. &&
+                  fabs (sc_stats_quantile (si, .5) -
+                        floor (.5 * (mpisize - 1)) - 1.) <=
+                  .0101 * mpisize, "Fused second");
+  for (k = 0; k < 2; ++k) {
+    SC_CHECK_ABORT (steps[k][0].count == mpisize &&
+                    steps[k][0].average == (double) k &&
+                    steps[k][1].max == (double) (k * (mpisize - 1)),
+                    "Fused steps");
+  }
+  sc_statistics_destroy (sets[0]);
+  sc_statistics_destroy (sets[1]);
+
+  /* accumulate by id into buffers as if by several threads */
+  dyn = sc_statistics_new (mpicomm);
+  SC_CHECK_ABORT (sc_statistics_add_empty (dyn, "Direct") == 0 &&
+                  sc_statistics_add_quantiles (dyn, "Buffered") == 1 &&
+                  sc_statistics_id (dyn, "Buffered") == 1, "Ids");
+  for (k = 0; k < TEST_STATISTICS_THREADS; ++k) {
+    local[k] = sc_statistics_local_new (dyn);
+  }
+  for (i = 0; i < TEST_STATISTICS_VALUES; ++i) {
+    value = 1.e9 + mpirank + mpisize * i;
+    sc_statistics_accumulate_id (dyn, 0, value);
+    sc_statistics_local_accumulate (local[i % TEST_STATISTICS_THREADS], 1,
+                                    value);
+  }
+  for (k = 0; k < TEST_STATISTICS_THREADS; ++k) {
+    sc_statistics_local_merge (local[k]);
+    sc_statistics_local_destroy (local[k]);
+  }
+  sc_statistics_compute (dyn);
+  si = (sc_statinfo_t *) sc_array_index (dyn->sarray, 0);
+  stats[0] = *(sc_statinfo_t *) sc_array_index (dyn->sarray, 1);
+  SC_CHECK_ABORT (si->count == num_values && stats[0].count == num_values &&
+                  si->min == stats[0].min && si->max == stats[0].max &&
+                  si->sum_values == stats[0].sum_values &&
+                  fabs (si->variance - variance) <= 1.e-9 * variance &&
+                  fabs (stats[0].variance - variance) <= 1.e-9 * variance,
+                  "Buffered accumulation");
+  sc_statistics_destroy (dyn);
+
+  sc_stats_init_quantiles (stats + 0, "Compute1");
+  stats[0].sum_values = (double) mpirank;
+  sc_stats_compute1 (mpicomm, 1, stats);
+  exact = floor (.5 * (mpisize - 1));
+  estimate = sc_stats_quantile (stats, .5);
+  SC_CHECK_ABORT (stats[0].count == mpisize &&
+                  fabs (estimate - exact) <= .0101 * exact, "Compute1");
+  sc_stats_free_quantiles (stats + 0);
+
+  /* records filled by hand derive the moments from the sums,
+     both in zeroed memory and after sc_stats_init of reused memory */
+  for (k = 0; k < 2; ++k) {
+    memset (stats + k, k ? 0xa5 : 0, sizeof (sc_statinfo_t));
+    if (k) {
+      sc_stats_init (stats + k, NULL);
+    }
+    stats[k].dirty = 1;
+    stats[k].count = 3;
+    stats[k].sum_values = 6.;
+    stats[k].sum_squares = 14.;
+    stats[k].min = 1.;
+    stats[k].max = 3.;
+    stats[k].variable = "By hand";
+  }
+  sc_stats_compute (mpicomm, 2, stats);
+  sc_stats_print (sc_package_id, SC_LP_STATISTICS, 2, stats, 1, 1);
+  for (k = 0; k < 2; ++k) {
+    SC_CHECK_ABORT (stats[k].count == 3 * mpisize &&
+                    fabs (stats[k].average - 2.) <= 1.e-12 &&
+                    fabs (stats[k].variance - 2. / 3.) <= 1.e-12,
+                    "Filled by hand");
+  }
+
+  /* reuse a computed record by hand and with compute1 */
+  stats[0].dirty = 1;
+  stats[0].count = 2;
+  stats[0].sum_values = 4.;
+  stats[0].sum_squares = 8.;
+  sc_stats_accumulate (stats + 0, 5.);
+  memset (stats + 1, 0xa5, sizeof (sc_statinfo_t));
+  sc_stats_init (stats + 1, NULL);
+  stats[1].sum_values = (double) mpirank;
+  stats[1].variable = "Compute1 by hand";
+  sc_stats_compute1 (mpicomm, 1, stats + 1);
+  sc_stats_compute (mpicomm, 1, stats);
+  SC_CHECK_ABORT (stats[0].count == 3 * mpisize &&
+                  fabs (stats[0].average - 3.) <= 1.e-12 &&
+                  fabs (stats[0].variance - 2.) <= 1.e-12 &&
+                  stats[1].count == mpisize &&
+                  stats[1].max == (double) (mpisize - 1), "Reuse by hand");
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 retval;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+
+  retval = sc_mpi_run (getenv ("SC_MPI_THREADS") != NULL ? 0 :
+                       TEST_STATISTICS_RANKS, test_statistics, argc, argv);
+
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return retval;
+}
@@ -0,0 +1,146 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc.h>
+#ifdef SC_PTHREAD
+#include <pthread.h>
+#endif
+#include <sys/wait.h>
+
+#define TEST_THREADS 4
+#define TEST_THREADS_ROUNDS 200
+
+/* the thread that aborts in the child process, or -1 */
+static int          test_abort_thread = -1;
+static char         test_names[TEST_THREADS][BUFSIZ];
+
+/* log, allocate and register a package concurrently with other threads */
+static void        *
+test_thread (void *arg)
+{
+  int                 id = *(int *) arg;
+  int                 i, package;
+  char               *name = test_names[id];
+  void               *mem;
+
+  snprintf (name, BUFSIZ, "thread%d", id);
+  package = sc_package_register (NULL, SC_LP_ERROR, name, "Test thread");
+  for (i = 0; i < TEST_THREADS_ROUNDS; ++i) {
+    mem = SC_ALLOC (char, 1 + i);
+    sc_free (package, sc_malloc (package, 1 + i));
+    SC_GEN_LOGF (package, SC_LC_NORMAL, SC_LP_INFO,
+                 "Filtered %d %s\n", i, name);
+    if (i % 20 == 0) {
+      SC_LERRORF ("Thread %d round %d\n", id, i);
+    }
+    SC_FREE (mem);
+    if (id == test_abort_thread && i == TEST_THREADS_ROUNDS / 2) {
+      SC_ABORTF ("Thread %d aborts", id);
+    }
+  }
+  sc_package_unregister (package);
+  return NULL;
+}
+
+/* run the function on several threads */
+static void
+test_run_threads (void)
+{
+  int                 i;
+  int                 ids[TEST_THREADS];
+#ifdef SC_PTHREAD
+  pthread_t           threads[TEST_THREADS];
+
+  for (i = 0; i < TEST_THREADS; ++i) {
+    ids[i] = i;
+    SC_CHECK_ABORT (!pthread_create (threads + i, NULL, test_thread,
+                                     ids + i), "Thread create");
+  }
+  for (i = 0; i < TEST_THREADS; ++i) {
+    SC_CHECK_ABORT (!pthread_join (threads[i], NULL), "Thread join");
+  }
+#else
+  for (i = 0; i < TEST_THREADS; ++i) {
+    ids[i] = i;
+    test_thread (ids + i);
+  }
+#endif
+}
+
+/* count the lines of a file that contain a string */
+static int
+test_count_lines (FILE * file, const char *s)
+{
+  int                 count = 0;
+  char                line[BUFSIZ];
+
+  rewind (file);
+  while (fgets (line, BUFSIZ, file) != NULL) {
+    count += strstr (line, s) != NULL;
+  }
+  return count;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 status;
+  pid_t               pid;
+  FILE               *output;
+
+  /* a thread aborts a child process that runs without MPI */
+  output = tmpfile ();
+  SC_CHECK_ABORT (output != NULL, "Temporary file");
+  fflush (stdout);
+  pid = fork ();
+  SC_CHECK_ABORT (pid >= 0, "Fork");
+  if (pid == 0) {
+    dup2 (fileno (output), STDOUT_FILENO);
+    dup2 (fileno (output), STDERR_FILENO);
+    sc_init (MPI_COMM_NULL, 0, 0, NULL, SC_LP_DEFAULT);
+    test_abort_thread = TEST_THREADS - 1;
+    test_run_threads ();
+    _exit (0);
+  }
+  SC_CHECK_ABORT (waitpid (pid, &status, 0) == pid, "Wait");
+  SC_CHECK_ABORT (WIFSIGNALED (status) && WTERMSIG (status) == SIGABRT,
+                  "Child not aborted");
+  SC_CHECK_ABORT (test_count_lines (output, "Abort: Thread 3 aborts") == 1,
+                  "Abort message");
+  SC_CHECK_ABORT (test_count_lines (output, "Filtered") == 0 &&
+                  test_count_lines (output, "round 100") == TEST_THREADS,
+                  "Concurrent logging");
+  fclose (output);
+
+  /* the threads log and count memory concurrently */
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+  test_run_threads ();
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
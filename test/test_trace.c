@@ -0,0 +1,176 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_trace.h>
+#ifdef SC_PTHREAD
+#include <pthread.h>
+#endif
+
+#define TEST_TRACE_NAME "sc_test_trace"
+#define TEST_TRACE_CAPACITY 64
+#define TEST_TRACE_SIZE "64"
+#define TEST_TRACE_THREADS 4
+#define TEST_TRACE_RECORDS 25
+
+/* log records that are traced but not printed */
+static void        *
+test_log (void *arg)
+{
+  int                 i;
+
+  for (i = 0; i < TEST_TRACE_RECORDS; ++i) {
+    SC_STATISTICSF ("Traced record %d\n", i);
+  }
+  return arg;
+}
+
+/* check the records of a merged trace
+ * \return          The number of records written by this file. */
+static int
+test_check (FILE * merged, int json, int mpisize)
+{
+  int                 num_records, num_test;
+  int                 rank;
+  double              seconds, previous;
+  char                line[BUFSIZ], location[BUFSIZ], *s;
+
+  rewind (merged);
+  num_records = num_test = 0;
+  previous = 0.;
+  if (json) {
+    SC_CHECK_ABORT (fgets (line, BUFSIZ, merged) != NULL &&
+                    !strcmp (line, "{\"traceEvents\":[\n"), "JSON begin");
+  }
+  while (fgets (line, BUFSIZ, merged) != NULL) {
+    if (json) {
+      if (line[0] == ']') {
+        SC_CHECK_ABORT (fgets (line, BUFSIZ, merged) == NULL, "JSON end");
+        break;
+      }
+      s = strstr (line, "\"name\":\"");
+      SC_CHECK_ABORT (s != NULL && sscanf (s + 8, "%[^\"]", location) == 1,
+                      "JSON name");
+      s = strstr (line, "\"ts\":");
+      SC_CHECK_ABORT (s != NULL && sscanf (s + 5, "%lf", &seconds) == 1,
+                      "JSON time");
+      s = strstr (line, "\"pid\":");
+      SC_CHECK_ABORT (s != NULL && sscanf (s + 6, "%d", &rank) == 1,
+                      "JSON rank");
+    }
+    else {
+      SC_CHECK_ABORT (sscanf (line, "%lf %d %*s %s", &seconds, &rank,
+                              location) == 3, "Text line");
+    }
+    SC_CHECK_ABORT (seconds >= previous, "Records out of order");
+    SC_CHECK_ABORT (0 <= rank && rank < mpisize, "Record rank");
+    previous = seconds;
+    ++num_records;
+    num_test += !strncmp (location, "test_trace.c:", 13);
+  }
+
+  /* the rings keep the most recent records, which are those of the test */
+  SC_CHECK_ABORT (num_test == num_records, "Records of the test");
+  return num_records;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpisize, mpirank;
+  int                 i, json, num_logged;
+  char              **filenames;
+  char                own[BUFSIZ];
+  FILE               *merged;
+#ifdef SC_PTHREAD
+  pthread_t           threads[TEST_TRACE_THREADS];
+#endif
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_size (MPI_COMM_WORLD, &mpisize);
+  SC_CHECK_MPI (mpiret);
+  mpiret = MPI_Comm_rank (MPI_COMM_WORLD, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  /* every process writes a small ring of records from several threads */
+  setenv ("SC_TRACE_BINARY", TEST_TRACE_NAME, 1);
+  setenv ("SC_TRACE_BINARY_SIZE", TEST_TRACE_SIZE, 1);
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_ESSENTIAL);
+#ifdef SC_PTHREAD
+  for (i = 0; i < TEST_TRACE_THREADS; ++i) {
+    SC_CHECK_ABORT (!pthread_create (threads + i, NULL, test_log, NULL),
+                    "Thread create");
+  }
+  for (i = 0; i < TEST_TRACE_THREADS; ++i) {
+    SC_CHECK_ABORT (!pthread_join (threads[i], NULL), "Thread join");
+  }
+#else
+  for (i = 0; i < TEST_TRACE_THREADS; ++i) {
+    test_log (NULL);
+  }
+#endif
+  sc_finalize ();
+  unsetenv ("SC_TRACE_BINARY");
+  num_logged = TEST_TRACE_THREADS * TEST_TRACE_RECORDS;
+  SC_CHECK_ABORT (num_logged > TEST_TRACE_CAPACITY, "Ring not full");
+
+  /* merge the files of all processes as text and as JSON */
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+  mpiret = MPI_Barrier (MPI_COMM_WORLD);
+  SC_CHECK_MPI (mpiret);
+  if (mpirank == 0) {
+    filenames = SC_ALLOC (char *, mpisize);
+    for (i = 0; i < mpisize; ++i) {
+      filenames[i] = SC_ALLOC (char, BUFSIZ);
+      snprintf (filenames[i], BUFSIZ, "%s.%d.bin", TEST_TRACE_NAME, i);
+    }
+    for (json = 0; json < 2; ++json) {
+      merged = tmpfile ();
+      SC_CHECK_ABORT (merged != NULL, "Temporary file");
+      SC_CHECK_ABORT (!sc_trace_merge (mpisize, filenames, json, merged),
+                      "Merge");
+      SC_CHECK_ABORT (test_check (merged, json, mpisize) ==
+                      mpisize * TEST_TRACE_CAPACITY, "Number of records");
+      fclose (merged);
+    }
+
+    /* a missing input is an error */
+    snprintf (filenames[0], BUFSIZ, "%s.missing.bin", TEST_TRACE_NAME);
+    SC_CHECK_ABORT (sc_trace_merge (mpisize, filenames, 0, stdout) == -1,
+                    "Missing input");
+    for (i = 0; i < mpisize; ++i) {
+      SC_FREE (filenames[i]);
+    }
+    SC_FREE (filenames);
+  }
+  mpiret = MPI_Barrier (MPI_COMM_WORLD);
+  SC_CHECK_MPI (mpiret);
+  snprintf (own, BUFSIZ, "%s.%d.bin", TEST_TRACE_NAME, mpirank);
+  remove (own);
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return 0;
+}
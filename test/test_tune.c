@@ -0,0 +1,105 @@
+/*
+  This file is part of the SC Library.
+  The SC Library provides support for parallel scientific applications.
+
+  Copyright (C) 2010 The University of Texas System
+
+  The SC Library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  The SC Library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the SC Library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+*/
+
+#include <sc_reduce.h>
+#include <sc_tune.h>
+
+/* the number of ranks emulated unless SC_MPI_THREADS is set */
+#define TEST_TUNE_RANKS 4
+#define TEST_TUNE_FILE "sc_test_tune.cache"
+
+static int
+test_tune (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 mpirank;
+  int                 c;
+  int                 ag_max[SC_TUNE_NUM_SIZES], level[SC_TUNE_NUM_SIZES];
+  size_t              datasize;
+  MPI_Comm            mpicomm;
+
+  mpicomm = MPI_COMM_WORLD;
+  mpiret = MPI_Comm_rank (mpicomm, &mpirank);
+  SC_CHECK_MPI (mpiret);
+
+  /* emulated ranks share the thresholds and wait for each other */
+  sc_tune_run (mpicomm);
+  for (c = 0; c < SC_TUNE_NUM_SIZES; ++c) {
+    datasize = (size_t) 1 << c;
+    ag_max[c] = sc_tune_ag_alltoall_max (datasize);
+    level[c] = sc_tune_reduce_alltoall_level (datasize);
+    SC_CHECK_ABORT (ag_max[c] >= 1 && level[c] >= 0, "Tuned thresholds");
+
+    /* the reduce level is not measured where sc_allreduce ignores it */
+    if (c > 0 && datasize >= (size_t) SC_REDUCE_LARGE_BYTES) {
+      SC_CHECK_ABORT (level[c] == level[c - 1], "Large reduce level");
+    }
+  }
+  mpiret = MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+
+  /* the thresholds survive a round trip through the cache file */
+  SC_CHECK_ABORT (!sc_tune_save (TEST_TUNE_FILE, mpicomm), "Save");
+  mpiret = MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  sc_tune_set (ag_max[0] + 1, level[0] + 1);
+  SC_CHECK_ABORT (sc_tune_load (TEST_TUNE_FILE ".missing", mpicomm) == -1 &&
+                  sc_tune_ag_alltoall_max (1) == ag_max[0] + 1, "Missing");
+  mpiret = MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  SC_CHECK_ABORT (!sc_tune_load (TEST_TUNE_FILE, mpicomm), "Load");
+  mpiret = MPI_Barrier (mpicomm);
+  SC_CHECK_MPI (mpiret);
+  for (c = 0; c < SC_TUNE_NUM_SIZES; ++c) {
+    datasize = (size_t) 1 << c;
+    SC_CHECK_ABORT (sc_tune_ag_alltoall_max (datasize) == ag_max[c] &&
+                    sc_tune_reduce_alltoall_level (datasize) == level[c],
+                    "Round trip");
+  }
+  if (mpirank == 0) {
+    remove (TEST_TUNE_FILE);
+  }
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int                 mpiret;
+  int                 retval;
+
+  mpiret = MPI_Init (&argc, &argv);
+  SC_CHECK_MPI (mpiret);
+
+  sc_init (MPI_COMM_WORLD, 1, 1, NULL, SC_LP_DEFAULT);
+
+  retval = sc_mpi_run (getenv ("SC_MPI_THREADS") != NULL ? 0 :
+                       TEST_TUNE_RANKS, test_tune, argc, argv);
+
+  sc_finalize ();
+
+  mpiret = MPI_Finalize ();
+  SC_CHECK_MPI (mpiret);
+
+  return retval;
+}